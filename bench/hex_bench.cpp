@@ -0,0 +1,68 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+#include <gs++/transaction.hpp>
+#include <gs++/util.hpp>
+#include <gs++/hex.hpp>
+
+// decodes a getblock response the way rpc::get_raw_block used to and the way it does now
+int main(int argc, char * argv[])
+{
+    const std::size_t block_size = argc > 1 ? std::stoul(argv[1]) : 32000000;
+    const int rounds = 5;
+
+    std::mt19937 rng(0);
+    std::vector<std::uint8_t> block(block_size);
+    for (auto & b : block) {
+        b = rng();
+    }
+
+    const std::string body = "[{\"result\":\"" + gs::util::hex(block) + "\",\"error\":null,\"id\":0}]";
+
+    auto report = [&](const std::string & name, const double secs, const bool ok) {
+        std::cout
+            << name << ":\t"
+            << (secs / rounds * 1000) << " ms/block\t"
+            << (body.size() * rounds / secs / 1000000) << " MB/s"
+            << (ok ? "" : "\tMISMATCH")
+            << "\n";
+    };
+
+    {
+        bool ok = true;
+        const auto start = std::chrono::steady_clock::now();
+        for (int r=0; r<rounds; ++r) {
+            auto jbody = nlohmann::json::parse(body);
+            const std::string block_data_str = jbody[0]["result"].get<std::string>();
+            ok &= gs::util::unhex(block_data_str) == block;
+        }
+        const auto end = std::chrono::steady_clock::now();
+        report("json+unhex", std::chrono::duration<double>(end - start).count(), ok);
+    }
+
+    for (const gs::hex_impl impl : { gs::hex_impl::generic, gs::hex_impl::ssse3, gs::hex_impl::avx2 }) {
+        if (! gs::hex_supported(impl)) {
+            std::cout << gs::hex_impl_name(impl) << ":\tnot supported\n";
+            continue;
+        }
+
+        bool ok = true;
+        const auto start = std::chrono::steady_clock::now();
+        for (int r=0; r<rounds; ++r) {
+            const auto result = gs::util::json_rpc_result_string(body);
+            std::vector<std::uint8_t> out(result.second.second / 2);
+            ok &= result.first
+               && gs::hex_decode(body.data() + result.second.first, result.second.second, out.data(), impl)
+               && out == block;
+        }
+        const auto end = std::chrono::steady_clock::now();
+        report(gs::hex_impl_name(impl), std::chrono::duration<double>(end - start).count(), ok);
+    }
+
+    return 0;
+}
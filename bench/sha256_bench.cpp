@@ -0,0 +1,58 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstdint>
+
+#include <gs++/hash.hpp>
+
+// hashes transaction sized messages with every supported sha256 implementation
+int main(int argc, char * argv[])
+{
+    const std::size_t count = argc > 1 ? std::stoul(argv[1]) : 200000;
+
+    // typical p2pkh transactions are a bit over 200 bytes
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<std::size_t> size_dist(180, 600);
+
+    std::vector<std::vector<std::uint8_t>> msgs(count);
+    std::vector<const std::uint8_t *> datas;
+    std::vector<std::size_t> lens;
+    std::size_t total_bytes = 0;
+    for (auto & m : msgs) {
+        m.resize(size_dist(rng));
+        for (auto & b : m) {
+            b = rng();
+        }
+        datas.push_back(m.data());
+        lens.push_back(m.size());
+        total_bytes += m.size();
+    }
+
+    std::vector<std::uint8_t> reference(count * 32);
+    gs::sha256d_many(datas.data(), lens.data(), count, reference.data(), gs::sha256_impl::generic);
+
+    for (const gs::sha256_impl impl : { gs::sha256_impl::generic, gs::sha256_impl::shani, gs::sha256_impl::avx2 }) {
+        if (! gs::sha256_supported(impl)) {
+            std::cout << gs::sha256_impl_name(impl) << ":\tnot supported\n";
+            continue;
+        }
+
+        std::vector<std::uint8_t> out(count * 32);
+
+        const auto start = std::chrono::steady_clock::now();
+        gs::sha256d_many(datas.data(), lens.data(), count, out.data(), impl);
+        const auto end = std::chrono::steady_clock::now();
+
+        const double secs = std::chrono::duration<double>(end - start).count();
+        std::cout
+            << gs::sha256_impl_name(impl) << ":\t"
+            << static_cast<std::uint64_t>(count / secs) << " tx/s\t"
+            << (total_bytes / secs / 1000000) << " MB/s"
+            << (out == reference ? "" : "\tMISMATCH")
+            << "\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include <boost/filesystem.hpp>
+
+#include <gs++/block.hpp>
+#include <gs++/block_pack.hpp>
+#include <gs++/util.hpp>
+
+// moves blocks cached as one file per block (cache/slp/<height/1000>/<height>)
+// into the packed format the server reads from cache/slp/pack
+// already packed heights are skipped so an interrupted run can be restarted
+
+bool is_number(const std::string& s)
+{
+    return ! s.empty() && s.size() <= 9 && std::all_of(s.begin(), s.end(), [](const char c) {
+        return c >= '0' && c <= '9';
+    });
+}
+
+std::vector<std::pair<std::uint32_t, boost::filesystem::path>> legacy_blocks(const boost::filesystem::path& slp_dir)
+{
+    std::vector<std::pair<std::uint32_t, boost::filesystem::path>> ret;
+
+    for (const auto & d : boost::filesystem::directory_iterator(slp_dir)) {
+        if (! boost::filesystem::is_directory(d.path()) || ! is_number(d.path().filename().string())) {
+            continue;
+        }
+
+        for (const auto & f : boost::filesystem::directory_iterator(d.path())) {
+            const std::string name = f.path().filename().string();
+            if (boost::filesystem::is_regular_file(f.path()) && is_number(name)) {
+                ret.emplace_back(std::stoul(name), f.path());
+            }
+        }
+    }
+
+    std::sort(ret.begin(), ret.end());
+
+    return ret;
+}
+
+int dump(const boost::filesystem::path& pack_dir, const std::uint32_t height)
+{
+    gs::block_pack pack;
+    if (! pack.open(pack_dir.string())) {
+        return 1;
+    }
+
+    const auto data = pack.read(height);
+    if (! data.first) {
+        std::cerr << "block " << height << " not in pack" << std::endl;
+        return 1;
+    }
+
+    std::cout << gs::util::hex(data.second.first, data.second.first + data.second.second) << std::endl;
+
+    return 0;
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 2) {
+        std::cerr << "usage: cachepack cache_dir [--remove]\n"
+                  << "       cachepack cache_dir --dump height" << std::endl;
+        return 1;
+    }
+
+    const boost::filesystem::path slp_dir = boost::filesystem::path(argv[1]) / "slp";
+    const boost::filesystem::path pack_dir = slp_dir / "pack";
+    const std::string flag = argc > 2 ? argv[2] : "";
+
+    if (flag == "--dump" && argc > 3) {
+        return dump(pack_dir, std::stoul(argv[3]));
+    }
+
+    if (! boost::filesystem::is_directory(slp_dir)) {
+        std::cerr << slp_dir << " is not a directory" << std::endl;
+        return 1;
+    }
+
+    gs::block_pack pack;
+    if (! pack.open(pack_dir.string())) {
+        return 1;
+    }
+
+    const auto blocks = legacy_blocks(slp_dir);
+    std::size_t packed  = 0;
+    std::size_t skipped = 0;
+
+    for (const auto & b : blocks) {
+        const std::uint32_t height = b.first;
+        if (pack.has(height)) {
+            ++skipped;
+            continue;
+        }
+
+        std::ifstream ifs(b.second.string(), std::ios::in | std::ios::binary);
+        const std::vector<std::uint8_t> blk_data((std::istreambuf_iterator<char>(ifs)),
+                                                  std::istreambuf_iterator<char>());
+
+        // only the header is needed for the index
+        gs::block block;
+        const bool decoded = block.decode(blk_data.begin(), blk_data.end(), [](gs::transaction&&) {
+            return false;
+        });
+        if (! decoded) {
+            std::cerr << "could not decode " << b.second << ", stopping" << std::endl;
+            return 1;
+        }
+
+        if (! pack.append(height, block.block_hash, blk_data.data(), blk_data.size())) {
+            std::cerr << "could not pack block " << height << ", stopping" << std::endl;
+            return 1;
+        }
+
+        const auto check = pack.read(height);
+        if (! check.first
+         || check.second.second != blk_data.size()
+         || ! std::equal(blk_data.begin(), blk_data.end(), check.second.first)
+        ) {
+            std::cerr << "block " << height << " did not read back, stopping" << std::endl;
+            return 1;
+        }
+
+        ++packed;
+        if (packed % 10000 == 0) {
+            std::cout << "packed up to " << height << std::endl;
+        }
+    }
+
+    std::cout << "packed " << packed << " blocks, " << skipped << " were already packed" << std::endl;
+
+    if (flag == "--remove") {
+        for (const auto & b : blocks) {
+            boost::filesystem::remove(b.second);
+            if (boost::filesystem::is_empty(b.second.parent_path())) {
+                boost::filesystem::remove(b.second.parent_path());
+            }
+        }
+        std::cout << "removed " << blocks.size() << " legacy block files" << std::endl;
+    }
+
+    return 0;
+}
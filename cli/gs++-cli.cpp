@@ -193,7 +193,7 @@ public:
         });
 
         TIMER("toposort", {
-            txs = gs::util::topological_sort(txs);
+            txs = gs::util::topological_sort(std::move(txs));
         });
 
         std::size_t slice_begin = 0;
@@ -512,7 +512,7 @@ void validatefile(std::string src)
         txs.push_back(tx);
     }
 
-    txs = gs::util::topological_sort(txs);
+    txs = gs::util::topological_sort(std::move(txs));
 
     gs::slp_validator validator;
     for (auto & tx : txs) {
@@ -1,7 +1,68 @@
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <functional>
+#include <absl/container/flat_hash_map.h>
 #include <cslp/cslp.h>
 #include <gs++/transaction.hpp>
 #include <gs++/slp_validator.hpp>
 #include <gs++/bhash.hpp>
+#include <gs++/util.hpp>
+
+namespace {
+
+// runs f(i) for every i in [0, count) split into contiguous chunks across threads
+void cslp_parallel_for(const int count, int threads, const std::function<void(int)>& f)
+{
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, count);
+
+    if (threads <= 1) {
+        for (int i=0; i<count; ++i) {
+            f(i);
+        }
+        return;
+    }
+
+    const int chunk = (count + threads - 1) / threads;
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (int t=0; t<threads; ++t) {
+        const int begin = t * chunk;
+        const int end   = std::min(count, begin + chunk);
+        workers.emplace_back([begin, end, &f] {
+            for (int i=begin; i<end; ++i) {
+                f(i);
+            }
+        });
+    }
+
+    for (auto & w : workers) {
+        w.join();
+    }
+}
+
+// hydrated[i] is false if txdatas[i] could not be parsed
+void cslp_hydrate_txs(
+    const char ** txdatas,
+    const int * txdata_lens,
+    const int count,
+    const int threads,
+    std::vector<gs::transaction>& txs,
+    std::vector<char>& hydrated
+) {
+    txs.resize(count);
+    hydrated.assign(count, false);
+
+    cslp_parallel_for(count, threads, [&](const int i) {
+        hydrated[i] = txs[i].hydrate(txdatas[i], txdatas[i]+txdata_lens[i]);
+    });
+}
+
+}
 
 extern "C" {
     cslp_validator cslp_validator_init()
@@ -47,5 +108,64 @@ extern "C" {
         gs::slp_validator * slp_validator = static_cast<gs::slp_validator*>(validator);
         delete slp_validator;
     }
+
+    void cslp_validator_add_txs(
+        cslp_validator validator,
+        const char ** txdatas,
+        const int * txdata_lens,
+        int count,
+        int * results,
+        int threads
+    ) {
+        gs::slp_validator * slp_validator = static_cast<gs::slp_validator*>(validator);
+
+        std::vector<gs::transaction> txs;
+        std::vector<char> hydrated;
+        cslp_hydrate_txs(txdatas, txdata_lens, count, threads, txs, hydrated);
+
+        absl::flat_hash_map<gs::txid, std::vector<int>> txid_to_index;
+        std::vector<gs::transaction> batch;
+        batch.reserve(count);
+        for (int i=0; i<count; ++i) {
+            results[i] = false;
+            if (! hydrated[i]) {
+                continue;
+            }
+
+            std::vector<int> & indexes = txid_to_index[txs[i].txid];
+            if (indexes.empty()) {
+                batch.push_back(std::move(txs[i]));
+            }
+            indexes.push_back(i);
+        }
+
+        // validation has to happen in order as children depend on parents
+        for (const gs::transaction & tx : gs::util::topological_sort(std::move(batch))) {
+            slp_validator->add_tx(tx);
+            const bool valid = slp_validator->has_valid(tx.txid);
+
+            for (const int i : txid_to_index[tx.txid]) {
+                results[i] = valid;
+            }
+        }
+    }
+
+    void cslp_validator_validate_txs(
+        cslp_validator validator,
+        const char ** txdatas,
+        const int * txdata_lens,
+        int count,
+        int * results,
+        int threads
+    ) {
+        gs::slp_validator * slp_validator = static_cast<gs::slp_validator*>(validator);
+
+        // validate(tx) does not modify the validator so this is safe to share
+        cslp_parallel_for(count, threads, [&](const int i) {
+            gs::transaction tx;
+            results[i] = tx.hydrate(txdatas[i], txdatas[i]+txdata_lens[i])
+                      && slp_validator->validate(tx);
+        });
+    }
 }
 
@@ -1,11 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <cslp/cslp.h>
 
+/* a token genesis and a mint spending its baton, as in test/bch_decoding_tx_to_slp_tests.json */
+static const char * genesis_hex =
+        "0100000001b2fac7f26d57c3ef991de6fe2a43a1b95ee49b9e7ef67e113d2ee57d2da1f4"
+        "89020000006a47304402205af3bd1cd3bb0555e9950c80f0c4a320eaf1027b3ab23467f4"
+        "07dcc4e3b0a062022033bea27acd19e074f85a4c88a905d93efc5a3733ee8f8cb2d52f9d"
+        "e23cefc205412102b49855960adae49a94e8be72a26007a08f4d807ce699387dfbdd89d7"
+        "fea5c853feffffff040000000000000000386a04534c500001010747454e455349530542"
+        "7562623210746865206e657720627562626c6573214c004c00010501020800000001038c"
+        "ec8622020000000000001976a9147a92bbeb46c32fa14c339dcf09aea12a2f6d5ef688ac"
+        "22020000000000001976a91493e503186a2430c839700ede8be2cea4430adc3888accadb"
+        "0000000000001976a91424f6f06da804d6b59f57350cccf33df5bfc9647788ac7d4b0800";
+static const char * mint_hex =
+        "0100000002f8cda53b43b0ea49991a9bc6c74eb901d2a8b964bc7b8987d76789618ec18c"
+        "93030000006b483045022100ac43a871e0f84787001db745e4801b789fd9cd7efa247727"
+        "ebb5c0c7b66d597302205316328b6501759e9a15ec65202219a433172d153f9f1b68f65f"
+        "3a63494ba6f041210345a5f5dd11c987b346c18c245f0df6d305369984b9b3c7ba465c29"
+        "875466e374fefffffff8cda53b43b0ea49991a9bc6c74eb901d2a8b964bc7b8987d76789"
+        "618ec18c93020000006a47304402202ce2d9d63bc6ab7765d267540fd3429bf7a8d1b50e"
+        "975391fff3a4506289461a02205daf3f761a9b02d141f22136a6fe019062182c9da1b1d3"
+        "a5245ff745f1236e45412102c00b05bc633a48e074bc54dd195b19a470ad6252ac8d306c"
+        "82a2bd729c1c4c69feffffff040000000000000000396a04534c50000101044d494e5420"
+        "938cc18e618967d787897bbc64b9a8d201b94ec7c69b1a9949eab0433ba5cdf801020800"
+        "0000000003928b22020000000000001976a9141272884e6bd20c4661b5a052f874ff9a14"
+        "c925b288ac22020000000000001976a914d1eaebf8d1face5bd866e36bd94f43e2ffceef"
+        "7188ac40d60000000000001976a91417178e31b3e468c0d98d57be07bc907bf94d1fdb88"
+        "ac7d4b0800";
+
+/* caller frees, *len is set to the byte length */
+static char * unhex(const char * hex, int * len)
+{
+    const int n = strlen(hex) / 2;
+    char * ret = malloc(n);
+    for (int i=0; i<n; ++i) {
+        unsigned int b;
+        sscanf(hex + 2*i, "%2x", &b);
+        ret[i] = (char) b;
+    }
+
+    *len = n;
+    return ret;
+}
 
 int main(int argc, char *argv[])
 {
     cslp_validator validator = cslp_validator_init();
     const char * txid = "\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01\01";
     cslp_validator_validate_txid(validator, txid);
+
+    /* the batch is sorted before it is added so the mint may come first */
+    int txdata_lens[2];
+    char * mint    = unhex(mint_hex,    &txdata_lens[0]);
+    char * genesis = unhex(genesis_hex, &txdata_lens[1]);
+    const char * txdatas[2] = { mint, genesis };
+    int results[2];
+    cslp_validator_add_txs(validator, txdatas, txdata_lens, 2, results, 0);
+    printf("mint valid: %d genesis valid: %d\n", results[0], results[1]);
+
+    free(mint);
+    free(genesis);
     cslp_validator_destroy(validator);
 
 
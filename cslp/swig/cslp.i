@@ -1,3 +1,74 @@
 %module cslp
 
+%{
+#include <vector>
+#include <cslp/cslp.h>
+%}
+
+/* batch calls take a sequence of bytes-like objects (bytes, bytearray, memoryview)
+ * the buffers are passed through without copying and a list of bools is returned
+ */
+%typemap(in) (const char ** txdatas, const int * txdata_lens, int count, int * results)
+    (std::vector<Py_buffer> views, std::vector<const char *> ptrs, std::vector<int> lens, std::vector<int> res)
+{
+    PyObject * seq = PySequence_Fast($input, "expected a sequence of bytes-like objects");
+    if (! seq) {
+        SWIG_fail;
+    }
+
+    const Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    views.reserve(n);
+    ptrs.reserve(n);
+    lens.reserve(n);
+
+    for (Py_ssize_t i=0; i<n; ++i) {
+        Py_buffer view;
+        if (PyObject_GetBuffer(PySequence_Fast_GET_ITEM(seq, i), &view, PyBUF_SIMPLE) != 0) {
+            Py_DECREF(seq);
+            SWIG_fail;
+        }
+
+        // view holds a reference to its object so seq may go away
+        views.push_back(view);
+        ptrs.push_back(static_cast<const char *>(view.buf));
+        lens.push_back(static_cast<int>(view.len));
+    }
+    Py_DECREF(seq);
+
+    res.resize(n);
+    $1 = ptrs.data();
+    $2 = lens.data();
+    $3 = static_cast<int>(n);
+    $4 = res.data();
+}
+
+%typemap(argout) (const char ** txdatas, const int * txdata_lens, int count, int * results)
+{
+    PyObject * list = PyList_New($3);
+    for (int i=0; i<$3; ++i) {
+        PyList_SET_ITEM(list, i, PyBool_FromLong($4[i]));
+    }
+    $result = SWIG_Python_AppendOutput($result, list);
+}
+
+%typemap(freearg) (const char ** txdatas, const int * txdata_lens, int count, int * results)
+{
+    for (std::size_t i=0; i<views$argnum.size(); ++i) {
+        PyBuffer_Release(&views$argnum[i]);
+    }
+}
+
+/* the batch calls do not touch python objects so other threads may run meanwhile */
+%exception cslp_validator_add_txs {
+    Py_BEGIN_ALLOW_THREADS
+    $action
+    Py_END_ALLOW_THREADS
+}
+
+%exception cslp_validator_validate_txs {
+    Py_BEGIN_ALLOW_THREADS
+    $action
+    Py_END_ALLOW_THREADS
+}
+
 %include <cslp/cslp.h>
@@ -0,0 +1,3 @@
+#!/bin/sh
+
+afl-fuzz -i slpscript-corpus -x slp.dict -o out/diff-slpreference -m1000 -t10 ./../build-afl/bin/fuzz_differential_slpreference @@
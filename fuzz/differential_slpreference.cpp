@@ -0,0 +1,63 @@
+// README
+//
+// Checks slp_transaction::hydrate against the original chunk copying
+// parser, anything accepted or decoded differently aborts.
+
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include <gs++/slp_transaction.hpp>
+
+#include "util.hpp"
+
+int main(int argc, char * argv[])
+{
+    if (argc < 2) {
+        return 1;
+    }
+
+    const gs::scriptpubkey scriptpubkey(readfile(argv[1]));
+
+    gs::slp_transaction a;
+    gs::slp_transaction b;
+    a.token_type = b.token_type = 0;
+
+    ABORT_CHECK (a.hydrate(scriptpubkey) != b.hydrate_reference(scriptpubkey));
+    ABORT_CHECK (a.type != b.type);
+    ABORT_CHECK (a.token_type != b.token_type);
+    ABORT_CHECK (a.tokenid != b.tokenid);
+
+    if (a.type == gs::slp_transaction_type::genesis) {
+        const auto & x = absl::get<gs::slp_transaction_genesis>(a.slp_tx);
+        const auto & y = absl::get<gs::slp_transaction_genesis>(b.slp_tx);
+
+        ABORT_CHECK (x.ticker          != y.ticker);
+        ABORT_CHECK (x.name            != y.name);
+        ABORT_CHECK (x.document_uri    != y.document_uri);
+        ABORT_CHECK (x.document_hash   != y.document_hash);
+        ABORT_CHECK (x.decimals        != y.decimals);
+        ABORT_CHECK (x.has_mint_baton  != y.has_mint_baton);
+        ABORT_CHECK (x.mint_baton_vout != y.mint_baton_vout);
+        ABORT_CHECK (x.qty             != y.qty);
+    }
+    else if (a.type == gs::slp_transaction_type::mint) {
+        const auto & x = absl::get<gs::slp_transaction_mint>(a.slp_tx);
+        const auto & y = absl::get<gs::slp_transaction_mint>(b.slp_tx);
+
+        ABORT_CHECK (x.has_mint_baton  != y.has_mint_baton);
+        ABORT_CHECK (x.mint_baton_vout != y.mint_baton_vout);
+        ABORT_CHECK (x.qty             != y.qty);
+    }
+    else if (a.type == gs::slp_transaction_type::send) {
+        const auto & x = absl::get<gs::slp_transaction_send>(a.slp_tx);
+        const auto & y = absl::get<gs::slp_transaction_send>(b.slp_tx);
+
+        ABORT_CHECK (x.amounts != y.amounts);
+    }
+
+    return 0;
+}
@@ -11,6 +11,28 @@ int cslp_validator_validate_txid(cslp_validator validator, const char * txid);
 int cslp_validator_validate_tx(cslp_validator validator, const char * txdata, int txdata_len);
 void cslp_validator_destroy(cslp_validator validator);
 
+/* batch calls hydrate on threads workers (0 uses every core)
+ * results[i] is set to 1 if txdatas[i] is valid and 0 otherwise
+ * add_txs sorts the batch so transactions may spend each other in any order
+ * validate_txs only checks against transactions already added
+ */
+void cslp_validator_add_txs(
+    cslp_validator validator,
+    const char ** txdatas,
+    const int * txdata_lens,
+    int count,
+    int * results,
+    int threads
+);
+void cslp_validator_validate_txs(
+    cslp_validator validator,
+    const char ** txdatas,
+    const int * txdata_lens,
+    int count,
+    int * results,
+    int threads
+);
+
 #ifdef __cplusplus
 }
 #endif
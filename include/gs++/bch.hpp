@@ -28,7 +28,9 @@ struct bch
         const std::vector<std::uint8_t>& msg_data
     );
 
-    void rollback();
+    // disconnects the newest block recorded with save_rollback from both dbs
+    // returns false if no block is recorded
+    bool rollback();
 };
 
 }
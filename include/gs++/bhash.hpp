@@ -83,6 +83,7 @@ struct bhash
 using txid      = bhash<struct btxid>;
 using tokenid   = bhash<struct btokenid>;
 using blockhash = bhash<struct bblockhash>;
+using ecmh_hash = bhash<struct becmh_hash>;
 
 }
 
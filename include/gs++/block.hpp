@@ -6,10 +6,12 @@
 #include <vector>
 #include <algorithm>
 #include <iostream>
+#include <array>
 
 #include <gs++/transaction.hpp>
 #include <gs++/bhash.hpp>
 #include <gs++/util.hpp>
+#include <gs++/hash.hpp>
 
 namespace gs {
 
@@ -17,46 +19,37 @@ struct block
 {
     gs::blockhash block_hash;
     std::uint32_t version;
-    gs::txid prev_block; // TODO detect re-org
+    gs::txid prev_block; // compared with the tip to detect reorgs
     gs::txid merkle_root;
     std::uint32_t timestamp;
     std::uint32_t bits;
     std::uint32_t nonce;
     std::vector<gs::transaction> txs;
-
-
-    template <typename BeginIterator, typename EndIterator>
-    bool hydrate(
+    // inputs of the transactions slp_only left out, they can still burn token outputs
+    std::vector<gs::outpoint> skipped_inputs;
+
+    // streams the transactions of a serialized block to visit as they are parsed
+    // visit is called as visit(gs::transaction&& tx) and returns false to stop early
+    // the header fields and skipped_inputs are filled in, txs is left alone
+    // iterators must be contiguous, returns false only on malformed data
+    template <typename BeginIterator, typename EndIterator, typename Visitor>
+    bool decode(
         BeginIterator&& begin_it,
         EndIterator&& end_it,
+        Visitor&& visit,
         bool slp_only=false
     ) {
-#define ENABLE_BCH_PARSE_PRINTING
-#ifdef ENABLE_BCH_PARSE_PRINTING
-        #define CHECK_END(n) {    \
-            if (it+n >= end_it) { \
-                std::cerr << "CHECK_END\tline: " << __LINE__ << "\n";\
-                return false;     \
-            }                     \
-        }
-
-        #define DEBUG_PRINT(msg) {\
-            std::cerr << msg << "\tline: " << __LINE__ << "\n";\
-            std::cerr << "offset: " << (boost::format("%1$#x") % (it - begin_it)) << "\n";\
-        }
-#else
         #define CHECK_END(n) {    \
             if (it+n >= end_it) { \
                 return false;     \
             }                     \
         }
 
-        #define DEBUG_PRINT(msg) {\
-        }
-#endif
+        const std::uint8_t * data     = reinterpret_cast<const std::uint8_t*>(&*begin_it);
+        const std::uint8_t * data_end = data + (end_it - begin_it);
 
         auto it = begin_it;
-		CHECK_END(4);
+        CHECK_END(4);
         this->version = gs::util::extract_u32(it);
 
         CHECK_END(32);
@@ -74,53 +67,91 @@ struct block
         CHECK_END(4);
         this->nonce     = gs::util::extract_u32(it);
 
-        {
-            std::vector<std::uint8_t> block_header;
+        gs::sha256d(data, it - begin_it, this->block_hash.v.data());
 
-            // TODO refactor this in future, we could use lambda in c++17
-            #define ADD_TO_HEADER(VAR) {\
-                std::copy(\
-                    reinterpret_cast<const std::uint8_t *>(&VAR),\
-                    reinterpret_cast<const std::uint8_t *>(&VAR)+sizeof(VAR),\
-                    std::back_inserter(block_header)\
-                );\
+        CHECK_END(gs::util::var_int_additional_size(it));
+        const std::uint64_t txn_count { gs::util::extract_var_int(it) };
+
+        // transactions are parsed in place and only copied out and hashed once we
+        // know we keep them, with slp_only that is just the ones passing the lokad
+        // id pre-filter, they are hashed in groups so multi-buffer sha256 can be
+        // used while memory stays bounded
+        constexpr std::size_t hash_batch_size = 64;
+        std::array<gs::transaction_view, hash_batch_size> batch;
+        std::array<const std::uint8_t *, hash_batch_size> batch_datas;
+        std::array<std::size_t, hash_batch_size> batch_sizes;
+        std::array<std::uint8_t, hash_batch_size * 32> digests;
+        std::size_t batch_len = 0;
+
+        // returns false if visit asked to stop
+        auto flush = [&]() -> bool {
+            for (std::size_t i=0; i<batch_len; ++i) {
+                batch_datas[i] = batch[i].data;
+                batch_sizes[i] = batch[i].size;
             }
+            gs::sha256d_many(batch_datas.data(), batch_sizes.data(), batch_len, digests.data());
 
-            ADD_TO_HEADER(version);
-            ADD_TO_HEADER(prev_block.v);
-            ADD_TO_HEADER(merkle_root.v);
-            ADD_TO_HEADER(timestamp);
-            ADD_TO_HEADER(bits);
-            ADD_TO_HEADER(nonce);
+            const std::size_t len = batch_len;
+            batch_len = 0;
 
-            #undef ADD_TO_HEADER
+            for (std::size_t i=0; i<len; ++i) {
+                gs::txid txid;
+                std::copy(digests.begin() + i*32, digests.begin() + (i+1)*32, txid.v.begin());
 
-            sha256(block_header.data(), block_header.size(), this->block_hash.v.data());
-            sha256(this->block_hash.v.data(), this->block_hash.v.size(), this->block_hash.v.data());
-        }
+                gs::transaction tx;
+                batch[i].materialize(tx, txid);
+
+                if (slp_only && tx.slp.type == gs::slp_transaction_type::invalid) {
+                    skipped_inputs.insert(skipped_inputs.end(), tx.inputs.begin(), tx.inputs.end());
+                    continue;
+                }
+
+                if (! visit(std::move(tx))) {
+                    return false;
+                }
+            }
+
+            return true;
+        };
 
-        CHECK_END(gs::util::var_int_additional_size(it));
-        const std::uint64_t txn_count { gs::util::extract_var_int(it) };
         for (std::uint64_t i=0; i<txn_count; ++i) {
             CHECK_END(0);
-            gs::transaction tx;
-            const bool hydration_success = tx.hydrate(it, end_it);
-
-            if (! hydration_success) {
-                std::cerr << "wtf\n";
+            gs::transaction_view view;
+            if (! view.parse(data + (it - begin_it), data_end)) {
                 return false;
             }
 
-            if (! slp_only || tx.slp.type != gs::slp_transaction_type::invalid) {
-                txs.push_back(tx);
+            it += view.size;
+
+            if (slp_only && ! view.slp_candidate()) {
+                view.for_each_input([&](const gs::txid& prev_tx_id, const std::uint32_t prev_out_idx) {
+                    skipped_inputs.emplace_back(prev_tx_id, prev_out_idx);
+                });
+                continue;
             }
 
-            it += tx.serialized.size();
+            batch[batch_len++] = view;
+            if (batch_len == hash_batch_size && ! flush()) {
+                return true;
+            }
         }
 
+        flush();
+
         return true;
-#undef CHECK_END
-#undef DEBUG_PRINT
+        #undef CHECK_END
+    }
+
+    template <typename BeginIterator, typename EndIterator>
+    bool hydrate(
+        BeginIterator&& begin_it,
+        EndIterator&& end_it,
+        bool slp_only=false
+    ) {
+        return decode(begin_it, end_it, [this](gs::transaction&& tx) {
+            txs.push_back(std::move(tx));
+            return true;
+        }, slp_only);
     }
 
     void topological_sort();
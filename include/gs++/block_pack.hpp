@@ -0,0 +1,107 @@
+#ifndef GS_BLOCK_PACK_HPP
+#define GS_BLOCK_PACK_HPP
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <absl/container/flat_hash_map.h>
+#include <boost/thread.hpp>
+#include <gs++/bhash.hpp>
+
+namespace gs {
+
+// append only store for cached blocks
+// block data is appended to numbered segment files and an index file records
+// height, hash, location and checksum of every block, reads go through mmap
+//
+// pack layout:
+//   dir/index.dat        magic, version then fixed size entries
+//   dir/seg-00000.dat    concatenated serialized blocks
+//
+// an entry is only appended after its data so a crash leaves at most a torn
+// index tail, which open() drops, the data checksum is checked on every read
+// a zero length entry drops its height, see drop_above
+struct block_pack
+{
+    static constexpr std::uint32_t magic         = 0x4b505347; // "GSPK"
+    static constexpr std::uint32_t version       = 1;
+    static constexpr std::size_t   header_size   = 8;
+    static constexpr std::size_t   entry_size    = 64;
+
+    struct entry
+    {
+        std::uint32_t height;
+        std::uint32_t segment;
+        std::uint64_t offset;
+        std::uint32_t length;
+        std::uint32_t checksum; // crc32 of the block data
+        gs::blockhash hash;
+    };
+
+    struct segment
+    {
+        int           fd;
+        std::uint64_t size;     // bytes written
+        std::uint8_t* map;      // nullptr until first read
+        std::uint64_t map_size;
+    };
+
+    std::string   dir;
+    std::uint64_t segment_size; // a segment is rotated once it would grow past this
+
+    int index_fd;
+    absl::flat_hash_map<std::uint32_t, entry> entries; // height -> latest entry
+    std::vector<segment> segments;
+    std::vector<std::pair<std::uint8_t*, std::uint64_t>> retired_maps; // outgrown mappings, see read
+    boost::mutex mtx; // IMPORTANT: all of the above must be guarded with the mtx
+
+    block_pack(const std::uint64_t segment_size = 256 * 1024 * 1024)
+    : segment_size(segment_size)
+    , index_fd(-1)
+    {}
+
+    ~block_pack();
+
+    block_pack(const block_pack&) = delete;
+    block_pack& operator=(const block_pack&) = delete;
+
+    // creates dir if needed and loads the index
+    bool open(const std::string& dir);
+    void close();
+
+    // a height appended twice resolves to the latest data
+    bool append(
+        const std::uint32_t height,
+        const gs::blockhash& hash,
+        const std::uint8_t* data,
+        const std::size_t len
+    );
+
+    // forgets every block above height, ex: the old branch after a reorg
+    // returns false if the drop could not be recorded in the index
+    bool drop_above(const std::uint32_t height);
+
+    bool has(const std::uint32_t height);
+    std::pair<bool, entry> find(const std::uint32_t height);
+
+    // returns the block data after verifying its checksum
+    // the pointer stays valid until the pack is closed
+    std::pair<bool, std::pair<const std::uint8_t*, std::size_t>> read(const std::uint32_t height);
+
+    // highest height such that every height from first up to it is packed, or first-1
+    std::uint32_t contiguous_until(const std::uint32_t first);
+
+    std::size_t size();
+
+    static std::string segment_path(const std::string& dir, const std::uint32_t segment);
+    static std::string index_path(const std::string& dir);
+
+private:
+    bool open_segment(const std::uint32_t segment);
+    bool map_segment(segment& seg);
+};
+
+}
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef GS_COMPACT_UTXO_HPP
+#define GS_COMPACT_UTXO_HPP
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <absl/hash/hash.h>
+#include <absl/container/flat_hash_set.h>
+#include <gs++/bhash.hpp>
+#include <gs++/scriptpubkey.hpp>
+
+namespace gs {
+
+// keeps every distinct value once and hands out a u32 id for it
+// ids are refcounted and reused after their last reference is released
+//
+// the set only holds ids and hashes through values, so a value is not stored twice
+template <typename T>
+struct interner
+{
+    struct id_hash
+    {
+        using is_transparent = void;
+        const std::vector<T>* values;
+
+        std::size_t operator()(const std::uint32_t id) const
+        { return absl::Hash<T>()((*values)[id]); }
+
+        std::size_t operator()(const T& v) const
+        { return absl::Hash<T>()(v); }
+    };
+
+    struct id_eq
+    {
+        using is_transparent = void;
+        const std::vector<T>* values;
+
+        // values are unique so equal ids are equal values
+        bool operator()(const std::uint32_t a, const std::uint32_t b) const
+        { return a == b; }
+
+        bool operator()(const std::uint32_t a, const T& b) const
+        { return (*values)[a] == b; }
+
+        bool operator()(const T& a, const std::uint32_t b) const
+        { return a == (*values)[b]; }
+    };
+
+    std::vector<T>             values;
+    std::vector<std::uint32_t> refs; // 0 for free ids
+    std::vector<std::uint32_t> free_ids;
+    absl::flat_hash_set<std::uint32_t, id_hash, id_eq> ids;
+
+    interner()
+    : ids(0, id_hash{&values}, id_eq{&values})
+    {}
+
+    // the set points at values
+    interner(const interner&) = delete;
+    interner& operator=(const interner&) = delete;
+
+    // the id of v with one more reference, v is added if it is new
+    std::uint32_t acquire(const T& v)
+    {
+        const auto search = ids.find(v);
+        if (search != ids.end()) {
+            ++refs[*search];
+            return *search;
+        }
+
+        std::uint32_t id;
+        if (free_ids.empty()) {
+            id = values.size();
+            values.push_back(v);
+            refs.push_back(1);
+        } else {
+            id = free_ids.back();
+            free_ids.pop_back();
+            values[id] = v;
+            refs[id] = 1;
+        }
+        ids.insert(id);
+
+        return id;
+    }
+
+    // drops one reference, the value is forgotten with the last one
+    void release(const std::uint32_t id)
+    {
+        if (--refs[id] == 0) {
+            ids.erase(id);
+            values[id] = T();
+            free_ids.push_back(id);
+        }
+    }
+
+    // the id of v without taking a reference
+    std::pair<bool, std::uint32_t> find(const T& v) const
+    {
+        const auto search = ids.find(v);
+        if (search == ids.end()) {
+            return { false, 0 };
+        }
+
+        return { true, *search };
+    }
+
+    const T& get(const std::uint32_t id) const
+    { return values[id]; }
+
+    std::size_t size() const
+    { return ids.size(); }
+
+    void reserve(const std::size_t n)
+    {
+        values.reserve(n);
+        refs.reserve(n);
+        ids.reserve(n);
+    }
+
+    // bytes held, not counting what T itself allocates
+    std::size_t memory_usage() const
+    {
+        return values.capacity()   * sizeof(T)
+             + refs.capacity()     * sizeof(std::uint32_t)
+             + free_ids.capacity() * sizeof(std::uint32_t)
+             + ids.capacity()      * (sizeof(std::uint32_t) + 1);
+    }
+};
+
+// a scriptpubkey as the utxodb stores it
+// p2pkh and p2sh keep only their 20 byte hash, any other script is interned
+// and the first 4 bytes of data hold its id
+struct script_ref
+{
+    enum class kind : std::uint8_t
+    {
+        p2pkh,
+        p2sh,
+        interned
+    };
+
+    kind                         tag;
+    std::array<std::uint8_t, 20> data;
+
+    script_ref()
+    : tag(kind::interned)
+    , data({ 0 })
+    {}
+
+    // false if s fits no template and has to be interned
+    static bool from_template(const gs::scriptpubkey& s, script_ref& ref);
+
+    static script_ref interned(const std::uint32_t id);
+
+    std::uint32_t interned_id() const;
+
+    // templates are expanded, interned scripts are looked up in scripts
+    gs::scriptpubkey to_scriptpubkey(const gs::interner<gs::scriptpubkey>& scripts) const;
+
+    bool operator==(const script_ref& o) const
+    { return tag == o.tag && data == o.data; }
+
+    bool operator!=(const script_ref& o) const
+    { return ! operator==(o); }
+
+    template <typename H>
+    friend H AbslHashValue(H h, const script_ref& m)
+    {
+        return H::combine(std::move(h), static_cast<std::uint8_t>(m.tag), m.data);
+    }
+};
+
+// the outpoint of a confirmed output with its txid interned
+struct utxo_key
+{
+    std::uint32_t tx;
+    std::uint32_t vout;
+
+    utxo_key()
+    : tx(0)
+    , vout(0)
+    {}
+
+    utxo_key(const std::uint32_t tx, const std::uint32_t vout)
+    : tx(tx)
+    , vout(vout)
+    {}
+
+    bool operator==(const utxo_key& o) const
+    { return tx == o.tx && vout == o.vout; }
+
+    bool operator!=(const utxo_key& o) const
+    { return ! operator==(o); }
+
+    template <typename H>
+    friend H AbslHashValue(H h, const utxo_key& m)
+    {
+        return H::combine(std::move(h), m.tx, m.vout);
+    }
+};
+
+// what is left of a gs::output once its outpoint is the key
+struct utxo_entry
+{
+    std::uint64_t  value;
+    gs::script_ref script;
+};
+
+}
+
+#endif
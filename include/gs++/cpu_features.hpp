@@ -0,0 +1,61 @@
+#ifndef GS_CPU_FEATURES_HPP
+#define GS_CPU_FEATURES_HPP
+
+#include <cstdint>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #define GS_CPU_FEATURES_X86
+    #include <cpuid.h>
+#endif
+
+namespace gs {
+
+// instruction set extensions the runtime dispatch of hash and hex picks from
+// avx2 is only reported if the os also saves the ymm registers
+struct cpu_features
+{
+    bool ssse3 = false;
+    bool sse41 = false;
+    bool shani = false;
+    bool avx2  = false;
+
+    cpu_features()
+    {
+#ifdef GS_CPU_FEATURES_X86
+        unsigned a, b, c, d;
+        if (! __get_cpuid(1, &a, &b, &c, &d)) {
+            return;
+        }
+
+        ssse3 = c & (1u << 9);
+        sse41 = c & (1u << 19);
+        const bool osxsave = c & (1u << 27);
+        const bool avx     = c & (1u << 28);
+
+        bool ymm_enabled = false;
+        if (osxsave && avx) {
+            std::uint32_t xcr0_lo, xcr0_hi;
+            __asm__ ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+            ymm_enabled = (xcr0_lo & 0x6) == 0x6;
+        }
+
+        if (! __get_cpuid_count(7, 0, &a, &b, &c, &d)) {
+            return;
+        }
+
+        shani = ssse3 && sse41 && (b & (1u << 29));
+        avx2  = ymm_enabled && (b & (1u << 5));
+#endif
+    }
+};
+
+// probed once, safe to call during static initialization
+inline const cpu_features& cpu()
+{
+    static const cpu_features features;
+    return features;
+}
+
+}
+
+#endif
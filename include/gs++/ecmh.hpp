@@ -0,0 +1,40 @@
+#ifndef GS_ECMH_HPP
+#define GS_ECMH_HPP
+
+#include <vector>
+#include <cstdint>
+#include <3rdparty/secp256k1/include/secp256k1_multiset.h>
+#include <gs++/bhash.hpp>
+#include <gs++/output.hpp>
+
+namespace gs {
+
+// elliptic curve multiset hash of a set of outputs
+// adding and removing commute, so the hash of a set can follow it as it changes
+// and two sets hold the same outputs when their finalized hashes match
+//
+// an output is hashed as txid 32 | vout u32 | value u64 | script
+struct ecmh
+{
+    secp256k1_multiset ms;
+
+    ecmh();
+
+    void add(const gs::output& o);
+    void remove(const gs::output& o);
+    void combine(const ecmh& o);
+
+    // hashing an output onto the curve is slow, large updates are split over threads
+    // threads 0 uses every core
+    void update(
+        const std::vector<const gs::output*>& added,
+        const std::vector<const gs::output*>& removed,
+        const std::size_t threads = 0
+    );
+
+    gs::ecmh_hash finalize() const;
+};
+
+}
+
+#endif
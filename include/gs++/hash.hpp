@@ -0,0 +1,51 @@
+#ifndef GS_HASH_HPP
+#define GS_HASH_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+namespace gs {
+
+// sha256 implementations picked between at runtime
+// shani is fastest per message, avx2 hashes 8 messages at once
+enum class sha256_impl
+{
+    generic,
+    shani,
+    avx2,
+};
+
+bool sha256_supported(const sha256_impl impl);
+
+// best implementation for single messages on this cpu
+sha256_impl sha256_detect();
+
+const char * sha256_impl_name(const sha256_impl impl);
+
+// double sha256 as used for txids and block hashes, writes 32 bytes to out
+void sha256d(
+    const std::uint8_t * data,
+    const std::size_t len,
+    std::uint8_t * out
+);
+
+// hashes count messages, out receives 32 bytes per message in order
+void sha256d_many(
+    const std::uint8_t * const * datas,
+    const std::size_t * lens,
+    const std::size_t count,
+    std::uint8_t * out
+);
+
+// same as above with a forced implementation, which must be supported
+void sha256d_many(
+    const std::uint8_t * const * datas,
+    const std::size_t * lens,
+    const std::size_t count,
+    std::uint8_t * out,
+    const sha256_impl impl
+);
+
+}
+
+#endif
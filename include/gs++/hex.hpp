@@ -0,0 +1,39 @@
+#ifndef GS_HEX_HPP
+#define GS_HEX_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+namespace gs {
+
+// hex decoder implementations picked between at runtime
+enum class hex_impl
+{
+    generic,
+    ssse3,
+    avx2,
+};
+
+bool hex_supported(const hex_impl impl);
+
+const char * hex_impl_name(const hex_impl impl);
+
+// decodes len hex characters of either case into len/2 bytes of out
+// returns false for odd lengths or any non hex character, out is then garbage
+bool hex_decode(
+    const char * in,
+    const std::size_t len,
+    std::uint8_t * out
+);
+
+// same as above with a forced implementation, which must be supported
+bool hex_decode(
+    const char * in,
+    const std::size_t len,
+    std::uint8_t * out,
+    const hex_impl impl
+);
+
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef GS_INGEST_QUEUE_HPP
+#define GS_INGEST_QUEUE_HPP
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+
+namespace gs {
+
+// bounded wait free queue between one receiving thread and one applying thread
+// the receiver only hands items over, the applier takes them in batches
+// the mutex is only touched to wake the applier once it went to sleep on an empty queue
+template <typename T>
+struct ingest_queue
+{
+    boost::lockfree::spsc_queue<T*> queue;
+
+    std::atomic<std::uint64_t> pushed;
+    std::atomic<std::uint64_t> popped;
+    std::atomic<std::uint64_t> batches;
+    std::atomic<std::uint64_t> last_batch_size;
+    std::atomic<bool> sleeping; // applier is waiting on the cv
+    std::atomic<bool> stopping;
+    boost::mutex mtx;
+    boost::condition_variable cv;
+
+    ingest_queue(const std::size_t capacity)
+    : queue(std::max<std::size_t>(1, capacity))
+    , pushed(0)
+    , popped(0)
+    , batches(0)
+    , last_batch_size(0)
+    , sleeping(false)
+    , stopping(false)
+    {}
+
+    ~ingest_queue()
+    {
+        T* item;
+        while (queue.pop(item)) {
+            delete item;
+        }
+    }
+
+    ingest_queue(const ingest_queue&) = delete;
+    ingest_queue& operator=(const ingest_queue&) = delete;
+
+    // receiver only, waits while the queue is full so the backlog stays in the socket
+    // returns false if the queue was stopped first
+    bool push(std::unique_ptr<T> item)
+    {
+        // counted first so depth never sees the applier ahead of the receiver
+        ++pushed;
+        while (! queue.push(item.get())) {
+            if (stopping) {
+                --pushed;
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        item.release();
+
+        if (sleeping) {
+            boost::lock_guard<boost::mutex> lock(mtx);
+            cv.notify_one();
+        }
+
+        return true;
+    }
+
+    // applier only, waits up to timeout for the first item then takes up to max_items which are ready
+    std::vector<std::unique_ptr<T>> pop_batch(
+        const std::size_t max_items,
+        const std::chrono::milliseconds timeout
+    ) {
+        std::vector<std::unique_ptr<T>> batch;
+
+        if (queue.read_available() == 0 && ! stopping) {
+            boost::unique_lock<boost::mutex> lock(mtx);
+            sleeping = true;
+            // a push after this check sees sleeping and notifies under the mutex
+            cv.timed_wait(lock, boost::posix_time::milliseconds(timeout.count()), [this] {
+                return queue.read_available() > 0 || stopping;
+            });
+            sleeping = false;
+        }
+
+        T* item;
+        while (batch.size() < std::max<std::size_t>(1, max_items) && queue.pop(item)) {
+            batch.emplace_back(item);
+        }
+
+        if (! batch.empty()) {
+            popped += batch.size();
+            ++batches;
+            last_batch_size = batch.size();
+        }
+
+        return batch;
+    }
+
+    // items waiting to be applied
+    std::uint64_t depth() const
+    {
+        return pushed - popped;
+    }
+
+    // wakes both sides, items still queued are dropped with the queue
+    void stop()
+    {
+        stopping = true;
+        boost::lock_guard<boost::mutex> lock(mtx);
+        cv.notify_all();
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef GS_LRU_CACHE_HPP
+#define GS_LRU_CACHE_HPP
+
+#include <list>
+#include <utility>
+#include <cstdint>
+#include <boost/thread.hpp>
+#include <absl/container/flat_hash_map.h>
+
+namespace gs {
+
+// fixed capacity least-recently-used cache, safe to share between threads
+// every lookup reorders the entries so all access is exclusive
+template <typename Key, typename Value>
+struct lru_cache
+{
+    using entry_list = std::list<std::pair<Key, Value>>;
+
+    std::size_t capacity;
+    entry_list entries; // front is most recently used
+    absl::flat_hash_map<Key, typename entry_list::iterator> index;
+    boost::mutex mtx; // IMPORTANT: entries and index must be guarded with the mtx
+
+    std::uint64_t hits;
+    std::uint64_t misses;
+
+    lru_cache(const std::size_t capacity)
+    : capacity(capacity)
+    , hits(0)
+    , misses(0)
+    {}
+
+    // copies the cached value into out on hit
+    bool get(const Key& key, Value& out)
+    {
+        boost::lock_guard<boost::mutex> lock(mtx);
+
+        auto search = index.find(key);
+        if (search == index.end()) {
+            ++misses;
+            return false;
+        }
+
+        entries.splice(entries.begin(), entries, search->second);
+        out = search->second->second;
+        ++hits;
+
+        return true;
+    }
+
+    void put(const Key& key, const Value& value)
+    {
+        boost::lock_guard<boost::mutex> lock(mtx);
+
+        if (capacity == 0) {
+            return;
+        }
+
+        auto search = index.find(key);
+        if (search != index.end()) {
+            search->second->second = value;
+            entries.splice(entries.begin(), entries, search->second);
+            return;
+        }
+
+        entries.emplace_front(key, value);
+        index.insert({ key, entries.begin() });
+
+        if (entries.size() > capacity) {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+    void clear()
+    {
+        boost::lock_guard<boost::mutex> lock(mtx);
+
+        entries.clear();
+        index.clear();
+    }
+
+    std::size_t size()
+    {
+        boost::lock_guard<boost::mutex> lock(mtx);
+        return entries.size();
+    }
+};
+
+}
+
+#endif
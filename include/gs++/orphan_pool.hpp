@@ -0,0 +1,62 @@
+#ifndef GS_ORPHAN_POOL_HPP
+#define GS_ORPHAN_POOL_HPP
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <absl/container/flat_hash_map.h>
+#include <absl/container/flat_hash_set.h>
+#include <absl/container/node_hash_map.h>
+#include <gs++/transaction.hpp>
+#include <gs++/bhash.hpp>
+
+namespace gs {
+
+// holds mempool transactions which arrived before one of their parents
+// so they can be revalidated once the parent shows up
+struct orphan_pool
+{
+    struct orphan
+    {
+        gs::transaction       tx;
+        std::vector<gs::txid> missing_parents;
+        std::uint64_t         added; // unix time
+    };
+
+    std::size_t   max_size;
+    std::uint64_t expiry; // seconds
+
+    absl::node_hash_map<gs::txid, orphan> orphans;
+    absl::flat_hash_map<gs::txid, absl::flat_hash_set<gs::txid>> by_parent; // missing parent -> children
+    std::deque<std::pair<std::uint64_t, gs::txid>> arrival; // oldest first, may hold stale entries
+
+    orphan_pool(
+        const std::size_t   max_size,
+        const std::uint64_t expiry
+    )
+    : max_size(max_size)
+    , expiry(expiry)
+    {}
+
+    // evicts the oldest orphan if the pool is full
+    bool add(
+        const gs::transaction& tx,
+        const std::vector<gs::txid>& missing_parents,
+        const std::uint64_t added
+    );
+
+    bool has(const gs::txid& txid) const;
+    bool remove(const gs::txid& txid);
+
+    // removes and returns every orphan waiting on parent
+    std::vector<gs::transaction> take_children(const gs::txid& parent);
+
+    // returns amount of orphans dropped
+    std::size_t expire(const std::uint64_t now);
+
+    std::size_t size() const;
+};
+
+}
+
+#endif
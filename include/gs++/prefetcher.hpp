@@ -0,0 +1,159 @@
+#ifndef GS_PREFETCHER_HPP
+#define GS_PREFETCHER_HPP
+
+#include <map>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <utility>
+#include <cstdint>
+#include <functional>
+#include <chrono>
+#include <boost/thread.hpp>
+
+namespace gs {
+
+// runs fetch for a range of heights on worker threads, at most window heights
+// ahead of the consumer, and hands the results out strictly in height order
+// fetch is called concurrently so it must be thread safe
+template <typename T>
+struct prefetcher
+{
+    using fetch_fn = std::function<std::pair<bool, T>(const std::uint32_t height)>;
+
+    fetch_fn      fetch;
+    std::uint32_t last_height;  // inclusive
+    std::size_t   window;
+
+    std::uint32_t next_claim;   // next height a worker picks up
+    std::uint32_t next_deliver; // next height next() returns
+    std::map<std::uint32_t, std::pair<bool, T>> ready;
+    std::uint64_t fetch_us;     // summed over all workers
+    std::uint64_t wait_us;      // time the consumer spent blocked in next()
+    bool failed;
+    bool stopping;
+    boost::mutex mtx; // IMPORTANT: all of the above must be guarded with the mtx
+    boost::condition_variable cv;
+
+    std::vector<std::thread> workers;
+
+    prefetcher(
+        const std::uint32_t first_height,
+        const std::uint32_t last_height,
+        const std::size_t   window,
+        const std::size_t   threads,
+        const fetch_fn      fetch
+    )
+    : fetch(fetch)
+    , last_height(last_height)
+    , window(std::max<std::size_t>(1, window))
+    , next_claim(first_height)
+    , next_deliver(first_height)
+    , fetch_us(0)
+    , wait_us(0)
+    , failed(false)
+    , stopping(false)
+    {
+        for (std::size_t i=0; i<std::max<std::size_t>(1, threads); ++i) {
+            workers.emplace_back([this] { work(); });
+        }
+    }
+
+    // waits for fetches in flight, results not taken yet are dropped
+    ~prefetcher()
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+
+        for (auto & w : workers) {
+            w.join();
+        }
+    }
+
+    prefetcher(const prefetcher&) = delete;
+    prefetcher& operator=(const prefetcher&) = delete;
+
+    // height of the result next() returns
+    std::uint32_t next_height()
+    {
+        boost::lock_guard<boost::mutex> lock(mtx);
+        return next_deliver;
+    }
+
+    // blocks until the next height is fetched, returns false once past last_height
+    // or after a fetch failed, the caller should then start over from next_height
+    std::pair<bool, T> next()
+    {
+        boost::unique_lock<boost::mutex> lock(mtx);
+        if (failed || next_deliver > last_height) {
+            return { false, T() };
+        }
+
+        const auto wait_start = std::chrono::steady_clock::now();
+        cv.wait(lock, [this] { return ready.count(next_deliver) == 1; });
+        wait_us += elapsed_us(wait_start);
+
+        auto search = ready.find(next_deliver);
+        std::pair<bool, T> ret = std::move(search->second);
+        ready.erase(search);
+
+        if (ret.first) {
+            ++next_deliver;
+            cv.notify_all();
+        } else {
+            failed = true;
+        }
+
+        return ret;
+    }
+
+    // fetch_us over wall time and threads shows whether fetching or the consumer
+    // is the bottleneck, a consumer that waits a lot needs more threads
+    std::pair<std::uint64_t, std::uint64_t> busy_us()
+    {
+        boost::lock_guard<boost::mutex> lock(mtx);
+        return { fetch_us, wait_us };
+    }
+
+private:
+    static std::uint64_t elapsed_us(const std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - since
+        ).count();
+    }
+
+    void work()
+    {
+        boost::unique_lock<boost::mutex> lock(mtx);
+        while (true) {
+            cv.wait(lock, [this] {
+                return stopping
+                    || (next_claim <= last_height && next_claim < next_deliver + window);
+            });
+
+            if (stopping) {
+                return;
+            }
+
+            const std::uint32_t height = next_claim++;
+
+            lock.unlock();
+            const auto fetch_start = std::chrono::steady_clock::now();
+            std::pair<bool, T> result = fetch(height);
+            const std::uint64_t took = elapsed_us(fetch_start);
+            lock.lock();
+
+            fetch_us += took;
+            ready.emplace(height, std::move(result));
+            cv.notify_all();
+        }
+    }
+};
+
+}
+
+#endif
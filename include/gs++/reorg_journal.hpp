@@ -0,0 +1,59 @@
+#ifndef GS_REORG_JOURNAL_HPP
+#define GS_REORG_JOURNAL_HPP
+
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <gs++/bhash.hpp>
+#include <gs++/output.hpp>
+#include <gs++/txgraph.hpp>
+#include <gs++/slp_validator.hpp>
+
+namespace gs {
+
+// what connecting a block, and the mempool transactions applied while it
+// was the tip, changed in the validator and graph
+struct block_undo
+{
+    std::uint32_t             height;
+    gs::blockhash             hash;
+    std::vector<gs::txid>     added; // were in neither the validator nor the graph before
+    std::vector<gs::outpoint> spent; // tracked outputs the block spent, only with pruning
+};
+
+// undo records of the last depth blocks so a reorg can disconnect them
+// instead of rebuilding everything, a depth of 0 disables recording
+struct reorg_journal
+{
+    std::size_t            depth;
+    std::deque<block_undo> blocks; // oldest first
+
+    reorg_journal(const std::size_t depth = 10)
+    : depth(depth)
+    {}
+
+    // starts the record later changes go to, the oldest one past depth is dropped
+    void connect(const std::uint32_t height, const gs::blockhash& hash);
+
+    // call before adding a transaction which is in neither the validator nor the graph
+    void record_added(const gs::txid& txid);
+    void record_spent(const std::vector<gs::outpoint>& spent);
+
+    // nullptr if hash is not a recorded block
+    const block_undo* find(const gs::blockhash& hash) const;
+
+    // disconnects every block after fork_hash, newest first, and forgets them
+    // returns false and changes nothing if fork_hash is not recorded
+    bool rollback(
+        const gs::blockhash& fork_hash,
+        gs::txgraph& g,
+        gs::slp_validator& validator
+    );
+
+    // bytes held by the records
+    std::size_t memory_usage() const;
+};
+
+}
+
+#endif
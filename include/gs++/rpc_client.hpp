@@ -17,6 +17,9 @@ public:
     std::pair<bool, std::uint32_t> get_best_block_height();
     std::pair<bool, std::vector<gs::txid>> get_raw_mempool();
     std::pair<bool, std::vector<std::uint8_t>> get_raw_transaction(const gs::txid& txid);    
+    // batched over json-rpc, one call at a time over grpc
+    std::pair<bool, std::vector<gs::blockhash>> get_block_hashes(const std::size_t first_height, const std::size_t last_height);
+    std::pair<bool, std::vector<std::vector<std::uint8_t>>> get_raw_transactions(const std::vector<gs::txid>& txids);
     int subscribe_raw_transactions(std::function<void (std::string txn)> callback);
     int subscribe_raw_blocks(std::function<void (std::string block)> callback);
 
@@ -5,6 +5,7 @@
 #include <string>
 #include <memory>
 #include <cassert>
+#include <algorithm>
 #include <iostream>
 #include <httplib/httplib.h>
 #include <nlohmann/json.hpp>
@@ -15,26 +16,62 @@ namespace gs {
 
 struct rpc
 {
+    std::string     rpc_addr;
+    std::uint16_t   rpc_port;
     std::string     rpc_user;
     std::string     rpc_pass;
     httplib::Client cli;
+    std::size_t     batch_size;  // calls per http request in batch_query
+    std::size_t     connections; // keep-alive connections batch_query spreads requests over
+    std::vector<httplib::Client> pool; // one client per batch_query worker, reused between calls
 
     rpc(
         const std::string   rpc_addr,
         const std::uint16_t rpc_port,
         const std::string   rpc_user,
-        const std::string   rpc_pass
+        const std::string   rpc_pass,
+        const std::size_t   batch_size  = 1000,
+        const std::size_t   connections = 4
     )
-    : rpc_user(rpc_user)
+    : rpc_addr(rpc_addr)
+    , rpc_port(rpc_port)
+    , rpc_user(rpc_user)
     , rpc_pass(rpc_pass)
     , cli(httplib::Client(rpc_addr.c_str(), rpc_port))
-    {}
+    , batch_size(batch_size)
+    , connections(connections)
+    {
+        const std::size_t pool_size = std::max<std::size_t>(1, connections);
+        pool.reserve(pool_size);
+        for (std::size_t i=0; i<pool_size; ++i) {
+            pool.emplace_back(this->rpc_addr.c_str(), rpc_port);
+        }
+    }
 
     std::shared_ptr<httplib::Response> query(
         const std::string & method,
         const nlohmann::json & params
     );
 
+    // issues one call per entry of params_list as json-rpc batch arrays
+    // results line up with params_list, a call which errored holds false and the error
+    // first is false only when a request as a whole failed
+    std::pair<bool, std::vector<std::pair<bool, nlohmann::json>>> batch_query(
+        const std::string & method,
+        const std::vector<nlohmann::json> & params_list
+    );
+
+    // inclusive range, fails if any height is missing
+    std::pair<bool, std::vector<gs::blockhash>> get_block_hashes(
+        const std::size_t first_height,
+        const std::size_t last_height
+    );
+
+    // fails if any of the transactions could not be fetched
+    std::pair<bool, std::vector<std::vector<std::uint8_t>>> get_raw_transactions(
+        const std::vector<gs::txid>& txids
+    );
+
     std::pair<bool, gs::blockhash> get_block_hash(const std::size_t height);
     std::pair<bool, std::vector<std::uint8_t>> get_raw_block(const gs::blockhash& block_hash);
 
@@ -107,7 +107,20 @@ struct slp_transaction
     slp_transaction(const slp_transaction_send& slp_tx);
     slp_transaction(const gs::scriptpubkey& scriptpubkey);
 
+    // parses the op_return in place, chunks are kept as pointers into the script
+    bool hydrate(const std::uint8_t * begin, const std::uint8_t * end);
+
     bool hydrate(const gs::scriptpubkey& scriptpubkey)
+    {
+        return hydrate(
+            scriptpubkey.v.data(),
+            scriptpubkey.v.data() + scriptpubkey.v.size()
+        );
+    }
+
+    // original parser which copies every chunk into a string
+    // kept to differentially test hydrate against, do not use in hot paths
+    bool hydrate_reference(const gs::scriptpubkey& scriptpubkey)
     {
     #ifdef ENABLE_SLP_PARSE_ERROR_PRINTING
         #define PARSE_CHECK(cond, msg) {\
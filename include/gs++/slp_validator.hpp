@@ -2,6 +2,9 @@
 #define GS_SLP_VALIDATOR_HPP
 
 #include <vector>
+#include <deque>
+#include <functional>
+#include <cstdint>
 
 #include <absl/container/flat_hash_map.h>
 #include <absl/container/flat_hash_set.h>
@@ -18,15 +21,35 @@ struct slp_validator
     absl::flat_hash_map<gs::txid, gs::transaction> transaction_map;
     absl::flat_hash_set<gs::txid> valid;
 
+    // with pruning enabled transactions are dropped once every token output is spent
+    // this bounds memory by the token utxo set, pruned txdata only lives in txgraph
+    bool pruning = false;
+    absl::flat_hash_map<gs::txid, std::vector<std::uint32_t>> unspent_outputs; // vouts holding tokens or baton
+    std::deque<std::pair<std::uint32_t, gs::txid>> fully_spent; // ordered by height of last spend
+
     slp_validator() = default;
 
     bool add_tx(const gs::transaction& tx);
+    // inserts tx as valid without running validate, only use this for
+    // transactions which were already validated (ex: assume valid cache)
+    bool add_assumed_valid_tx(const gs::transaction& tx);
     bool remove_tx(const gs::txid& txid);
     bool add_valid_txid(const gs::txid& txid);
     bool has(const gs::txid& txid) const;
     bool has_valid(const gs::txid& txid) const;
     gs::transaction get(const gs::txid& txid) const;
 
+    void track_outputs(const gs::transaction& tx);
+    // call for every confirmed transaction, including ones which are not valid
+    // returns the tracked outputs it spent so a reorg can unspend them
+    std::vector<gs::outpoint> spend_inputs(const gs::transaction& tx, const std::uint32_t height);
+    // same for inputs of transactions we do not keep, ex: block.skipped_inputs
+    std::vector<gs::outpoint> spend_inputs(const std::vector<gs::outpoint>& inputs, const std::uint32_t height);
+    void unspend_output(const gs::outpoint& outpoint);
+    // drops transactions which became fully spent at or below max_height
+    // returns amount of transactions pruned
+    std::size_t prune(const std::uint32_t max_height);
+
     bool check_outputs_valid(
         absl::flat_hash_set<gs::txid> & seen,
         const gs::transaction & tx
@@ -41,6 +64,14 @@ struct slp_validator
 
     bool validate(const gs::transaction & tx);
     bool validate(const gs::txid & txid);
+
+    // for a tx which failed validation, the unknown parents it waits on when it
+    // is short of token input they could bring, empty if no parent can make it valid
+    // is_known marks outputs which exist but never carry tokens, ex: plain bch
+    std::vector<gs::txid> missing_token_parents(
+        const gs::transaction & tx,
+        const std::function<bool(const gs::outpoint&)> & is_known
+    ) const;
 };
 
 }
@@ -12,6 +12,7 @@
 #include <gs++/bhash.hpp>
 #include <gs++/slp_token.hpp>
 #include <gs++/slp_transaction.hpp>
+#include <gs++/utxo_undo.hpp>
 
 
 namespace gs {
@@ -158,6 +159,57 @@ struct slpdb
             // spdlog::info("send end");
         }
     }
+
+    // reverses what connecting a block did to tokens, see bch::process_block
+    void rollback(const gs::utxo_undo& undo)
+    {
+        boost::lock_guard<boost::shared_mutex> lock(lookup_mtx);
+
+        // token utxos the block spent
+        for (auto & m : undo.slp_removed) {
+            auto token_search = tokens.find(m.tokenid);
+            if (token_search == tokens.end()) {
+                continue;
+            }
+
+            token_search->second.utxos.emplace(m.output.outpoint, m.output);
+            utxo_to_tokenid.insert({ m.output.outpoint, m.tokenid });
+        }
+
+        // token utxos the block created, ones it also spent were put back above and go again here
+        for (std::size_t i=0; i<undo.added_count(); ++i) {
+            const gs::outpoint outpoint = undo.added_outpoint(i);
+            auto utxo_to_tokenid_search = utxo_to_tokenid.find(outpoint);
+            if (utxo_to_tokenid_search == utxo_to_tokenid.end()) {
+                continue;
+            }
+
+            auto token_search = tokens.find(utxo_to_tokenid_search->second);
+            if (token_search != tokens.end()) {
+                token_search->second.utxos.erase(outpoint);
+            }
+            utxo_to_tokenid.erase(utxo_to_tokenid_search);
+        }
+
+        for (auto it = undo.slp_txs.rbegin(); it != undo.slp_txs.rend(); ++it) {
+            if (it->first.v == it->second.v) {
+                tokens.erase(it->first);
+                continue;
+            }
+
+            auto token_search = tokens.find(it->first);
+            if (token_search != tokens.end()) {
+                token_search->second.transactions.erase(it->second);
+            }
+        }
+
+        for (auto & m : undo.slp_batons) {
+            auto token_search = tokens.find(m.first);
+            if (token_search != tokens.end()) {
+                token_search->second.mint_baton_outpoint = m.second;
+            }
+        }
+    }
 };
 
 }
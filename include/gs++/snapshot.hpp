@@ -0,0 +1,46 @@
+#ifndef GS_SNAPSHOT_HPP
+#define GS_SNAPSHOT_HPP
+
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <gs++/txgraph.hpp>
+#include <gs++/slp_validator.hpp>
+#include <gs++/bhash.hpp>
+
+namespace gs {
+
+// binary image of the txgraph, the validator and the block it was taken at
+// so startup can skip replaying the block cache up to that block
+//
+// sections follow a header of magic, version, height and block hash:
+//   tokens     tokenid, nodes as txid, txdata and inputs by index within the token
+//   validator  txid and either the index of the graph node holding its txdata or the txdata
+//   valid      txids
+//   pruning    unspent outputs and the fully spent queue
+// and a crc32 of everything before it
+struct snapshot_tip
+{
+    std::uint32_t height;
+    gs::blockhash hash;
+};
+
+// writes to path.tmp and renames over path once synced so a crash keeps the old snapshot
+// IMPORTANT: the validator must not change while saving, the graph is locked here
+bool save_snapshot(
+    const std::string& path,
+    gs::txgraph& g,
+    const gs::slp_validator& validator,
+    const snapshot_tip& tip
+);
+
+// g and validator must be empty, on failure they are left partially filled
+std::pair<bool, snapshot_tip> load_snapshot(
+    const std::string& path,
+    gs::txgraph& g,
+    gs::slp_validator& validator
+);
+
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include <cstdint>
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 
 #include <absl/types/variant.h>
@@ -16,6 +17,7 @@
 #include <gs++/util.hpp>
 #include <gs++/output.hpp>
 #include <gs++/slp_transaction.hpp>
+#include <gs++/hash.hpp>
 
 #include <3rdparty/sha2.h>
 
@@ -108,10 +110,7 @@ struct transaction
             }
             
             CHECK_END(script_len);
-            std::vector<std::uint8_t> sigscript;
-            sigscript.resize(script_len);
-            std::copy(it, it+script_len, sigscript.begin());
-            it+=script_len;
+            it+=script_len; // sigscript
 
             CHECK_END(4);
             const std::uint32_t sequence { gs::util::extract_u32(it) };
@@ -159,8 +158,7 @@ struct transaction
         serialized.resize(tx_end_it - begin_it);
         std::copy(begin_it, tx_end_it, serialized.begin());
 
-        sha256(serialized.data(), serialized.size(), this->txid.v.data());
-        sha256(this->txid.v.data(), this->txid.v.size(), this->txid.v.data());
+        gs::sha256d(serialized.data(), serialized.size(), this->txid.v.data());
 
         for (auto & m : this->outputs) {
             m.prev_tx_id = this->txid;
@@ -189,6 +187,81 @@ struct transaction
     }
 };
 
+// non-owning parse of a serialized transaction, data must outlive the view
+// nothing is copied or hashed until asked for, so transactions we skip stay cheap
+struct transaction_view
+{
+    const std::uint8_t * data;
+    std::size_t          size; // of serialized transaction
+    std::int32_t         version;
+    std::uint32_t        lock_time;
+    std::uint64_t        in_count;
+    std::uint64_t        out_count;
+    std::size_t          inputs_offset;       // first input
+    std::size_t          outputs_offset;      // first output
+    std::size_t          first_script_offset; // scriptpubkey of output 0
+    std::size_t          first_script_len;
+
+    transaction_view()
+    : data(nullptr)
+    , size(0)
+    , version(0)
+    , lock_time(0)
+    , in_count(0)
+    , out_count(0)
+    , inputs_offset(0)
+    , outputs_offset(0)
+    , first_script_offset(0)
+    , first_script_len(0)
+    {}
+
+    // accepts and rejects exactly what transaction::hydrate does
+    bool parse(const std::uint8_t * begin, const std::uint8_t * end);
+
+    gs::txid compute_txid() const;
+
+    // points script at output 0 if it is an OP_RETURN
+    bool op_return(const std::uint8_t *& script, std::size_t& script_len) const;
+
+    // cheap pre-filter, true if output 0 begins with OP_RETURN and the SLP lokad id
+    // never false for a transaction slp_transaction would parse as valid
+    bool slp_candidate() const;
+
+    // f(const gs::txid& prev_tx_id, std::uint32_t prev_out_idx)
+    template <typename F>
+    void for_each_input(F f) const
+    {
+        const std::uint8_t * it = data + inputs_offset;
+        for (std::uint64_t in_i=0; in_i<in_count; ++in_i) {
+            gs::txid prev_tx_id;
+            std::memcpy(prev_tx_id.v.data(), it, 32);
+            it+=32;
+            const std::uint32_t prev_out_idx { gs::util::extract_u32(it) };
+            const std::uint64_t script_len   { gs::util::extract_var_int(it) };
+            it+=script_len+4; // sigscript and sequence
+            f(prev_tx_id, prev_out_idx);
+        }
+    }
+
+    // f(std::uint32_t vout, std::uint64_t value, const std::uint8_t * script, std::size_t script_len)
+    template <typename F>
+    void for_each_output(F f) const
+    {
+        const std::uint8_t * it = data + outputs_offset;
+        for (std::uint32_t out_i=0; out_i<out_count; ++out_i) {
+            const std::int64_t  value      { std::abs(gs::util::extract_i64(it)) };
+            const std::uint64_t script_len { gs::util::extract_var_int(it) };
+            f(out_i, value, it, script_len);
+            it+=script_len;
+        }
+    }
+
+    // builds the owning transaction, same result as transaction::hydrate
+    void materialize(gs::transaction& tx) const;
+    // for when the txid was already computed, ex: batch hashed with sha256d_many
+    void materialize(gs::transaction& tx, const gs::txid& txid) const;
+};
+
 }
 
 std::ostream & operator<<(std::ostream &os, const gs::transaction & tx);
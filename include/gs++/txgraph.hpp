@@ -43,11 +43,18 @@ struct txgraph
 
     bool has_tx(const gs::txid& lookup_txid);
 
+    // serialized transaction, ex: for one the validator pruned
+    std::pair<bool, std::vector<std::uint8_t>> get_txdata(const gs::txid& lookup_txid);
+
     unsigned insert_token_data (
         const gs::tokenid & tokenid,
         const std::vector<gs::transaction> & txs
     );
 
+    // nodes of txids must not be inputs of nodes which stay, ex: remove
+    // everything inserted after some point as a reorg does
+    unsigned remove_txs(const std::vector<gs::txid> & txids);
+
 };
 
 }
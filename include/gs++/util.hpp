@@ -2,12 +2,14 @@
 #define GS_UTIL_HPP
 
 #include <cstdint>
+#include <cstring>
 #include <algorithm>
 #include <vector>
 #include <cassert>
 #include <array>
 #include <string>
 #include <iostream>
+#include <utility>
 
 // You must include gs++/transaction.hpp before including this file
 
@@ -51,6 +53,35 @@ std::uint64_t extract_u64(Iterator & it)
     return ret;
 }
 
+// contiguous ranges are read with memcpy which compiles to a single unaligned load
+// this is picked over the generic versions above for any pointer type
+template <typename T>
+std::uint16_t extract_u16(T * & it)
+{
+    std::uint16_t ret;
+    std::memcpy(&ret, it, 2);
+    it+=2;
+    return ret;
+}
+
+template <typename T>
+std::uint32_t extract_u32(T * & it)
+{
+    std::uint32_t ret;
+    std::memcpy(&ret, it, 4);
+    it+=4;
+    return ret;
+}
+
+template <typename T>
+std::uint64_t extract_u64(T * & it)
+{
+    std::uint64_t ret;
+    std::memcpy(&ret, it, 8);
+    it+=8;
+    return ret;
+}
+
 template <typename Iterator>
 std::int8_t extract_i8(Iterator & it)
 {
@@ -85,6 +116,24 @@ std::int64_t extract_i64(Iterator & it)
     return ret;
 }
 
+template <typename T>
+std::uint32_t extract_i32(T * & it)
+{
+    std::int32_t ret;
+    std::memcpy(&ret, it, 4);
+    it+=4;
+    return ret;
+}
+
+template <typename T>
+std::int64_t extract_i64(T * & it)
+{
+    std::int64_t ret;
+    std::memcpy(&ret, it, 8);
+    it+=8;
+    return ret;
+}
+
 template <typename Iterator>
 std::size_t var_int_additional_size(const Iterator & it)
 {
@@ -142,10 +191,10 @@ std::vector<std::uint8_t> unhex(const Container& v_)
         const char p2 = v_[(i<<1)+1];
 
 #ifndef NDEBUG
-        if ((p1 >= '0' && p1 <= '9') || (p1 >= 'a' && p1 <= 'f')) {
+        if (! ((p1 >= '0' && p1 <= '9') || (p1 >= 'a' && p1 <= 'f'))) {
             std::cerr << "unhex p1 out of range (DEBUG MODE IS ON)\n";
         }
-        if ((p2 >= '0' && p2 <= '9') || (p2 >= 'a' && p2 <= 'f')) {
+        if (! ((p2 >= '0' && p2 <= '9') || (p2 >= 'a' && p2 <= 'f'))) {
             std::cerr << "unhex p2 out of range (DEBUG MODE IS ON)\n";
         }
 #endif
@@ -157,10 +206,24 @@ std::vector<std::uint8_t> unhex(const Container& v_)
     return ret;
 }
 
-std::vector<gs::transaction> topological_sort(
+// indices of tx_list ordered so parents come before their children
+// duplicate txids are left out, already sorted input keeps its order
+std::vector<std::size_t> topological_order(
     const std::vector<gs::transaction>& tx_list
 );
 
+// pass an rvalue to sort without copying transactions
+std::vector<gs::transaction> topological_sort(
+    std::vector<gs::transaction> tx_list
+);
+
+// locates the "result" string of a json-rpc batch response holding one reply
+// without building a json document, returns its offset and length within body
+// anything unexpected fails, including a non null error, so callers can fall back to a full parse
+std::pair<bool, std::pair<std::size_t, std::size_t>> json_rpc_result_string(
+    const std::string& body
+);
+
 }
 
 }
@@ -0,0 +1,40 @@
+#ifndef GS_UTXO_CHECKPOINT_HPP
+#define GS_UTXO_CHECKPOINT_HPP
+
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <gs++/utxodb.hpp>
+#include <gs++/snapshot.hpp>
+
+namespace gs {
+
+// binary image of the confirmed utxo set so utxosync can start from it
+// instead of replaying every block from [utxo] block_height
+//
+//   header  magic, version, height, block hash, output count and utxo commitment flag u8 and hash
+//   chunks  outputs as txid, var_int vout, value and script length, and script
+//   table   offset u64, output count u64 and crc32 of every chunk
+//   footer  chunk count u64 and crc32 of the header and table
+//
+// chunks are verified and parsed independently so loading scales with cores
+// the mempool and the undo journal are not part of it
+//
+// writes to path.tmp and renames over path once synced so a crash keeps the old checkpoint
+bool save_utxo_checkpoint(
+    const std::string& path,
+    gs::utxodb& utxodb
+);
+
+// utxodb must be empty, on failure it is left partially filled
+// with utxodb.commitment_enabled the commitment is rebuilt from the outputs and checked
+// the tip is also set as the utxodb current block, threads 0 uses every core
+std::pair<bool, snapshot_tip> load_utxo_checkpoint(
+    const std::string& path,
+    gs::utxodb& utxodb,
+    const std::size_t threads = 0
+);
+
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef GS_UTXO_UNDO_HPP
+#define GS_UTXO_UNDO_HPP
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <absl/types/optional.h>
+#include <gs++/bhash.hpp>
+#include <gs++/output.hpp>
+#include <gs++/slp_transaction.hpp>
+
+namespace gs {
+
+// what connecting one block changed in the utxodb and slpdb
+//
+// spent outputs are packed back to back into one buffer instead of one
+// gs::output (and scriptpubkey allocation) each:
+// txid 32 | var_int vout | var_int value | var_int script length | script
+// created outputs are stored as an index into the block txids and a vout
+struct utxo_undo
+{
+    struct slp_utxo
+    {
+        gs::tokenid    tokenid;
+        gs::slp_output output;
+    };
+
+    std::uint32_t              height;
+    gs::blockhash              hash;
+    gs::blockhash              prev_hash;
+
+    std::vector<gs::txid>      txids;   // transactions with created outputs, in block order
+    std::vector<std::uint32_t> added;   // pairs of index into txids and vout
+    std::vector<std::uint8_t>  removed; // packed spent outputs
+    std::uint32_t              removed_count;
+
+    std::vector<slp_utxo> slp_removed; // token utxos the block spent
+    std::vector<std::pair<gs::tokenid, gs::txid>> slp_txs; // token transactions added, a genesis has tokenid == txid
+    std::vector<std::pair<gs::tokenid, absl::optional<gs::outpoint>>> slp_batons; // mint batons before the block, one per token
+
+    utxo_undo()
+    : height(0)
+    , removed_count(0)
+    {}
+
+    // the next created outputs belong to txid
+    void push_tx(const gs::txid& txid);
+
+    // an output of the last pushed tx
+    void push_added(const std::uint32_t vout);
+
+    void push_removed(const gs::output& o);
+
+    // records the baton of a token the first time the block touches it
+    void push_baton(const gs::tokenid& tokenid, const absl::optional<gs::outpoint>& baton);
+
+    std::size_t added_count() const
+    { return added.size() / 2; }
+
+    gs::outpoint added_outpoint(const std::size_t i) const
+    { return gs::outpoint(txids[added[2*i]], added[2*i+1]); }
+
+    // unpacks every spent output in the order they were pushed
+    std::vector<gs::output> removed_outputs() const;
+
+    // bytes held by the record
+    std::size_t memory_usage() const;
+};
+
+}
+
+#endif
@@ -8,25 +8,35 @@
 #include <absl/container/flat_hash_map.h>
 #include <absl/container/node_hash_map.h>
 #include <absl/container/flat_hash_set.h>
+#include <gs++/bhash.hpp>
 #include <gs++/output.hpp>
 #include <gs++/rpc_json.hpp>
 #include <gs++/scriptpubkey.hpp>
+#include <gs++/utxo_undo.hpp>
+#include <gs++/ecmh.hpp>
+#include <gs++/compact_utxo.hpp>
 
 namespace gs {
 
 struct utxodb
 {
-    constexpr static std::uint32_t rollback_depth { 10 };
-
     boost::shared_mutex lookup_mtx; // IMPORTANT: lookups/inserts must be guarded with the lookup_mtx
 
     std::uint32_t current_block_height;
-    std::string   current_block_hash;
+    gs::blockhash current_block_hash;
 
-    absl::node_hash_map<gs::outpoint, gs::output>
+    bool     commitment_enabled; // IMPORTANT: only switch before the first output is added
+    gs::ecmh commitment;         // of the outputs in outpoint_map, mempool outputs are left out
+
+    // confirmed outputs are kept compact, see compact_utxo.hpp
+    // IMPORTANT: use add_output/remove_output so the interned refs stay counted
+    gs::interner<gs::txid>         txids;   // of transactions with unspent confirmed outputs
+    gs::interner<gs::scriptpubkey> scripts; // confirmed scripts which fit no template
+
+    absl::flat_hash_map<gs::utxo_key, gs::utxo_entry>
     outpoint_map;
-    
-    absl::flat_hash_map<gs::scriptpubkey, absl::flat_hash_set<gs::output*>>
+
+    absl::flat_hash_map<gs::script_ref, absl::flat_hash_set<gs::utxo_key>>
     scriptpubkey_to_output;
 
     absl::node_hash_map<gs::outpoint, gs::output>
@@ -38,12 +48,44 @@ struct utxodb
     absl::flat_hash_set<gs::outpoint>
     mempool_spent_confirmed_outpoints; // contains the outpoints that have been spent
 
-    std::deque<std::vector<gs::output>>   last_block_removed;
-    std::deque<std::vector<gs::outpoint>> last_block_added;
+    std::size_t rollback_depth; // blocks which can be rolled back, 0 disables recording
+    std::deque<gs::utxo_undo> undo_journal; // oldest first
 
     utxodb();
 
-    void rollback();
+    // IMPORTANT: the functions down to to_output must be guarded with the lookup_mtx
+    // adds a confirmed output, false if its outpoint is already there
+    bool add_output(const gs::output& o);
+
+    // removes a confirmed output and hands it back, false if it is not there
+    bool remove_output(const gs::outpoint& outpoint, gs::output& removed);
+
+    // copies a confirmed output out, false if it is not there
+    bool find_output(const gs::outpoint& outpoint, gs::output& found) const;
+
+    // stores o without indexing its script, for loaders which index in bulk
+    // returns false if its outpoint is already there
+    std::pair<bool, gs::utxo_key> store_output(const gs::output& o);
+
+    // the ref scriptpubkey is stored under, false if no output has it
+    bool find_script_ref(const gs::scriptpubkey& scriptpubkey, gs::script_ref& ref) const;
+
+    gs::output to_output(const gs::utxo_key& key, const gs::utxo_entry& entry) const;
+
+    // IMPORTANT: must be guarded with the lookup_mtx
+    // keeps the record of the block just connected, the oldest one past rollback_depth is dropped
+    void push_undo(gs::utxo_undo&& undo);
+
+    // disconnects the newest recorded block and hands its record back
+    // so the caller can undo what else the block changed
+    // returns false if no block is recorded
+    bool rollback(gs::utxo_undo& undone);
+
+    // bytes held by the undo journal
+    std::size_t undo_memory_usage();
+
+    // approximate bytes held by the confirmed outputs and their index
+    std::size_t memory_usage();
 
     std::vector<gs::output> get_outputs_by_outpoints(
         const std::vector<gs::outpoint> outpoints
@@ -57,19 +99,6 @@ struct utxodb
     std::uint64_t get_balance_by_scriptpubkey(
         const gs::scriptpubkey scriptpubkey
     );
-
-    template <typename H>
-    friend H AbslHashValue(H h, const utxodb& m)
-    {
-        return H::combine(
-            std::move(h),
-            m.outpoint_map,
-            m.scriptpubkey_to_output,
-            m.last_block_removed,
-            m.last_block_added
-        );
-    }
-
 };
 
 }
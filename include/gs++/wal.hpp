@@ -0,0 +1,96 @@
+#ifndef GS_WAL_HPP
+#define GS_WAL_HPP
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <boost/thread.hpp>
+#include <gs++/bhash.hpp>
+
+namespace gs {
+
+// append only log of transactions applied outside of blocks and of block boundaries
+// appends only buffer, a background thread writes and fsyncs everything buffered
+// once per sync interval so callers never wait on the disk (group commit)
+// reset only drops the buffer, the flusher truncates the file before writing again
+//
+// record layout: type u8, length u32, crc32 of type and payload u32, payload
+// a tx record holds the serialized transaction, a block record height u32 and hash
+struct wal
+{
+    enum class record_type : std::uint8_t
+    {
+        tx    = 1,
+        block = 2,
+    };
+
+    struct record
+    {
+        record_type               type;
+        std::vector<std::uint8_t> data;
+    };
+
+    std::chrono::milliseconds sync_interval;
+
+    int fd;
+    std::vector<std::uint8_t> pending;
+    std::uint64_t appended;    // records buffered since open
+    std::uint64_t synced;      // records known to be on disk
+    std::uint64_t sync_target; // highest record a sync() waits for
+    std::uint64_t resets;      // resets requested, the flusher empties the file before its next write
+    std::uint64_t resets_done; // resets the flusher has applied
+    bool failed;               // a write failed, nothing more is written and later syncs report it
+    bool stopping;
+    boost::mutex mtx; // IMPORTANT: all of the above must be guarded with the mtx
+    boost::condition_variable cv;
+
+    std::thread flusher;
+
+    wal(const std::chrono::milliseconds sync_interval = std::chrono::milliseconds(100))
+    : sync_interval(sync_interval)
+    , fd(-1)
+    , appended(0)
+    , synced(0)
+    , sync_target(0)
+    , resets(0)
+    , resets_done(0)
+    , failed(false)
+    , stopping(false)
+    {}
+
+    // flushes pending records
+    ~wal();
+
+    wal(const wal&) = delete;
+    wal& operator=(const wal&) = delete;
+
+    // returns every intact record of the log at path, stopping at a torn tail
+    static std::pair<bool, std::vector<record>> read(const std::string& path);
+
+    // drops a torn tail and starts the flusher
+    bool open(const std::string& path);
+    void close();
+
+    void append_tx(const std::vector<std::uint8_t>& serialized);
+    void append_block(const std::uint32_t height, const gs::blockhash& hash);
+
+    // waits until every record appended so far is on disk
+    bool sync();
+
+    // empties the log, ex: once a snapshot holds everything in it
+    // records appended after this survive, the file is truncated by the flusher
+    bool reset();
+
+    static std::pair<std::uint32_t, gs::blockhash> decode_block(const record& r);
+
+private:
+    void append(const record_type type, const std::uint8_t* data, const std::size_t len);
+    void flush_loop();
+};
+
+}
+
+#endif
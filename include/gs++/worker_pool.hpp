@@ -0,0 +1,130 @@
+#ifndef GS_WORKER_POOL_HPP
+#define GS_WORKER_POOL_HPP
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <boost/thread.hpp>
+
+namespace gs {
+
+// threads kept for the life of the pool, so per thread state such as
+// thread_local contexts is built once rather than on every call
+// run may be called from several threads at once
+struct worker_pool
+{
+    std::deque<std::function<void()>> jobs;
+    bool stopping;
+    boost::mutex mtx; // IMPORTANT: jobs and stopping must be guarded with the mtx
+    boost::condition_variable cv;
+
+    std::vector<std::thread> workers;
+
+    explicit worker_pool(const std::size_t threads)
+    : stopping(false)
+    {
+        for (std::size_t i=0; i<threads; ++i) {
+            workers.emplace_back([this] { work(); });
+        }
+    }
+
+    // jobs not started yet are dropped
+    ~worker_pool()
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+
+        for (auto & w : workers) {
+            w.join();
+        }
+    }
+
+    worker_pool(const worker_pool&) = delete;
+    worker_pool& operator=(const worker_pool&) = delete;
+
+    std::size_t size() const
+    { return workers.size(); }
+
+    // calls f(0) .. f(n-1) on up to helpers workers and the calling thread
+    // and returns once every call is done
+    void run(
+        const std::size_t n,
+        const std::function<void(std::size_t)>& f,
+        std::size_t helpers
+    ) {
+        // helpers which only get to run after all indices are claimed touch nothing but this
+        struct state
+        {
+            std::atomic<std::size_t> next;
+            std::size_t done; // guarded by mtx
+            boost::mutex mtx;
+            boost::condition_variable cv;
+        };
+        auto s = std::make_shared<state>();
+        s->next = 0;
+        s->done = 0;
+
+        const std::function<void(std::size_t)>* fp = &f;
+        auto claim = [s, fp, n]() {
+            std::size_t finished = 0;
+            for (std::size_t i = s->next++; i < n; i = s->next++) {
+                (*fp)(i);
+                ++finished;
+            }
+            if (finished > 0) {
+                boost::lock_guard<boost::mutex> lock(s->mtx);
+                s->done += finished;
+                if (s->done == n) {
+                    s->cv.notify_all();
+                }
+            }
+        };
+
+        helpers = std::min(helpers, std::min(n, workers.size()));
+        if (helpers > 0) {
+            {
+                boost::lock_guard<boost::mutex> lock(mtx);
+                for (std::size_t i=0; i<helpers; ++i) {
+                    jobs.push_back(claim);
+                }
+            }
+            cv.notify_all();
+        }
+
+        claim();
+
+        boost::unique_lock<boost::mutex> lock(s->mtx);
+        s->cv.wait(lock, [&] { return s->done == n; });
+    }
+
+    void work()
+    {
+        while (true) {
+            std::function<void()> job;
+            {
+                boost::unique_lock<boost::mutex> lock(mtx);
+                cv.wait(lock, [this] { return stopping || ! jobs.empty(); });
+                if (stopping) {
+                    return;
+                }
+
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            job();
+        }
+    }
+};
+
+}
+
+#endif
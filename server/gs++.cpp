@@ -2,14 +2,16 @@
 #include <string>
 #include <vector>
 #include <thread>
+#include <deque>
 #include <regex>
 #include <atomic>
 #include <chrono>
 #include <fstream>
 #include <iterator>
+#include <limits>
 #include <cstdlib>
 #include <cstdint>
-#include <csignal>
+#include <signal.h>
 
 #include <boost/thread.hpp>
 #include <boost/filesystem.hpp>
@@ -35,9 +37,20 @@
 #include <gs++/slp_transaction.hpp>
 #include <gs++/block.hpp>
 #include <gs++/slp_validator.hpp>
+#include <gs++/lru_cache.hpp>
+#include <gs++/orphan_pool.hpp>
+#include <gs++/prefetcher.hpp>
+#include <gs++/block_pack.hpp>
+#include <gs++/snapshot.hpp>
+#include <gs++/wal.hpp>
+#include <gs++/ingest_queue.hpp>
+#include <gs++/reorg_journal.hpp>
+#include <gs++/utxo_checkpoint.hpp>
 #include <gs++/util.hpp>
+#include <gs++/worker_pool.hpp>
 
 std::unique_ptr<grpc::Server> gserver;
+boost::mutex gserver_mtx; // IMPORTANT: gserver must be guarded with the gserver_mtx once signals are waited on
 std::atomic<int>           current_block_height = { 543375 };
 std::atomic<gs::blockhash> current_block_hash(
     std::string("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff")
@@ -58,20 +71,75 @@ std::atomic<std::uint64_t> last_incoming_zmq_blk_size { 0 };
 std::atomic<std::uint64_t> last_outgoing_zmq_blk_size { 0 };
 
 std::atomic<bool> exit_early = { false };
+std::atomic<bool> resync_required = { false }; // a reorg could not be applied, our state may be on a branch the node dropped
+
+// raw message from the bitcoind zmq feed, kept alive so transactions can be relayed as received
+struct zmq_ingest_item
+{
+    bool block;
+    zmq::message_t msg;
+};
+// filled by bitcoind_zmq_listener, drained in arrival order by bitcoind_zmq_applier
+std::unique_ptr<gs::ingest_queue<zmq_ingest_item>> zmq_ingest;
+std::size_t ingest_batch_size = 500;
 
 boost::shared_mutex processing_mutex;
 
 std::atomic<bool> startup_processing_mempool = { true };
 std::vector<gs::transaction> startup_mempool_transactions;
+boost::mutex startup_mempool_mtx; // IMPORTANT: startup_mempool_transactions and clearing startup_processing_mempool must be guarded with the startup_mempool_mtx
+
+// queues tx to be applied with the startup mempool
+// returns false once that was applied, tx must then be processed like any other
+bool startup_mempool_add(const gs::transaction& tx)
+{
+    boost::lock_guard<boost::mutex> lock(startup_mempool_mtx);
+    if (! startup_processing_mempool) {
+        return false;
+    }
+
+    if (tx.slp.type != gs::slp_transaction_type::invalid) {
+        startup_mempool_transactions.push_back(tx);
+    }
+
+    return true;
+}
 
 std::size_t max_exclusion_set_size = 5;
+std::uint32_t prune_depth = 0; // 0 disables validator pruning
+constexpr std::size_t max_oracle_batch_size   = 10000;
+constexpr std::size_t oracle_batch_per_thread = 64; // below this signing is not worth a thread
 std::array<uint8_t, 32> private_key;
 std::atomic<secp256k1_context*> ctx;
+// signs OutputOracleBatch requests, its threads keep their context clones between requests
+std::unique_ptr<gs::worker_pool> oracle_pool;
 boost::filesystem::path cache_dir;
+// lowest cached height which only holds valid transactions, see cache_slp_block
+std::uint32_t cache_valid_only_height = std::numeric_limits<std::uint32_t>::max();
+gs::block_pack block_cache;
+std::string snapshot_path; // empty disables snapshots
+std::string wal_path; // empty disables the write-ahead log
+std::uint32_t snapshot_interval = 0;
+// last block applied to the validator and graph, height 0 until one is
+// IMPORTANT: must be guarded with the processing_mutex
+gs::snapshot_tip applied_tip { 0, gs::blockhash() };
+// transactions applied since the last block, replayed on startup, disabled if not open
+// IMPORTANT: appends must happen with the processing_mutex held so records keep apply order
+gs::wal tx_wal;
 
 gs::slp_validator validator;
+// mempool transactions waiting on a parent we have not seen yet
+gs::orphan_pool orphan_pool(10000, 3600);
+// non slp transactions seen in the tx stream, their outputs never carry tokens
+gs::lru_cache<gs::txid, bool> bch_txids(100000);
+bool utxosync_enabled = false; // confirmed outputs can then be looked up in bch.utxodb
+// signed OutputOracle replies, only cleared when the chain reorganizes
+gs::lru_cache<gs::outpoint, graphsearch::OutputOracleReply> oracle_cache(10000);
 gs::txgraph g;
 gs::bch bch;
+// undo records of the last blocks applied to the validator and graph
+// IMPORTANT: must be guarded with the processing_mutex
+gs::reorg_journal reorg_journal;
 
 const std::chrono::milliseconds await_time { 1000 };
 
@@ -97,10 +165,29 @@ std::string scriptpubkey_to_base64(const gs::scriptpubkey& pubkey)
     return b64;
 }
 
+// each signing thread gets its own clone of ctx so batches can be signed in parallel
+secp256k1_context* thread_secp256k1_context()
+{
+    struct context_holder
+    {
+        secp256k1_context* tctx;
+
+        context_holder()
+        : tctx(secp256k1_context_clone(ctx))
+        {}
+
+        ~context_holder()
+        { secp256k1_context_destroy(tctx); }
+    };
+
+    thread_local context_holder holder;
+    return holder.tctx;
+}
+
 std::array<uint8_t, 64> schnorr_sign(const std::array<uint8_t, 32>& msg)
 {
     std::array<uint8_t, 64> sig = { 0 };
-    if (secp256k1_schnorr_sign(ctx, sig.data(), msg.data(), private_key.data(), nullptr, nullptr) != 1) {
+    if (secp256k1_schnorr_sign(thread_secp256k1_context(), sig.data(), msg.data(), private_key.data(), nullptr, nullptr) != 1) {
         spdlog::warn("schnorr sign failed");
         sig = { 0 };
     }
@@ -108,10 +195,116 @@ std::array<uint8_t, 64> schnorr_sign(const std::array<uint8_t, 32>& msg)
     return sig;
 }
 
-void signal_handler(int signal)
-{
-    spdlog::info("received signal {} requesting to shut down", signal);
+// fills reply with the signed oracle message for outpoint
+// returns false if the outpoint does not belong to a valid slp transaction
+bool output_oracle_sign(
+    const gs::outpoint& outpoint,
+    graphsearch::OutputOracleReply* reply
+) {
+    if (oracle_cache.get(outpoint, *reply)) {
+        return true;
+    }
+
+    const gs::txid    txid = outpoint.txid;
+    const uint32_t    vout = outpoint.vout;
+
+    std::vector<uint8_t> preimage;
+    {
+        boost::shared_lock<boost::shared_mutex> lock(processing_mutex);
+
+        if (! validator.has_valid(txid)) {
+            return false;
+        }
+
+        const gs::transaction & tx = validator.transaction_map.at(txid);
+
+        const gs::tokenid tokenid   = tx.slp.tokenid;
+        const uint16_t    tokentype = tx.slp.token_type;
+        const uint64_t    value     = tx.output_slp_amount(vout);
+
+        if (tokentype == 0x01) {
+            preimage.resize(32+4+32+2+8+1); // txid, vout, tokenid, tokentype, tokenvalue, is_baton
+            std::memcpy(preimage.data()+0,  txid.data(),    32);
+            std::memcpy(preimage.data()+32, &vout,           4);
+            std::memcpy(preimage.data()+36, tokenid.data(), 32);
+            std::memcpy(preimage.data()+68, &tokentype,      2);
+            std::memcpy(preimage.data()+70, &value,          8);
+            const uint8_t is_baton = tx.mint_baton_outpoint().vout == vout;
+            std::memcpy(preimage.data()+78, &is_baton,       1);
+            // TODO debug, maybe remove in later release
+            reply->set_tx(tx.serialized.data(), tx.serialized.size());
+            reply->set_vout(vout);
+            reply->set_tokenid(tokenid.data(), tokenid.size());
+            reply->set_tokentype(tokentype);
+            reply->set_value(value);
+            reply->set_is_baton(is_baton);
+        } else if (tokentype == 0x081) {
+            preimage.resize(32+4+32+2+8+1); // txid, vout, tokenid, tokentype, tokenvalue, is_baton
+            std::memcpy(preimage.data()+0,  txid.data(),    32);
+            std::memcpy(preimage.data()+32, &vout,           4);
+            std::memcpy(preimage.data()+36, tokenid.data(), 32);
+            std::memcpy(preimage.data()+68, &tokentype,      2);
+            std::memcpy(preimage.data()+70, &value,          8);
+            const uint8_t is_baton = tx.mint_baton_outpoint().vout == vout;
+            std::memcpy(preimage.data()+78, &is_baton,  1);
+            // TODO debug, maybe remove in later release
+            reply->set_tx(tx.serialized.data(), tx.serialized.size());
+            reply->set_vout(vout);
+            reply->set_tokenid(tokenid.data(), tokenid.size());
+            reply->set_tokentype(tokentype);
+            reply->set_value(value);
+            reply->set_is_baton(is_baton);
+        } else if (tokentype == 0x041) {
+            preimage.resize(32+4+32+2+32); // txid, vout, tokenid, tokentype, 
+            std::memcpy(preimage.data()+0,  txid.data(),    32);
+            std::memcpy(preimage.data()+32, &vout,           4);
+            std::memcpy(preimage.data()+36, tokenid.data(), 32);
+            std::memcpy(preimage.data()+68, &tokentype,      2);
+            // TODO UNTESTED
+            const gs::outpoint& i_outpoint = tx.inputs[0];
+            gs::tokenid group_id;
+            if (validator.has(i_outpoint.txid)) {
+                group_id = validator.transaction_map.at(i_outpoint.txid).slp.tokenid;
+            } else {
+                // the group parent was pruned once spent, txgraph still has it
+                const std::pair<bool, std::vector<std::uint8_t>> txdata = g.get_txdata(i_outpoint.txid);
+                gs::transaction txi;
+                if (! txdata.first || ! txi.hydrate(txdata.second.begin(), txdata.second.end())) {
+                    return false;
+                }
+                group_id = txi.slp.tokenid;
+            }
+            std::memcpy(preimage.data()+70, &group_id,  32);
+            // TODO debug, maybe remove in later release
+            reply->set_tx(tx.serialized.data(), tx.serialized.size());
+            reply->set_vout(vout);
+            reply->set_tokenid(tokenid.data(), tokenid.size());
+            reply->set_tokentype(tokentype);
+            reply->set_groupid(group_id.data(), group_id.size());
+        }
 
+        spdlog::debug("{} {} {} {}", txid.decompress(true), vout, tokenid.decompress(true), value);
+    }
+
+    spdlog::debug("{}", gs::util::hex(preimage));
+
+    std::array<uint8_t, 32> msg;
+    sha256(preimage.data(), preimage.size(), msg.data());
+
+    const std::array<uint8_t, 64> sig = schnorr_sign(msg);
+
+    reply->set_msg(msg.data(), msg.size());
+    reply->set_sig(sig.data(), sig.size());
+
+    oracle_cache.put(outpoint, *reply);
+
+    return true;
+}
+
+// stops the grpc server, main then finishes up
+void request_shutdown()
+{
+    boost::lock_guard<boost::mutex> lock(gserver_mtx);
     exit_early = true;
 
     if (gserver) {
@@ -121,6 +314,18 @@ void signal_handler(int signal)
     }
 }
 
+// SIGINT and SIGTERM are blocked in every thread and picked up here
+// so shutting down runs outside of signal context
+void signal_waiter(sigset_t signals)
+{
+    int signal = 0;
+    while (sigwait(&signals, &signal) != 0) {}
+
+    spdlog::info("received signal {} requesting to shut down", signal);
+
+    request_shutdown();
+}
+
 class GraphSearchServiceImpl final
  : public graphsearch::GraphSearchService::Service
 {
@@ -214,7 +419,9 @@ class GraphSearchServiceImpl final
         if (rmatch) {
             const gs::txid lookup_txid(request->txid());
             lookup_txid_str = lookup_txid.decompress(true);
-            const bool valid_tx = validator.has_valid(lookup_txid);
+            // pruned transactions are only left in the graph
+            const bool valid_tx = validator.has_valid(lookup_txid)
+                               || (validator.pruning && g.has_tx(lookup_txid));
             reply->set_valid(valid_tx);
         }
         const auto end = std::chrono::steady_clock::now();
@@ -244,86 +451,11 @@ class GraphSearchServiceImpl final
         static const std::regex txid_regex("^[0-9a-fA-F]{64}$");
         const bool rmatch = std::regex_match(request->txid(), txid_regex);
         bool valid_tx = false;
-        gs::transaction tx;
         if (rmatch) {
             const gs::txid lookup_txid(request->txid());
             lookup_txid_str = lookup_txid.decompress(true);
-            valid_tx = validator.has_valid(lookup_txid);
-            if (valid_tx) {
-                gs::transaction tx = validator.get(lookup_txid);
-                lookup_vout = request->vout();
-
-                const gs::txid    txid      = lookup_txid;
-                const uint32_t    vout      = lookup_vout;
-                const gs::tokenid tokenid   = tx.slp.tokenid;
-                const uint16_t    tokentype = tx.slp.token_type;
-                const uint64_t    value     = tx.output_slp_amount(vout);
-
-                std::vector<uint8_t> preimage;
-                if (tokentype == 0x01) {
-                    preimage.resize(32+4+32+2+8+1); // txid, vout, tokenid, tokentype, tokenvalue, is_baton
-                    std::memcpy(preimage.data()+0,  txid.data(),    32);
-                    std::memcpy(preimage.data()+32, &vout,           4);
-                    std::memcpy(preimage.data()+36, tokenid.data(), 32);
-                    std::memcpy(preimage.data()+68, &tokentype,      2);
-                    std::memcpy(preimage.data()+70, &value,          8);
-                    const uint8_t is_baton = tx.mint_baton_outpoint().vout == vout;
-                    std::memcpy(preimage.data()+78, &is_baton,       1);
-                    // TODO debug, maybe remove in later release
-                    reply->set_tx(tx.serialized.data(), tx.serialized.size());
-                    reply->set_vout(vout);
-                    reply->set_tokenid(tokenid.data(), tokenid.size());
-                    reply->set_tokentype(tokentype);
-                    reply->set_value(value);
-                    reply->set_is_baton(is_baton);
-                } else if (tokentype == 0x081) {
-                    preimage.resize(32+4+32+2+8+1); // txid, vout, tokenid, tokentype, tokenvalue, is_baton
-                    std::memcpy(preimage.data()+0,  txid.data(),    32);
-                    std::memcpy(preimage.data()+32, &vout,           4);
-                    std::memcpy(preimage.data()+36, tokenid.data(), 32);
-                    std::memcpy(preimage.data()+68, &tokentype,      2);
-                    std::memcpy(preimage.data()+70, &value,          8);
-                    const uint8_t is_baton = tx.mint_baton_outpoint().vout == vout;
-                    std::memcpy(preimage.data()+78, &is_baton,  1);
-                    // TODO debug, maybe remove in later release
-                    reply->set_tx(tx.serialized.data(), tx.serialized.size());
-                    reply->set_vout(vout);
-                    reply->set_tokenid(tokenid.data(), tokenid.size());
-                    reply->set_tokentype(tokentype);
-                    reply->set_value(value);
-                    reply->set_is_baton(is_baton);
-                } else if (tokentype == 0x041) {
-                    preimage.resize(32+4+32+2+32); // txid, vout, tokenid, tokentype, 
-                    std::memcpy(preimage.data()+0,  txid.data(),    32);
-                    std::memcpy(preimage.data()+32, &vout,           4);
-                    std::memcpy(preimage.data()+36, tokenid.data(), 32);
-                    std::memcpy(preimage.data()+68, &tokentype,      2);
-                    // TODO UNTESTED
-                    const gs::transaction gen_tx   = validator.get(gs::txid(tokenid.v));
-                    const gs::outpoint& i_outpoint = tx.inputs[0];
-                    const gs::transaction & txi    = validator.transaction_map.at(i_outpoint.txid);
-                    const gs::tokenid group_id     = txi.slp.tokenid;
-                    std::memcpy(preimage.data()+70, &group_id,  32);
-                    // TODO debug, maybe remove in later release
-                    reply->set_tx(tx.serialized.data(), tx.serialized.size());
-                    reply->set_vout(vout);
-                    reply->set_tokenid(tokenid.data(), tokenid.size());
-                    reply->set_tokentype(tokentype);
-                    reply->set_groupid(group_id.data(), group_id.size());
-                }
-
-
-                spdlog::info("{} {} {} {}", txid.decompress(true), vout, tokenid.decompress(true), value);
-                spdlog::info("{}", gs::util::hex(preimage));
-
-                std::array<uint8_t, 32> msg;
-                sha256(preimage.data(), preimage.size(), msg.data());
-
-                const std::array<uint8_t, 64> sig = schnorr_sign(msg);
-
-                reply->set_msg(msg.data(), msg.size());
-                reply->set_sig(sig.data(), sig.size());
-			}
+            lookup_vout = request->vout();
+            valid_tx = output_oracle_sign(gs::outpoint(lookup_txid, lookup_vout), reply);
         }
         const auto end = std::chrono::steady_clock::now();
         const auto diff = end - start;
@@ -342,6 +474,53 @@ class GraphSearchServiceImpl final
         return { grpc::Status::OK };
     }
 
+    grpc::Status OutputOracleBatch (
+        grpc::ServerContext* context,
+        const graphsearch::OutputOracleBatchRequest* request,
+        graphsearch::OutputOracleBatchReply* reply
+    ) override {
+        const auto start = std::chrono::steady_clock::now();
+
+        if (static_cast<std::size_t>(request->outpoints_size()) > max_oracle_batch_size) {
+            return { grpc::StatusCode::INVALID_ARGUMENT, "too many outpoints" };
+        }
+
+        // cowardly validating user provided data
+        static const std::regex txid_regex("^[0-9a-fA-F]{64}$");
+        std::vector<gs::outpoint> outpoints;
+        outpoints.reserve(request->outpoints_size());
+        for (auto & o : request->outpoints()) {
+            if (! std::regex_match(o.txid(), txid_regex)) {
+                return { grpc::StatusCode::INVALID_ARGUMENT, "txid did not match regex" };
+            }
+
+            outpoints.emplace_back(gs::txid(o.txid()), o.vout());
+        }
+
+        // replies line up with the requested outpoints, ones we cannot sign are left empty
+        for (std::size_t i=0; i<outpoints.size(); ++i) {
+            reply->add_replies();
+        }
+
+        // the calling thread signs too
+        const std::size_t helpers = outpoints.size() / oracle_batch_per_thread;
+
+        std::atomic<std::size_t> signed_count { 0 };
+        oracle_pool->run(outpoints.size(), [&](const std::size_t i) {
+            if (output_oracle_sign(outpoints[i], reply->mutable_replies(i))) {
+                ++signed_count;
+            }
+        }, helpers);
+
+        const auto end = std::chrono::steady_clock::now();
+        const auto diff = end - start;
+        const auto diff_ms = std::chrono::duration<double, std::milli>(diff).count();
+
+        spdlog::info("outputoraclebatch: {}/{} ({} ms)", signed_count, outpoints.size(), diff_ms);
+
+        return { grpc::Status::OK };
+    }
+
     grpc::Status Status (
         grpc::ServerContext* context,
         const graphsearch::StatusRequest* request,
@@ -362,6 +541,21 @@ class GraphSearchServiceImpl final
         reply->set_last_incoming_zmq_blk_size(last_incoming_zmq_blk_size);
         reply->set_last_outgoing_zmq_blk_size(last_outgoing_zmq_blk_size);
 
+        if (zmq_ingest) {
+            reply->set_ingest_queue_depth     (zmq_ingest->depth());
+            reply->set_ingest_batches         (zmq_ingest->batches);
+            reply->set_ingest_last_batch_size (zmq_ingest->last_batch_size);
+        }
+
+        {
+            boost::shared_lock<boost::shared_mutex> lock(bch.utxodb.lookup_mtx);
+            reply->set_utxo_rollback_blocks(bch.utxodb.undo_journal.size());
+            if (bch.utxodb.commitment_enabled) {
+                reply->set_utxo_commitment(bch.utxodb.commitment.finalize().decompress());
+            }
+        }
+        reply->set_utxo_rollback_bytes(bch.utxodb.undo_memory_usage());
+
         return { grpc::Status::OK };
     }
 };
@@ -447,18 +641,140 @@ class UtxoServiceImpl final
     }
 };
 
-bool slpsync_process_block(const gs::block& block, const bool mempool)
+// call before adding a tx the validator does not have so a reorg can take it out again
+// IMPORTANT: processing_mutex must be held
+void slpsync_journal_added(const gs::txid& txid)
+{
+    if (reorg_journal.depth > 0 && ! g.has_tx(txid)) {
+        reorg_journal.record_added(txid);
+    }
+}
+
+// a tx which failed validation is held back if it spends outputs of transactions
+// we have not seen, as those may be slp parents which arrive later
+// IMPORTANT: processing_mutex must be held
+bool slpsync_add_orphan(const gs::transaction& tx)
+{
+    // outputs which exist but can not bring tokens, confirmed ones we do not
+    // have in the validator were never valid slp
+    auto is_known = [](const gs::outpoint& input) {
+        if (validator.pruning && g.has_tx(input.txid)) {
+            return true;
+        }
+
+        bool unused;
+        if (bch_txids.get(input.txid, unused)) {
+            return true;
+        }
+
+        if (utxosync_enabled) {
+            boost::shared_lock<boost::shared_mutex> lock(bch.utxodb.lookup_mtx);
+            gs::output o;
+            return bch.utxodb.find_output(input, o);
+        }
+
+        return false;
+    };
+
+    // only a tx short of token input its unknown parents could bring is worth holding
+    const std::vector<gs::txid> missing_parents = validator.missing_token_parents(tx, is_known);
+    if (missing_parents.empty()) {
+        return false;
+    }
+
+    // drop the failed attempt so the tx is not mistaken as known when its parent or block arrives
+    validator.remove_tx(tx.txid);
+
+    return orphan_pool.add(tx, missing_parents, current_time());
+}
+
+// revalidates orphans waiting on parents, including orphans of orphans
+// the ones which became valid are inserted into the graph in one batch and returned
+// IMPORTANT: processing_mutex must be held
+std::vector<gs::transaction> slpsync_release_orphans(const std::vector<gs::txid>& parents)
 {
+    std::vector<gs::transaction> released;
+    if (orphan_pool.size() == 0) {
+        return released;
+    }
+
+    std::deque<gs::txid> queue(parents.begin(), parents.end());
+    while (! queue.empty()) {
+        const gs::txid parent = queue.front();
+        queue.pop_front();
+
+        for (const gs::transaction & child : orphan_pool.take_children(parent)) {
+            if (validator.has(child.txid)) {
+                continue;
+            }
+
+            slpsync_journal_added(child.txid);
+            if (validator.add_tx(child)) {
+                released.push_back(child);
+                queue.push_back(child.txid);
+            } else {
+                slpsync_add_orphan(child);
+            }
+        }
+    }
+
+    absl::flat_hash_map<gs::tokenid, std::vector<gs::transaction>> valid_txs;
+    for (const gs::transaction & tx : released) {
+        valid_txs[tx.slp.tokenid].push_back(tx);
+        tx_wal.append_tx(tx.serialized);
+    }
+
+    for (auto & m : valid_txs) {
+        g.insert_token_data(m.first, m.second);
+    }
+
+    if (! released.empty()) {
+        spdlog::info("released {} orphans ({} waiting)", released.size(), orphan_pool.size());
+    }
+
+    return released;
+}
+
+// assume_valid skips validation, block must come from a verified cache
+// burned, unless nullptr, gets the token outputs spent by transactions which are not valid
+bool slpsync_process_block(
+    const gs::block& block,
+    const bool mempool,
+    const bool assume_valid=false,
+    std::vector<gs::outpoint>* burned=nullptr
+) {
     boost::lock_guard<boost::shared_mutex> lock(processing_mutex);
 
+    if (! mempool) {
+        reorg_journal.connect(current_block_height, block.block_hash);
+    }
+
+    std::vector<gs::txid> added;
     absl::flat_hash_map<gs::tokenid, std::vector<gs::transaction>> valid_txs;
     for (auto & tx : block.txs) {
+        orphan_pool.remove(tx.txid);
+
+        std::vector<gs::outpoint> spent;
+        if (! mempool) {
+            spent = validator.spend_inputs(tx, current_block_height);
+            reorg_journal.record_spent(spent);
+        }
+
         if (validator.has(tx.txid)) {
             // skip over ones we've already added from mempool
+            if (burned != nullptr && ! validator.has_valid(tx.txid)) {
+                burned->insert(burned->end(), spent.begin(), spent.end());
+            }
             continue;
         }
-        if (! validator.add_tx(tx)) {
+        slpsync_journal_added(tx.txid);
+        if (assume_valid) {
+            validator.add_assumed_valid_tx(tx);
+        } else if (! validator.add_tx(tx)) {
             std::cerr << "invalid tx: " << tx.txid.decompress(true) << std::endl;
+            if (burned != nullptr) {
+                burned->insert(burned->end(), spent.begin(), spent.end());
+            }
             continue;
         }
 
@@ -467,14 +783,49 @@ bool slpsync_process_block(const gs::block& block, const bool mempool)
         } else {
             valid_txs[tx.slp.tokenid].push_back(tx);
         }
+        added.push_back(tx.txid);
+
+        if (mempool) {
+            tx_wal.append_tx(tx.serialized);
+        }
     }
 
     for (auto & m : valid_txs) {
         g.insert_token_data(m.first, m.second);
     }
 
+    // after the loop as these may spend outputs created earlier in the block
+    if (! mempool) {
+        const std::vector<gs::outpoint> spent = validator.spend_inputs(block.skipped_inputs, current_block_height);
+        reorg_journal.record_spent(spent);
+        if (burned != nullptr) {
+            burned->insert(burned->end(), spent.begin(), spent.end());
+        }
+    }
+
+    // earlier records were either mined in this block or are still in the mempool, which startup fetches
+    if (! mempool) {
+        tx_wal.reset();
+        tx_wal.append_block(current_block_height, block.block_hash);
+    }
+
+    slpsync_release_orphans(added);
+
+    if (! mempool) {
+        applied_tip.height = current_block_height;
+        applied_tip.hash   = block.block_hash;
+    }
+
+    if (! mempool && validator.pruning && static_cast<std::uint32_t>(current_block_height) > prune_depth) {
+        const std::size_t pruned = validator.prune(current_block_height - prune_depth);
+        if (pruned > 0) {
+            spdlog::info("pruned {} spent transactions ({} tracked)", pruned, validator.unspent_outputs.size());
+        }
+    }
+
     if (! mempool) {
-        spdlog::info("processed block {} ({}) [{}]", current_block_height, validator.valid.size(), block.txs.size());
+        spdlog::info("processed block {} ({}) [{}]{}", current_block_height, validator.valid.size(), block.txs.size(),
+            assume_valid ? " assumed valid" : "");
     } else {
         spdlog::info("processed mempool ({}) [{}]", validator.valid.size(), block.txs.size());
     }
@@ -482,111 +833,689 @@ bool slpsync_process_block(const gs::block& block, const bool mempool)
     return true;
 }
 
-bool slpsync_process_tx(const gs::transaction& tx)
+// adds tx to the validator or orphan pool, the caller inserts it into the graph if true
+// IMPORTANT: processing_mutex must be held
+bool slpsync_validate_tx(const gs::transaction& tx)
 {
-    boost::lock_guard<boost::shared_mutex> lock(processing_mutex);
-
     spdlog::info("new tx {}", tx.txid.decompress(true));
 
     if (tx.slp.type == gs::slp_transaction_type::invalid) {
         // spdlog::warn("zmq-tx invalid {}", tx.txid.decompress(true));
+        bch_txids.put(tx.txid, true);
         return false;
     }
 
-    if (validator.has(tx.txid)) {
+    if (validator.has(tx.txid) || orphan_pool.has(tx.txid)) {
         spdlog::warn("tx already in validator {}", tx.txid.decompress(true));
         return false;
     }
 
+    slpsync_journal_added(tx.txid);
     if (! validator.add_tx(tx)) {
-        spdlog::warn("tx invalid tx: {}", tx.txid.decompress(true));
+        if (slpsync_add_orphan(tx)) {
+            spdlog::info("tx orphaned: {} ({} waiting)", tx.txid.decompress(true), orphan_pool.size());
+        } else {
+            spdlog::warn("tx invalid tx: {}", tx.txid.decompress(true));
+        }
+        return false;
+    }
+
+    tx_wal.append_tx(tx.serialized);
+
+    return true;
+}
+
+// released is filled with previously orphaned transactions which tx made valid
+bool slpsync_process_tx(
+    const gs::transaction& tx,
+    std::vector<gs::transaction>& released
+) {
+    boost::lock_guard<boost::shared_mutex> lock(processing_mutex);
+
+    orphan_pool.expire(current_time());
+
+    if (! slpsync_validate_tx(tx)) {
         return false;
     }
 
     g.insert_token_data(tx.slp.tokenid, { tx });
 
+    released = slpsync_release_orphans({ tx.txid });
+
     return true;
 }
 
+// slpsync_process_tx for a batch in arrival order, taking the lock once and
+// inserting into the graph once per token
+// applied is filled with the valid transactions followed by the orphans they released
+void slpsync_process_txs(
+    const std::vector<gs::transaction>& txs,
+    std::vector<gs::transaction>& applied
+) {
+    boost::lock_guard<boost::shared_mutex> lock(processing_mutex);
+
+    orphan_pool.expire(current_time());
+
+    std::vector<gs::txid> added;
+    absl::flat_hash_map<gs::tokenid, std::vector<gs::transaction>> valid_txs;
+    for (const gs::transaction & tx : txs) {
+        if (! slpsync_validate_tx(tx)) {
+            continue;
+        }
+
+        valid_txs[tx.slp.tokenid].push_back(tx);
+        added.push_back(tx.txid);
+        applied.push_back(tx);
+    }
+
+    for (auto & m : valid_txs) {
+        g.insert_token_data(m.first, m.second);
+    }
+
+    for (gs::transaction & rtx : slpsync_release_orphans(added)) {
+        applied.push_back(std::move(rtx));
+    }
+}
+
+// blocks cached before the pack format, see cachepack
 boost::filesystem::path block_height_to_path(const std::uint32_t height)
 {
     return cache_dir / "slp" / std::to_string(height / 1000);
 }
 
-bool cache_slp_block(const gs::block& block, const std::uint32_t height)
+boost::filesystem::path block_pack_path()
+{
+    return cache_dir / "slp" / "pack";
+}
+
+boost::filesystem::path cache_valid_only_path()
+{
+    return cache_dir / "slp" / "valid_only_height";
+}
+
+// disconnects the blocks after fork_hash and makes it the tip
+// IMPORTANT: processing_mutex must not be held
+bool slpsync_rollback(const gs::blockhash& fork_hash)
 {
-    boost::filesystem::path dir = block_height_to_path(height);
+    boost::lock_guard<boost::shared_mutex> lock(processing_mutex);
 
-    if (! boost::filesystem::exists(dir)) {
-        boost::filesystem::create_directories(dir);
+    const gs::block_undo* fork = reorg_journal.find(fork_hash);
+    if (fork == nullptr) {
+        return false;
     }
+    const std::uint32_t fork_height  = fork->height;
+    const std::uint32_t disconnected = applied_tip.height - fork_height;
 
-    boost::filesystem::path blk_path = dir / std::to_string(height);
-    boost::filesystem::ofstream outf(blk_path, boost::filesystem::ofstream::binary);
+    reorg_journal.rollback(fork_hash, g, validator);
 
-    auto serialized = block.serialize();
-    outf.write(reinterpret_cast<const char *>(serialized.data()), serialized.size());
+    applied_tip.height   = fork_height;
+    applied_tip.hash     = fork_hash;
+    current_block_height = fork_height;
+    current_block_hash   = fork_hash;
 
-    return true;
-}
+    // anything signed against the old branch must go
+    oracle_cache.clear();
 
-bool get_rpc_type(toml::value config) {
-    try
-    {
-        return !toml::find<bool>(config, "services", "bchd_grpc");
+    tx_wal.reset();
+    tx_wal.append_block(fork_height, fork_hash);
+
+    // cached blocks of the old branch must not be replayed, the new branch is cached as it is synced
+    if (! block_cache.drop_above(fork_height)) {
+        spdlog::error("failed to drop cached blocks above {}", fork_height);
     }
-    catch(const std::exception& e)
-    {
-        return false;
+    for (std::uint32_t h = fork_height + 1; h <= fork_height + disconnected; ++h) {
+        boost::system::error_code ec;
+        boost::filesystem::remove(block_height_to_path(h) / std::to_string(h), ec);
     }
+
+    spdlog::warn("rolled back {} blocks to block {} ({})", disconnected, fork_height, fork_hash.decompress(true));
+
+    return true;
 }
 
-std::string get_grpc_cert_path(toml::value config) {
-    try
-    {
-        return toml::find<std::string>(config, "bchd", "cert_path");
+// fetches the block at height of the node's best chain
+std::pair<bool, gs::block> slpsync_fetch_block(gs::RpcClient& rpc_client, const std::uint32_t height)
+{
+    const std::pair<bool, gs::blockhash> block_hash = rpc_client.get_block_hash(height);
+    if (! block_hash.first) {
+        return { false, {} };
     }
-    catch(const std::exception& e)
-    {
-        return "";
+
+    const std::pair<bool, std::vector<std::uint8_t>> block_data = rpc_client.get_raw_block(block_hash.second);
+    if (! block_data.first) {
+        return { false, {} };
+    }
+
+    gs::block block;
+    if (! block.hydrate(block_data.second.begin(), block_data.second.end(), true)) {
+        return { false, {} };
     }
+    block.topological_sort();
+
+    return { true, std::move(block) };
 }
 
-int main(int argc, char * argv[])
+// adds mempool transactions we do not have, ex: ones a reorg took out which are still unconfirmed
+void slpsync_refetch_mempool(gs::RpcClient& rpc_client)
 {
-    // std::signal(SIGINT, signal_handler);
-    // std::signal(SIGTERM, signal_handler);
-    startup_mempool_transactions.reserve(100000);
-
-    if (argc < 2) {
-        std::cerr << "usage: gs++ config.toml\n";
-        return EXIT_FAILURE;
+    std::pair<bool, std::vector<gs::txid>> txids = rpc_client.get_raw_mempool();
+    if (! txids.first) {
+        spdlog::warn("get_raw_mempool failed");
+        return;
     }
 
-    const auto config = toml::parse(argv[1]);
-    const bool cache_enabled = toml::find<bool>(config, "services", "cache");
-    if (cache_enabled) {
-        cache_dir = boost::filesystem::path(toml::find<std::string>(config, "cache", "dir"));
-    }
-    max_exclusion_set_size = toml::find<std::size_t>(config, "graphsearch", "max_exclusion_set_size");
     {
-        const std::vector<uint8_t> privkey = gs::util::unhex(
-            toml::find<std::string>(config, "graphsearch", "private_key")
+        boost::shared_lock<boost::shared_mutex> lock(processing_mutex);
+        txids.second.erase(
+            std::remove_if(txids.second.begin(), txids.second.end(), [](const gs::txid& txid) {
+                return validator.has(txid);
+            }),
+            txids.second.end()
         );
+    }
 
-        if (privkey.size() != 32) {
-            spdlog::error("private_key has bad format");
-            return EXIT_FAILURE;
-        }
+    const std::pair<bool, std::vector<std::vector<std::uint8_t>>> txdatas = rpc_client.get_raw_transactions(txids.second);
+    if (! txdatas.first) {
+        spdlog::warn("get_raw_transaction failed");
+        return;
+    }
 
-        std::memcpy(private_key.data(), privkey.data(), 32);
+    // repurposing to use as mempool container
+    gs::block block;
+    for (const std::vector<std::uint8_t> & txdata : txdatas.second) {
+        gs::transaction tx;
+        if (tx.hydrate(txdata.begin(), txdata.end()) && tx.slp.type != gs::slp_transaction_type::invalid) {
+            block.txs.push_back(std::move(tx));
+        }
+    }
+    block.topological_sort();
+    slpsync_process_block(block, true);
+}
 
-        ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN);
+// makes block extend the tip, if it does not we roll back to where its branch
+// forks off and apply the blocks of the branch before it, which zmq may not
+// have delivered, from rpc
+// returns false if the fork is further back than the reorg journal reaches or
+// the new branch could not be applied, block must not be applied then
+bool slpsync_reorg(const gs::block& block, gs::RpcClient& rpc_client)
+{
+    if (block.prev_block.v == current_block_hash.load().v) {
+        return true;
     }
 
-    bool is_json_rpc = get_rpc_type(config);
+    spdlog::warn("block {} does not extend tip {}",
+        block.block_hash.decompress(true),
+        current_block_hash.load().decompress(true)
+    );
 
-    spdlog::info("hello");
+    gs::blockhash fork_hash(block.prev_block.v);
+    std::vector<std::pair<std::uint32_t, gs::blockhash>> recorded; // newest first
+    {
+        boost::shared_lock<boost::shared_mutex> lock(processing_mutex);
+        if (reorg_journal.find(fork_hash) == nullptr) {
+            for (auto it = reorg_journal.blocks.rbegin(); it != reorg_journal.blocks.rend(); ++it) {
+                recorded.emplace_back(it->height, it->hash);
+            }
+        }
+    }
+
+    // the parent is not one of ours, ask the node which of our blocks it still has
+    // if none of them the rollback below fails as the parent is still unknown
+    for (const auto & r : recorded) {
+        const std::pair<bool, gs::blockhash> node_hash = rpc_client.get_block_hash(r.first);
+        if (! node_hash.first) {
+            spdlog::error("failed to get hash of block {} while looking for the fork", r.first);
+            return false;
+        }
+
+        if (node_hash.second == r.second) {
+            fork_hash = r.second;
+            break;
+        }
+    }
+
+    if (! slpsync_rollback(fork_hash)) {
+        spdlog::error("fork of block {} is deeper than the reorg journal, a resync is needed",
+            block.block_hash.decompress(true)
+        );
+        return false;
+    }
+
+    while (block.prev_block.v != current_block_hash.load().v) {
+        const std::uint32_t height = current_block_height + 1;
+        const std::pair<bool, gs::block> fetched = slpsync_fetch_block(rpc_client, height);
+        if (! fetched.first) {
+            spdlog::error("failed to fetch block {} of the new branch", height);
+            return false;
+        }
+
+        // block would have to extend the tip to be at this height, the node changed branch under us
+        if (fetched.second.block_hash == block.block_hash) {
+            spdlog::error("block {} is at height {} of the node but does not extend our tip",
+                block.block_hash.decompress(true),
+                height
+            );
+            return false;
+        }
+
+        ++current_block_height;
+        if (! slpsync_process_block(fetched.second, false)) {
+            spdlog::error("failed to process block {} of the new branch", height);
+            --current_block_height;
+            return false;
+        }
+        current_block_hash = fetched.second.block_hash;
+    }
+
+    slpsync_refetch_mempool(rpc_client);
+
+    return true;
+}
+
+// IMPORTANT: processing_mutex must not be held
+bool save_state_snapshot()
+{
+    if (snapshot_path.empty()) {
+        return false;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    boost::shared_lock<boost::shared_mutex> lock(processing_mutex);
+    if (applied_tip.height == 0) {
+        return false;
+    }
+
+    if (! gs::save_snapshot(snapshot_path, g, validator, applied_tip)) {
+        spdlog::error("failed to save snapshot at block {}", applied_tip.height);
+        return false;
+    }
+
+    // the snapshot holds the mempool transactions too
+    if (tx_wal.reset()) {
+        tx_wal.append_block(applied_tip.height, applied_tip.hash);
+    }
+
+    spdlog::info("saved snapshot at block {} ({} ms)",
+        applied_tip.height,
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+    );
+
+    return true;
+}
+
+void snapshot_after_block(const std::uint32_t height)
+{
+    if (snapshot_interval > 0 && height % snapshot_interval == 0) {
+        save_state_snapshot();
+    }
+}
+
+// replaces the empty startup state, returns false if there is no usable snapshot
+bool load_state_snapshot()
+{
+    if (snapshot_path.empty() || ! boost::filesystem::exists(snapshot_path)) {
+        return false;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    boost::lock_guard<boost::shared_mutex> lock(processing_mutex);
+
+    const std::pair<bool, gs::snapshot_tip> loaded = gs::load_snapshot(snapshot_path, g, validator);
+    if (! loaded.first) {
+        spdlog::warn("could not load snapshot {}, replaying from scratch", snapshot_path);
+        g.txid_to_token.clear();
+        g.tokens.clear();
+        validator.transaction_map.clear();
+        validator.valid.clear();
+        validator.unspent_outputs.clear();
+        validator.fully_spent.clear();
+        return false;
+    }
+
+    applied_tip          = loaded.second;
+    current_block_height = loaded.second.height;
+    current_block_hash   = loaded.second.hash;
+
+    spdlog::info("loaded snapshot at block {} with {} transactions ({} ms)",
+        applied_tip.height,
+        validator.valid.size(),
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+    );
+
+    return true;
+}
+
+// reapplies the transactions logged after the last block, then keeps logging
+// the cache, snapshot and rpc sync must already have been applied
+// IMPORTANT: processing_mutex must not be held
+bool open_wal()
+{
+    const std::pair<bool, std::vector<gs::wal::record>> log = gs::wal::read(wal_path);
+    if (! log.first) {
+        return false;
+    }
+
+    // anything before the last block record was mined in it or is refetched with the mempool
+    auto tail = log.second.begin();
+    for (auto it = log.second.begin(); it != log.second.end(); ++it) {
+        if (it->type == gs::wal::record_type::block) {
+            tail = it;
+        }
+    }
+
+    if (! tx_wal.open(wal_path)) {
+        spdlog::error("could not open wal {}", wal_path);
+        return false;
+    }
+
+    {
+        boost::lock_guard<boost::shared_mutex> lock(processing_mutex);
+
+        if (tail != log.second.end() && tail->type == gs::wal::record_type::block) {
+            const std::pair<std::uint32_t, gs::blockhash> logged = gs::wal::decode_block(*tail);
+            if (logged.first != applied_tip.height || logged.second != applied_tip.hash) {
+                spdlog::warn("wal was written at block {} but state is at block {}", logged.first, applied_tip.height);
+            }
+        }
+
+        tx_wal.reset();
+        tx_wal.append_block(applied_tip.height, applied_tip.hash);
+    }
+
+    std::size_t replayed = 0;
+    for (; tail != log.second.end(); ++tail) {
+        if (tail->type != gs::wal::record_type::tx) {
+            continue;
+        }
+
+        gs::transaction tx;
+        if (! tx.hydrate(tail->data.begin(), tail->data.end())) {
+            spdlog::error("wal tx unable to be hydrated");
+            continue;
+        }
+
+        std::vector<gs::transaction> released;
+        if (slpsync_process_tx(tx, released)) {
+            replayed += 1 + released.size();
+        }
+    }
+
+    spdlog::info("replayed {} transactions from wal", replayed);
+
+    return true;
+}
+
+void load_cache_valid_only_height()
+{
+    boost::filesystem::ifstream inf(cache_valid_only_path());
+    std::uint32_t height;
+    if (inf >> height) {
+        cache_valid_only_height = height;
+    }
+}
+
+// serialized transaction with the given inputs and no outputs, it is never valid slp
+// so hydrating with slp_only moves its inputs to block.skipped_inputs
+std::vector<std::uint8_t> spend_only_tx(const std::vector<gs::outpoint>& inputs)
+{
+    std::vector<std::uint8_t> ret;
+    auto append = [&ret](const void * data, const std::size_t len) {
+        const std::uint8_t * p = static_cast<const std::uint8_t *>(data);
+        ret.insert(ret.end(), p, p + len);
+    };
+    const std::int32_t  version  = 1;
+    const std::uint32_t sequence = 0xFFFFFFFF;
+    const std::uint32_t lock_time = 0;
+
+    append(&version, sizeof(version));
+    const std::vector<std::uint8_t> in_count = gs::util::num_to_var_int(inputs.size());
+    append(in_count.data(), in_count.size());
+    for (const gs::outpoint & o : inputs) {
+        append(o.txid.data(), o.txid.size());
+        append(&o.vout, sizeof(o.vout));
+        ret.push_back(0); // empty sigscript
+        append(&sequence, sizeof(sequence));
+    }
+    ret.push_back(0); // no outputs
+    append(&lock_time, sizeof(lock_time));
+
+    return ret;
+}
+
+// only valid transactions are written so the cache can be replayed with assume valid
+// blocks cached by older versions also hold invalid ones, so we record where this started
+// burned token outputs, see slpsync_process_block, are kept in a trailing spend_only_tx
+// so replay prunes the same transactions
+bool cache_slp_block(const gs::block& block, const std::uint32_t height, const std::vector<gs::outpoint>& burned)
+{
+    if (cache_valid_only_height == std::numeric_limits<std::uint32_t>::max()) {
+        boost::filesystem::ofstream outf(cache_valid_only_path());
+        outf << height;
+        cache_valid_only_height = height;
+    }
+
+    gs::block valid_block = block;
+    {
+        boost::shared_lock<boost::shared_mutex> lock(processing_mutex);
+        valid_block.txs.erase(
+            std::remove_if(valid_block.txs.begin(), valid_block.txs.end(), [](const gs::transaction& tx) {
+                return ! validator.has_valid(tx.txid);
+            }),
+            valid_block.txs.end()
+        );
+    }
+
+    if (! burned.empty()) {
+        gs::transaction spends;
+        spends.serialized = spend_only_tx(burned);
+        valid_block.txs.push_back(std::move(spends));
+    }
+
+    const auto serialized = valid_block.serialize();
+    if (! block_cache.append(height, valid_block.block_hash, serialized.data(), serialized.size())) {
+        spdlog::error("failed to cache block {}", height);
+        return false;
+    }
+
+    return true;
+}
+
+// calls fn(begin, end) with the serialized block, packed blocks are read in place
+// falls back to the per block file written by older versions
+// returns false if the block is not cached or fails its checksum
+template <typename Fn>
+bool with_cached_block(const std::uint32_t height, Fn fn)
+{
+    if (block_cache.has(height)) {
+        const auto packed = block_cache.read(height);
+        if (! packed.first) {
+            return false;
+        }
+
+        fn(packed.second.first, packed.second.first + packed.second.second);
+        return true;
+    }
+
+    const boost::filesystem::path blk_path = block_height_to_path(height) / std::to_string(height);
+    if (! boost::filesystem::exists(blk_path)) {
+        return false;
+    }
+
+    std::ifstream ifs(blk_path.string(), std::ios::in | std::ios::binary);
+    const std::vector<std::uint8_t> blk_data((std::istreambuf_iterator<char>(ifs)),
+                                              std::istreambuf_iterator<char>());
+    fn(blk_data.data(), blk_data.data() + blk_data.size());
+
+    return true;
+}
+
+bool get_rpc_type(toml::value config) {
+    try
+    {
+        return !toml::find<bool>(config, "services", "bchd_grpc");
+    }
+    catch(const std::exception& e)
+    {
+        return false;
+    }
+}
+
+// optional settings fall back to a default so older config files keep working
+template <typename T>
+T get_config_or(toml::value config, const std::string& table, const std::string& key, const T fallback) {
+    try
+    {
+        return toml::find<T>(config, table, key);
+    }
+    catch(const std::exception& e)
+    {
+        return fallback;
+    }
+}
+
+std::string get_grpc_cert_path(toml::value config) {
+    try
+    {
+        return toml::find<std::string>(config, "bchd", "cert_path");
+    }
+    catch(const std::exception& e)
+    {
+        return "";
+    }
+}
+
+// returns the height up to which cached blocks may skip validation, or 0 if disabled
+// the cached block at the configured height must match the configured hash
+std::uint32_t assume_valid_cache_height(toml::value config)
+{
+    const std::uint32_t height = get_config_or<std::uint32_t>(config, "graphsearch", "assume_valid_height", 0);
+    const std::string hash_str = get_config_or<std::string>(config, "graphsearch", "assume_valid_hash", "");
+    if (height == 0 || hash_str.empty()) {
+        return 0;
+    }
+
+    if (! std::regex_match(hash_str, std::regex("^[0-9a-fA-F]{64}$"))) {
+        spdlog::warn("assume_valid_hash is not a block hash, validating full cache");
+        return 0;
+    }
+
+    gs::blockhash hash(gs::util::unhex(hash_str));
+    std::reverse(hash.v.begin(), hash.v.end());
+
+    // the pack index records the hash, only older per block files need decoding
+    const std::pair<bool, gs::block_pack::entry> packed = block_cache.find(height);
+    gs::block block;
+    bool decoded = packed.first;
+    if (packed.first) {
+        block.block_hash = packed.second.hash;
+    } else {
+        const bool cached = with_cached_block(height, [&](const std::uint8_t* begin, const std::uint8_t* end) {
+            // only the header is needed
+            decoded = block.decode(begin, end, [](gs::transaction&&) {
+                return false;
+            });
+        });
+        if (! cached) {
+            spdlog::warn("assume valid block {} not cached, validating full cache", height);
+            return 0;
+        }
+    }
+
+    if (! decoded || block.block_hash.v != hash.v) {
+        spdlog::warn("cached block {} does not match assume_valid_hash, validating full cache", height);
+        return 0;
+    }
+
+    if (cache_valid_only_height > height) {
+        spdlog::warn("cache predates assume valid support, validating full cache");
+        return 0;
+    }
+
+    spdlog::info("assuming cached blocks {}-{} valid", cache_valid_only_height, height);
+
+    return height;
+}
+
+int main(int argc, char * argv[])
+{
+    startup_mempool_transactions.reserve(100000);
+
+    if (argc < 2) {
+        std::cerr << "usage: gs++ config.toml\n";
+        return EXIT_FAILURE;
+    }
+
+    const auto config = toml::parse(argv[1]);
+    const bool cache_enabled = toml::find<bool>(config, "services", "cache");
+    if (cache_enabled) {
+        cache_dir = boost::filesystem::path(toml::find<std::string>(config, "cache", "dir"));
+        load_cache_valid_only_height();
+
+        if (! block_cache.open(block_pack_path().string())) {
+            spdlog::error("could not open block cache {}", block_pack_path().string());
+            return EXIT_FAILURE;
+        }
+        spdlog::info("block cache holds {} blocks", block_cache.size());
+    }
+    max_exclusion_set_size = toml::find<std::size_t>(config, "graphsearch", "max_exclusion_set_size");
+    oracle_cache.capacity = get_config_or<std::size_t>(config, "graphsearch", "oracle_cache_size", 10000);
+    orphan_pool.max_size  = get_config_or<std::size_t>(config, "graphsearch", "orphan_pool_size", 10000);
+    orphan_pool.expiry    = get_config_or<std::uint64_t>(config, "graphsearch", "orphan_expiry", 3600);
+    prune_depth           = get_config_or<std::uint32_t>(config, "graphsearch", "prune_depth", 0);
+    validator.pruning     = prune_depth > 0;
+    reorg_journal.depth   = get_config_or<std::size_t>(config, "graphsearch", "reorg_depth", 10);
+    // pruned transactions can not be brought back
+    if (validator.pruning && reorg_journal.depth > prune_depth) {
+        spdlog::warn("reorg_depth {} is deeper than prune_depth, using {}", reorg_journal.depth, prune_depth);
+        reorg_journal.depth = prune_depth;
+    }
+    snapshot_path         = get_config_or<std::string>(config, "snapshot", "path", "");
+    snapshot_interval     = get_config_or<std::uint32_t>(config, "snapshot", "interval", 1000);
+    wal_path              = get_config_or<std::string>(config, "wal", "path", "");
+    tx_wal.sync_interval  = std::chrono::milliseconds(get_config_or<std::uint32_t>(config, "wal", "sync_interval", 100));
+
+    // the final snapshot is written and the wal flushed once a signal stops the server
+    // the mask is inherited, so this must happen before any other thread is started
+    if (! snapshot_path.empty() || ! wal_path.empty()) {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        std::thread(signal_waiter, signals).detach();
+    }
+    {
+        const std::vector<uint8_t> privkey = gs::util::unhex(
+            toml::find<std::string>(config, "graphsearch", "private_key")
+        );
+
+        if (privkey.size() != 32) {
+            spdlog::error("private_key has bad format");
+            return EXIT_FAILURE;
+        }
+
+        std::memcpy(private_key.data(), privkey.data(), 32);
+
+        ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN);
+    }
+
+    // OutputOracleBatch signs on its own thread as well, so one worker less than cores
+    oracle_pool.reset(new gs::worker_pool(
+        std::max(1u, std::thread::hardware_concurrency()) - 1
+    ));
+
+    // blocks fetched ahead of the one being applied during initial sync
+    const std::size_t prefetch_window  = get_config_or<std::size_t>(config, "prefetch", "window", 16);
+    const std::size_t prefetch_threads = get_config_or<std::size_t>(config, "prefetch", "threads", 4);
+    zmq_ingest.reset(new gs::ingest_queue<zmq_ingest_item>(
+        get_config_or<std::size_t>(config, "bitcoind", "ingest_queue_size", 100000)
+    ));
+    ingest_batch_size = get_config_or<std::size_t>(config, "bitcoind", "ingest_batch_size", 500);
+
+    bool is_json_rpc = get_rpc_type(config);
+
+    spdlog::info("hello");
 
     gs::RpcClient rpc_client = gs::RpcClient();
 
@@ -595,7 +1524,9 @@ int main(int argc, char * argv[])
             toml::find<std::string>  (config, "bitcoind", "host"),
             toml::find<std::uint16_t>(config, "bitcoind", "port"),
             toml::find<std::string>  (config, "bitcoind", "user"),
-            toml::find<std::string>  (config, "bitcoind", "pass")
+            toml::find<std::string>  (config, "bitcoind", "pass"),
+            get_config_or<std::size_t>(config, "bitcoind", "batch_size", 1000),
+            get_config_or<std::size_t>(config, "bitcoind", "connections", 4)
         );
         rpc_client.set_json_rpc(*_rpc);
     } else {
@@ -636,8 +1567,56 @@ int main(int argc, char * argv[])
         rpc_client.set_grpc_rpc(*_rpc);
     }
 
-    if (toml::find<bool>(config, "services", "utxosync")) {
+    utxosync_enabled = toml::find<bool>(config, "services", "utxosync");
+    if (utxosync_enabled) {
+        bch.utxodb.rollback_depth     = get_config_or<std::size_t>(config, "utxo", "rollback_depth", 10);
+        bch.utxodb.commitment_enabled = get_config_or<bool>(config, "utxo", "commitment", false);
+        const std::string utxo_checkpoint_path = toml::find<std::string>(config, "utxo", "checkpoint");
+
+        std::uint32_t block_height = toml::find<std::uint32_t>(config, "utxo", "block_height");
         if (toml::find<bool>(config, "utxo", "checkpoint_load")) {
+            const auto start = std::chrono::steady_clock::now();
+
+            const std::pair<bool, gs::snapshot_tip> loaded = gs::load_utxo_checkpoint(utxo_checkpoint_path, bch.utxodb);
+            if (! loaded.first) {
+                spdlog::error("could not load utxo checkpoint {}", utxo_checkpoint_path);
+                return EXIT_FAILURE;
+            }
+
+            // a configured hash pins the checkpoint to a known block
+            const std::string expected_hash = toml::find<std::string>(config, "utxo", "block_hash");
+            if (expected_hash.find_first_not_of('0') != std::string::npos
+             && expected_hash != loaded.second.hash.decompress(true)
+            ) {
+                spdlog::error("utxo checkpoint is at block {} {}, expected {}",
+                    loaded.second.height, loaded.second.hash.decompress(true), expected_hash);
+                return EXIT_FAILURE;
+            }
+
+            // blocks after the checkpoint are only replayed on top of it if it is on the node's chain
+            const std::pair<bool, gs::blockhash> node_hash = rpc_client.get_block_hash(loaded.second.height);
+            if (! node_hash.first) {
+                spdlog::error("could not get hash of utxo checkpoint block {}", loaded.second.height);
+                return EXIT_FAILURE;
+            }
+            if (node_hash.second != loaded.second.hash) {
+                spdlog::error("utxo checkpoint block {} {} is not on the node's chain, which has {}",
+                    loaded.second.height,
+                    loaded.second.hash.decompress(true),
+                    node_hash.second.decompress(true)
+                );
+                return EXIT_FAILURE;
+            }
+
+            block_height = loaded.second.height + 1;
+            spdlog::info("loaded utxo checkpoint at block {} with {} outputs ({} ms)",
+                loaded.second.height,
+                bch.utxodb.outpoint_map.size(),
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+            );
+        } else {
+            // process_block counts up from the block before the first one
+            bch.utxodb.current_block_height = block_height - 1;
         }
 
         const std::pair<bool, std::uint32_t> best_block_height = rpc_client.get_best_block_height();
@@ -647,63 +1626,176 @@ int main(int argc, char * argv[])
         }
 
         spdlog::info("best block height: {}", best_block_height.second);
-        for (
-            std::uint32_t block_height=toml::find<std::uint32_t>(config, "utxo", "block_height");
-            block_height <= best_block_height.second;
-            ++block_height
-        ) {
-            const std::pair<bool, gs::blockhash> block_hash = rpc_client.get_block_hash(block_height);
-            if (! block_hash.first) {
+
+        while (block_height <= best_block_height.second) {
+            const std::uint32_t first_height = block_height;
+            const std::pair<bool, std::vector<gs::blockhash>> block_hashes = rpc_client.get_block_hashes(
+                first_height,
+                best_block_height.second
+            );
+            if (! block_hashes.first) {
                 spdlog::warn("rpc request failed, trying again...");
                 std::this_thread::sleep_for(await_time);
-                --block_height;
                 continue;
             }
 
-            const std::pair<bool, std::vector<std::uint8_t>> block_data = rpc_client.get_raw_block(block_hash.second);
-            if (! block_data.first) {
-                spdlog::warn("rpc request failed, trying again...");
+            gs::prefetcher<std::vector<std::uint8_t>> blocks(
+                first_height,
+                best_block_height.second,
+                prefetch_window,
+                prefetch_threads,
+                [&](const std::uint32_t height) -> std::pair<bool, std::vector<std::uint8_t>> {
+                    const std::pair<bool, std::vector<std::uint8_t>> block_data = rpc_client.get_raw_block(
+                        block_hashes.second[height - first_height]
+                    );
+                    if (! block_data.first) {
+                        spdlog::warn("rpc request failed, trying again...");
+                    }
+
+                    return block_data;
+                }
+            );
+
+            for (auto block_data = blocks.next(); block_data.first; block_data = blocks.next()) {
+                spdlog::info("processing block {}", block_height);
+                // blocks deeper than the journal would be dropped from it right away
+                bch.process_block(
+                    block_data.second,
+                    block_height + bch.utxodb.rollback_depth > best_block_height.second
+                );
+                ++block_height;
+            }
+
+            if (block_height <= best_block_height.second) {
                 std::this_thread::sleep_for(await_time);
-                --block_height;
-                continue;
             }
+        }
 
-            spdlog::info("processing block {}", block_height);
-            bch.process_block(block_data.second, true);
+        spdlog::info("utxo set: {} outputs of {} transactions, {} interned scripts, {} bytes",
+            bch.utxodb.outpoint_map.size(), bch.utxodb.txids.size(), bch.utxodb.scripts.size(), bch.utxodb.memory_usage());
+        spdlog::info("utxo rollback journal: {} blocks {} bytes",
+            bch.utxodb.undo_journal.size(), bch.utxodb.undo_memory_usage());
+        if (bch.utxodb.commitment_enabled) {
+            spdlog::info("utxo commitment at block {}: {}",
+                bch.utxodb.current_block_height, bch.utxodb.commitment.finalize().decompress());
         }
 
         if (toml::find<bool>(config, "utxo", "checkpoint_save")) {
+            const auto start = std::chrono::steady_clock::now();
+            if (gs::save_utxo_checkpoint(utxo_checkpoint_path, bch.utxodb)) {
+                spdlog::info("saved utxo checkpoint at block {} ({} ms)",
+                    bch.utxodb.current_block_height,
+                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+                );
+            }
         }
     }
 
     if (toml::find<bool>(config, "services", "graphsearch")) {
+        // the cache and rpc sync continue after the snapshot block
+        const bool snapshot_loaded = load_state_snapshot();
+        if (snapshot_loaded) {
+            ++current_block_height;
+        }
+
         if (cache_enabled) {
+            const std::uint32_t assume_valid_height = assume_valid_cache_height(config);
+            // after a snapshot the first block must extend the snapshot block too
+            bool first_cache_block = ! snapshot_loaded;
+
+            // reading, hydrating and sorting runs ahead on worker threads, blocks are applied in order
+            // the inner bool is false if the block is cached but does not hydrate
+            gs::prefetcher<std::pair<bool, gs::block>> cached_blocks(
+                current_block_height,
+                std::numeric_limits<std::uint32_t>::max(),
+                prefetch_window,
+                prefetch_threads,
+                [](const std::uint32_t height) -> std::pair<bool, std::pair<bool, gs::block>> {
+                    gs::block block;
+                    bool hydrated = false;
+                    const bool cached = with_cached_block(height, [&](const std::uint8_t* begin, const std::uint8_t* end) {
+                        hydrated = block.hydrate(begin, end, true);
+                    });
+
+                    if (hydrated) {
+                        block.topological_sort();
+                    }
+
+                    return { cached, { hydrated, std::move(block) } };
+                }
+            );
+
+            const auto replay_start = std::chrono::steady_clock::now();
+            auto last_report = replay_start;
+            std::uint64_t apply_us = 0;
+            std::uint32_t replayed = 0;
+
+            auto report_replay = [&]() {
+                const double elapsed_us = std::max<double>(1, std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - replay_start
+                ).count());
+                const std::pair<std::uint64_t, std::uint64_t> busy = cached_blocks.busy_us();
+
+                spdlog::info("cache replay: {} blocks, {:.1f} blocks/s, read {:.0f}% busy, apply {:.0f}% busy {:.0f}% waiting",
+                    replayed,
+                    replayed / (elapsed_us / 1e6),
+                    100.0 * busy.first / (elapsed_us * std::max<std::size_t>(1, prefetch_threads)),
+                    100.0 * apply_us / elapsed_us,
+                    100.0 * busy.second / elapsed_us
+                );
+            };
+
             for (; ! exit_early; ++current_block_height) {
-                boost::filesystem::path blk_path = block_height_to_path(current_block_height) / std::to_string(current_block_height);
-                if (! boost::filesystem::exists(blk_path)) {
+                std::pair<bool, std::pair<bool, gs::block>> fetched = cached_blocks.next();
+                if (! fetched.first) {
                     --current_block_height;
                     break;
                 }
+                gs::block & block = fetched.second.second;
 
-                std::ifstream ifs(blk_path.string(), std::ios::in | std::ios::binary);
-                const std::vector<std::uint8_t> blk_data((std::istreambuf_iterator<char>(ifs)),
-                                                          std::istreambuf_iterator<char>());
-
-                gs::block block;
-                if (! block.hydrate(blk_data.begin(), blk_data.end())) {
-                    spdlog::error("failed to hydrate cache block {}", current_block_height);
+                if (! fetched.second.first) {
+                    // rpc sync picks up from here and caches the block again
+                    spdlog::error("failed to hydrate cache block {}, continuing with rpc", current_block_height);
                     --current_block_height;
-                    return 0; // TODO Delete me
                     break;
                 }
 
+                const bool assume_valid = static_cast<std::uint32_t>(current_block_height) <= assume_valid_height
+                                       && static_cast<std::uint32_t>(current_block_height) >= cache_valid_only_height;
+
+                // the chain up to the checkpoint is what vouches for these blocks
+                if (assume_valid && ! first_cache_block && block.prev_block.v != current_block_hash.load().v) {
+                    spdlog::error("cache block {} does not extend {}, cache is corrupt",
+                        current_block_height,
+                        current_block_hash.load().decompress(true)
+                    );
+                    return EXIT_FAILURE;
+                }
+                first_cache_block = false;
+
                 current_block_hash = block.block_hash;
 
-                if (! slpsync_process_block(block, false)) {
+                const auto apply_start = std::chrono::steady_clock::now();
+                if (! slpsync_process_block(block, false, assume_valid)) {
                     spdlog::error("failed to process cache block {}", current_block_height);
                     --current_block_height;
                     break;
                 }
+                apply_us += std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - apply_start
+                ).count();
+                ++replayed;
+
+                snapshot_after_block(current_block_height);
+
+                if (std::chrono::steady_clock::now() - last_report >= std::chrono::seconds(10)) {
+                    last_report = std::chrono::steady_clock::now();
+                    report_replay();
+                }
+            }
+
+            if (replayed > 0) {
+                report_replay();
             }
         }
         if (toml::find<bool>(config, "services", "graphsearch_rpc")) {
@@ -722,55 +1814,79 @@ int main(int argc, char * argv[])
                     break;
                 }
 
+                const std::uint32_t first_height = current_block_height;
+                const std::pair<bool, std::vector<gs::blockhash>> block_hashes = rpc_client.get_block_hashes(
+                    first_height,
+                    best_block_height.second
+                );
+                if (! block_hashes.first) {
+                    spdlog::warn("rpc request failed, trying again...");
+                    std::this_thread::sleep_for(await_time);
+                    goto retry_loop2;
+                }
+
+                // fetching, parsing and sorting runs ahead on worker threads, blocks are applied in order
+                gs::prefetcher<gs::block> blocks(
+                    first_height,
+                    best_block_height.second,
+                    prefetch_window,
+                    prefetch_threads,
+                    [&](const std::uint32_t height) -> std::pair<bool, gs::block> {
+                        const gs::blockhash & block_hash = block_hashes.second[height - first_height];
+
+                        const std::pair<bool, std::vector<std::uint8_t>> block_data = rpc_client.get_raw_block(block_hash);
+                        if (! block_data.first) {
+                            spdlog::warn("rpc request failed, trying again...");
+                            return { false, {} };
+                        }
+
+                        gs::block block;
+                        if (! block.hydrate(block_data.second.begin(), block_data.second.end(), true)) {
+                            spdlog::error("failed to hydrate rpc block {}", height);
+                            return { false, {} };
+                        }
+
+                        block.topological_sort();
+                        return { true, std::move(block) };
+                    }
+                );
+
                 for (;
                     ! exit_early && current_block_height <= best_block_height.second;
                     ++current_block_height
                 ) {
-                    //const std::pair<bool, gs::blockhash> block_hash = rpc.get_block_hash(current_block_height);
-                    const std::pair<bool, gs::blockhash> block_hash = rpc_client.get_block_hash(current_block_height);
-                    if (! block_hash.first) {
-                        spdlog::warn("rpc request failed, trying again...");
-                        std::this_thread::sleep_for(await_time);
-                        --current_block_height;
-                        goto retry_loop2;
-                    }
-
-                    //const std::pair<bool, std::vector<std::uint8_t>> block_data = rpc.get_raw_block(block_hash.second);
-                    const std::pair<bool, std::vector<std::uint8_t>> block_data = rpc_client.get_raw_block(block_hash.second);
-                    if (! block_data.first) {
-                        spdlog::warn("rpc request failed, trying again...");
-                        std::this_thread::sleep_for(await_time);
-                        --current_block_height;
-                        goto retry_loop2;
-                    }
-                    gs::block block;
-                    if (! block.hydrate(block_data.second.begin(), block_data.second.end(), true)) {
-                        spdlog::error("failed to hydrate rpc block {}", current_block_height);
+                    std::pair<bool, gs::block> fetched = blocks.next();
+                    if (! fetched.first) {
                         std::this_thread::sleep_for(await_time);
                         --current_block_height;
                         goto retry_loop2;
                     }
+                    gs::block & block = fetched.second;
 
                     current_block_hash = block.block_hash;
 
-                    block.topological_sort();
-                    if (! slpsync_process_block(block, false)) {
+                    std::vector<gs::outpoint> burned;
+                    if (! slpsync_process_block(block, false, false, &burned)) {
                         spdlog::error("failed to process rpc block {}", current_block_height);
                         std::this_thread::sleep_for(await_time);
                         --current_block_height;
                         goto retry_loop2;
                     }
 
-                    current_block_hash = block_hash.second;
-
                     if (cache_enabled) {
-                        cache_slp_block(block, current_block_height);
+                        cache_slp_block(block, current_block_height, burned);
                     }
+
+                    snapshot_after_block(current_block_height);
                 } --current_block_height;
 
                 break;
             }
         }
+
+        if (! wal_path.empty() && ! exit_early) {
+            open_wal();
+        }
     }
 
     zmq::context_t pubcontext;
@@ -781,6 +1897,57 @@ int main(int argc, char * argv[])
         pubsock.bind(toml::find<std::string>(config, "zmqpub", "bind"));
     }
 
+    auto publish_zmq_tx = [&](const gs::transaction& tx) {
+        if (! zmqpub) {
+            return;
+        }
+
+        spdlog::info("publishing zmq tx {}", tx.txid.decompress(true));
+        std::array<zmq::const_buffer, 2> msgs = {
+            zmq::str_buffer("rawtx"),
+            zmq::buffer(tx.serialized.data(), tx.serialized.size())
+        };
+        zmq::send_multipart(pubsock, msgs, zmq::send_flags::dontwait);
+
+        last_outgoing_zmq_tx      = tx.txid;
+        last_outgoing_zmq_tx_unix = current_time();
+    };
+
+    // forwards the message tx was hydrated from instead of copying tx.serialized, msg is consumed
+    auto relay_zmq_tx = [&](const gs::transaction& tx, zmq::message_t& msg) {
+        if (! zmqpub) {
+            return;
+        }
+
+        spdlog::info("publishing zmq tx {}", tx.txid.decompress(true));
+        pubsock.send(zmq::str_buffer("rawtx"), zmq::send_flags::sndmore | zmq::send_flags::dontwait);
+        pubsock.send(msg, zmq::send_flags::dontwait);
+
+        last_outgoing_zmq_tx      = tx.txid;
+        last_outgoing_zmq_tx_unix = current_time();
+    };
+
+    // sends the slp transactions of block, the serialized block is handed to zmq without a copy
+    auto publish_zmq_block = [&](const gs::block& block) {
+        if (! zmqpub) {
+            return;
+        }
+
+        spdlog::info("publishing zmq block {}", block.block_hash.decompress(true));
+
+        std::vector<std::uint8_t>* bserial = new std::vector<std::uint8_t>(block.serialize());
+        zmq::message_t msg(bserial->data(), bserial->size(), [](void*, void* hint) {
+            delete static_cast<std::vector<std::uint8_t>*>(hint);
+        }, bserial);
+
+        pubsock.send(zmq::str_buffer("rawblock"), zmq::send_flags::sndmore | zmq::send_flags::dontwait);
+        pubsock.send(msg, zmq::send_flags::dontwait);
+
+        last_outgoing_zmq_blk_size = block.txs.size();
+        last_outgoing_zmq_blk_unix = current_time();
+    };
+
+    // the listener only receives, transactions are validated and inserted in batches by the applier
     std::thread bitcoind_zmq_listener([&] {
         if (! toml::find<bool>(config, "services", "bitcoind_zmq") || !is_json_rpc) {
             return;
@@ -804,93 +1971,112 @@ int main(int argc, char * argv[])
                 if (env_str == "rawtx" || env_str == "rawblock") {
                     // std::cout << "Received envelope '" << env_str << "'" << std::endl;
 
-                    zmq::message_t msg;
-                    subsock.recv(&msg);
+                    std::unique_ptr<zmq_ingest_item> item(new zmq_ingest_item());
+                    item->block = env_str == "rawblock";
+                    subsock.recv(&item->msg);
 
-                    std::vector<std::uint8_t> msg_data;
-                    msg_data.reserve(msg.size());
+                    zmq_ingest->push(std::move(item));
+                }
+            } catch (const zmq::error_t& e) {
+                spdlog::error(e.what());
+            }
+        }
+    });
 
-                    std::copy(
-                        static_cast<std::uint8_t*>(msg.data()),
-                        static_cast<std::uint8_t*>(msg.data())+msg.size(),
-                        std::back_inserter(msg_data)
-                    );
+    std::thread bitcoind_zmq_applier([&] {
+        if (! toml::find<bool>(config, "services", "bitcoind_zmq") || !is_json_rpc) {
+            return;
+        }
 
+        // consecutive transactions are applied together, a block applies the ones before it first
+        // received messages are relayed as they are, released orphans are serialized again
+        std::vector<gs::transaction> txs;
+        absl::flat_hash_map<gs::txid, zmq::message_t*> received;
+        auto apply_txs = [&] {
+            if (txs.empty()) {
+                return;
+            }
 
-                    if (startup_processing_mempool) {
-                        if (env_str == "rawtx") {
-                            gs::transaction tx;
-                            if (tx.hydrate(msg_data.begin(), msg_data.end())) {
-                                if (tx.slp.type != gs::slp_transaction_type::invalid) {
-                                    startup_mempool_transactions.push_back(tx);
-                                }
-                            }
-                        }
-                    } else {
-                        if (env_str == "rawtx") {
-                            gs::transaction tx;
-                            if (! tx.hydrate(msg_data.begin(), msg_data.end())) {
-                                spdlog::error("zmq-tx unable to be hydrated");
-                                continue;
-                            }
-                            last_incoming_zmq_tx      = tx.txid;
-                            last_incoming_zmq_tx_unix = current_time();
-
-                            if (! slpsync_process_tx(tx)) {
-                                // spdlog::warn("failed to process zmq tx {}", tx.txid.decompress(true));
-                                continue;
-                            }
-                            if (zmqpub) {
-                                spdlog::info("publishing zmq tx {}", tx.txid.decompress(true));
-                                std::array<zmq::const_buffer, 2> msgs = {
-                                    zmq::str_buffer("rawtx"),
-                                    zmq::buffer(tx.serialized.data(), tx.serialized.size())
-                                };
-                                zmq::send_multipart(pubsock, msgs, zmq::send_flags::dontwait);
-
-                                last_outgoing_zmq_tx      = tx.txid;
-                                last_outgoing_zmq_tx_unix = current_time();
-                            }
-                        }
-                        if (env_str == "rawblock") {
-                            gs::block block;
-                            if (! block.hydrate(msg_data.begin(), msg_data.end(), true)) {
-                                spdlog::error("failed to hydrate zmq block");
-                                continue;
-                            }
-                            last_incoming_zmq_blk_size = block.txs.size();
-                            last_incoming_zmq_blk_unix = current_time();
-
-                            block.topological_sort();
-
-                            ++current_block_height;
-                            if (! slpsync_process_block(block, false)) {
-                                spdlog::error("failed to process zmq block {}", current_block_height);
-                                --current_block_height;
-                                continue;
-                            }
-
-                            current_block_hash = block.block_hash;
-
-                            if (zmqpub) {
-                                spdlog::info("publishing zmq block {}", block.block_hash.decompress(true));
-
-                                const std::vector<std::uint8_t> bserial = block.serialize();
-                                std::array<zmq::const_buffer, 2> msgs = {
-                                    zmq::str_buffer("rawblock"),
-                                    zmq::buffer(bserial.data(), bserial.size())
-                                };
-                                zmq::send_multipart(pubsock, msgs, zmq::send_flags::dontwait);
-
-                                last_outgoing_zmq_blk_size = block.txs.size();
-                                last_outgoing_zmq_blk_unix = current_time();
-                            }
-                        }
+            std::vector<gs::transaction> applied;
+            slpsync_process_txs(txs, applied);
+            for (const gs::transaction & tx : applied) {
+                const auto it = received.find(tx.txid);
+                if (it != received.end()) {
+                    relay_zmq_tx(tx, *it->second);
+                } else {
+                    publish_zmq_tx(tx);
+                }
+            }
+            txs.clear();
+            received.clear();
+        };
+
+        while (! exit_early) {
+            // the batch owns the messages until the transactions in it are applied
+            const std::vector<std::unique_ptr<zmq_ingest_item>> batch = zmq_ingest->pop_batch(ingest_batch_size, await_time);
+            for (const std::unique_ptr<zmq_ingest_item> & item : batch) {
+                const std::uint8_t * msg_begin = static_cast<const std::uint8_t*>(item->msg.data());
+                const std::uint8_t * msg_end   = msg_begin + item->msg.size();
+
+                if (startup_processing_mempool) {
+                    if (item->block) {
+                        continue;
+                    }
+
+                    gs::transaction tx;
+                    if (tx.hydrate(msg_begin, msg_end) && startup_mempool_add(tx)) {
+                        continue;
                     }
                 }
-            } catch (const zmq::error_t& e) {
-                spdlog::error(e.what());
+
+                if (! item->block) {
+                    gs::transaction tx;
+                    if (! tx.hydrate(msg_begin, msg_end)) {
+                        spdlog::error("zmq-tx unable to be hydrated");
+                        continue;
+                    }
+                    last_incoming_zmq_tx      = tx.txid;
+                    last_incoming_zmq_tx_unix = current_time();
+
+                    received.emplace(tx.txid, &item->msg);
+                    txs.push_back(std::move(tx));
+                    continue;
+                }
+
+                apply_txs();
+
+                gs::block block;
+                if (! block.hydrate(msg_begin, msg_end, true)) {
+                    spdlog::error("failed to hydrate zmq block");
+                    continue;
+                }
+                last_incoming_zmq_blk_size = block.txs.size();
+                last_incoming_zmq_blk_unix = current_time();
+
+                block.topological_sort();
+                if (! slpsync_reorg(block, rpc_client)) {
+                    // nothing signed against the old tip can be trusted
+                    oracle_cache.clear();
+                    spdlog::error("could not connect zmq block {}, stopping", block.block_hash.decompress(true));
+                    resync_required = true;
+                    request_shutdown();
+                    return;
+                }
+
+                ++current_block_height;
+                if (! slpsync_process_block(block, false)) {
+                    spdlog::error("failed to process zmq block {}", current_block_height);
+                    --current_block_height;
+                    continue;
+                }
+
+                current_block_hash = block.block_hash;
+                snapshot_after_block(current_block_height);
+
+                publish_zmq_block(block);
             }
+
+            apply_txs();
         }
     });
 
@@ -899,36 +2085,26 @@ int main(int argc, char * argv[])
             return;
         }
         rpc_client.subscribe_raw_transactions([&](std::string txn) {
-            if (startup_processing_mempool) {
-                gs::transaction tx;
-                if (tx.hydrate(txn.begin(), txn.end())) {
-                    if (tx.slp.type != gs::slp_transaction_type::invalid) {
-                        startup_mempool_transactions.push_back(tx);
-                    }
-                }
+            gs::transaction tx;
+            if (! tx.hydrate(txn.begin(), txn.end())) {
+                spdlog::error("zmq-tx unable to be hydrated");
+                return;
+            }
+
+            if (startup_processing_mempool && startup_mempool_add(tx)) {
+                return;
             } else {
-                gs::transaction tx;
-                if (! tx.hydrate(txn.begin(), txn.end())) {
-                    spdlog::error("zmq-tx unable to be hydrated");
-                    return;
-                }
                 last_incoming_zmq_tx      = tx.txid;
                 last_incoming_zmq_tx_unix = current_time();
 
-                if (! slpsync_process_tx(tx)) {
+                std::vector<gs::transaction> released;
+                if (! slpsync_process_tx(tx, released)) {
                     // spdlog::warn("failed to process zmq tx {}", tx.txid.decompress(true));
                     return;
                 }
-                if (zmqpub) {
-                    spdlog::info("publishing zmq tx {}", tx.txid.decompress(true));
-                    std::array<zmq::const_buffer, 2> msgs = {
-                        zmq::str_buffer("rawtx"),
-                        zmq::buffer(tx.serialized.data(), tx.serialized.size())
-                    };
-                    zmq::send_multipart(pubsock, msgs, zmq::send_flags::dontwait);
-
-                    last_outgoing_zmq_tx      = tx.txid;
-                    last_outgoing_zmq_tx_unix = current_time();
+                publish_zmq_tx(tx);
+                for (const gs::transaction & rtx : released) {
+                    publish_zmq_tx(rtx);
                 }
             }
         });
@@ -939,7 +2115,7 @@ int main(int argc, char * argv[])
             return;
         }
         rpc_client.subscribe_raw_blocks([&](std::string blk) {
-            if (startup_processing_mempool) {
+            if (startup_processing_mempool || exit_early) {
                 return;
             } else {
                 gs::block block;
@@ -950,28 +2126,26 @@ int main(int argc, char * argv[])
                 last_incoming_zmq_blk_unix = current_time();
 
                 block.topological_sort();
+                if (! slpsync_reorg(block, rpc_client)) {
+                    // nothing signed against the old tip can be trusted
+                    oracle_cache.clear();
+                    spdlog::error("could not connect bchd block {}, stopping", block.block_hash.decompress(true));
+                    resync_required = true;
+                    request_shutdown();
+                    return;
+                }
 
                 ++current_block_height;
                 if (! slpsync_process_block(block, false)) {
                     spdlog::error("failed to process zmq block {}", current_block_height);
                     --current_block_height;
+                } else {
+                    snapshot_after_block(current_block_height);
                 }
 
                 current_block_hash = block.block_hash;
 
-                if (zmqpub) {
-                    spdlog::info("publishing zmq block {}", block.block_hash.decompress(true));
-
-                    const std::vector<std::uint8_t> bserial = block.serialize();
-                    std::array<zmq::const_buffer, 2> msgs = {
-                        zmq::str_buffer("rawblock"),
-                        zmq::buffer(bserial.data(), bserial.size())
-                    };
-                    zmq::send_multipart(pubsock, msgs, zmq::send_flags::dontwait);
-
-                    last_outgoing_zmq_blk_size = block.txs.size();
-                    last_outgoing_zmq_blk_unix = current_time();
-                }
+                publish_zmq_block(block);
             }        
         });
     });
@@ -990,18 +2164,29 @@ retry_loop1:
                 continue;
             }
 
-            for (const gs::txid & txid : txids.second) {
-                //const std::pair<bool, std::vector<std::uint8_t>> txdata = rpc.get_raw_transaction(txid);
-                const std::pair<bool, std::vector<std::uint8_t>> txdata = rpc_client.get_raw_transaction(txid);
+            // transactions restored from the snapshot or wal are not fetched again
+            {
+                boost::shared_lock<boost::shared_mutex> lock(processing_mutex);
+                txids.second.erase(
+                    std::remove_if(txids.second.begin(), txids.second.end(), [](const gs::txid& txid) {
+                        return validator.has(txid);
+                    }),
+                    txids.second.end()
+                );
+            }
 
-                if (! txdata.first) {
-                    spdlog::warn("get_raw_transaction failed");
-                    std::this_thread::sleep_for(await_time);
-                    goto retry_loop1;
-                }
+            const std::pair<bool, std::vector<std::vector<std::uint8_t>>> txdatas = rpc_client.get_raw_transactions(txids.second);
+            if (! txdatas.first) {
+                spdlog::warn("get_raw_transaction failed");
+                std::this_thread::sleep_for(await_time);
+                continue;
+            }
 
+            // the listeners queue transactions relayed meanwhile, those must be kept
+            std::vector<gs::transaction> rpc_txs;
+            for (const std::vector<std::uint8_t> & txdata : txdatas.second) {
                 gs::transaction tx;
-                const bool hydration_success = tx.hydrate(txdata.second.begin(), txdata.second.end());
+                const bool hydration_success = tx.hydrate(txdata.begin(), txdata.end());
 
                 if (! hydration_success) {
                     spdlog::error("failed to hydrate mempool tx");
@@ -1010,10 +2195,21 @@ retry_loop1:
                 }
 
                 if (tx.slp.type != gs::slp_transaction_type::invalid) {
-                    startup_mempool_transactions.push_back(tx);
+                    rpc_txs.push_back(std::move(tx));
                 }
             }
 
+            boost::lock_guard<boost::mutex> lock(startup_mempool_mtx);
+            // a listener may have queued the same transaction already
+            absl::flat_hash_set<gs::txid> queued;
+            for (const gs::transaction & tx : startup_mempool_transactions) {
+                queued.insert(tx.txid);
+            }
+            for (gs::transaction & tx : rpc_txs) {
+                if (queued.insert(tx.txid).second) {
+                    startup_mempool_transactions.push_back(std::move(tx));
+                }
+            }
             break;
         }
     }
@@ -1021,13 +2217,17 @@ retry_loop1:
 
     // repurposing to use as mempool container
     gs::block block;
-    block.txs = startup_mempool_transactions;
+    {
+        // transactions relayed from here on are processed by the listeners themselves
+        boost::lock_guard<boost::mutex> lock(startup_mempool_mtx);
+        block.txs = std::move(startup_mempool_transactions);
+        startup_processing_mempool = false;
+    }
     block.topological_sort();
     slpsync_process_block(block, true);
-    startup_processing_mempool = false;
 
 
-    if (! exit_early && toml::find<bool>(config, "services", "grpc")) {
+    if (toml::find<bool>(config, "services", "grpc")) {
         const std::string server_address(
             toml::find<std::string>(config, "grpc", "host")+
             ":"+
@@ -1041,15 +2241,46 @@ retry_loop1:
         builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
         builder.RegisterService(&graphsearch_service);
         builder.RegisterService(&utxo_service);
-        gserver = builder.BuildAndStart();
-        spdlog::info("gs++ listening on {}", server_address);
+        grpc::Server* server = nullptr;
+        {
+            // a signal arriving before this point is seen here, later ones shut the server down
+            boost::lock_guard<boost::mutex> lock(gserver_mtx);
+            if (! exit_early) {
+                gserver = builder.BuildAndStart();
+                server = gserver.get();
+            }
+        }
 
-        if (gserver) {
-            gserver->Wait();
+        if (server) {
+            spdlog::info("gs++ listening on {}", server_address);
+            server->Wait();
         }
     }
 
+    // without the grpc server nothing else keeps us here until a signal or a failed reorg
+    while (! exit_early) {
+        std::this_thread::sleep_for(await_time);
+    }
+
+    // a snapshot of the dropped branch would be resumed as if it were the node's chain
+    if (resync_required) {
+        tx_wal.close();
+        spdlog::error("stopped without a final snapshot as a reorg could not be applied, a resync is needed");
+
+        std::quick_exit(EXIT_FAILURE);
+    }
+
+    if (! snapshot_path.empty() || ! wal_path.empty()) {
+        save_state_snapshot();
+        tx_wal.close();
+        spdlog::info("goodbye");
+
+        // the listeners are blocked on their sockets and can not be joined
+        std::quick_exit(EXIT_SUCCESS);
+    }
+
     bitcoind_zmq_listener.join();
+    bitcoind_zmq_applier.join();
     bchd_txn_listener.join();
     bchd_block_listener.join();
 
@@ -4,6 +4,7 @@
 #include <stack>
 #include <functional>
 #include <cassert>
+#include <iterator>
 
 #include <boost/thread.hpp>
 #include <spdlog/spdlog.h>
@@ -26,12 +27,11 @@ void bch::process_block(
     const bool save_rollback
 ) {
     boost::lock_guard<boost::shared_mutex> lock(lookup_mtx);
+    // searches read the utxodb under its own lock
+    boost::lock_guard<boost::shared_mutex> utxodb_lock(utxodb.lookup_mtx);
 
     ++utxodb.current_block_height;
 
-    gs::block block;
-    block.hydrate(block_data.begin(), block_data.end());
-
     std::vector<gs::outpoint>    blk_inputs;
     std::vector<gs::output>      blk_outputs;
     std::vector<gs::transaction> slp_txs;
@@ -39,23 +39,31 @@ void bch::process_block(
     std::size_t total_added = 0;
     std::size_t total_removed = 0;
 
-    for (auto & tx : block.txs) {
-        for (auto & m : tx.inputs) {
-            blk_inputs.push_back(m);
-        }
-
-        for (auto & m : tx.outputs) {
-            blk_outputs.push_back(m);
-        }
+    // streamed so the block is never held as a vector of transactions
+    gs::block block;
+    block.decode(block_data.begin(), block_data.end(), [&](gs::transaction&& tx) {
+        blk_inputs.insert(blk_inputs.end(), tx.inputs.begin(), tx.inputs.end());
 
         if (tx.slp.type != gs::slp_transaction_type::invalid) {
-            slp_txs.push_back(tx);
+            blk_outputs.insert(blk_outputs.end(), tx.outputs.begin(), tx.outputs.end());
+            slp_txs.push_back(std::move(tx));
+        } else {
+            std::move(tx.outputs.begin(), tx.outputs.end(), std::back_inserter(blk_outputs));
         }
-    }
+
+        return true;
+    });
+
+    utxodb.current_block_hash = block.block_hash;
 
     // only used if save_rollback enabled
-    std::vector<gs::outpoint> this_block_added;
-    std::vector<gs::output>   this_block_removed;
+    gs::utxo_undo undo;
+    undo.height    = utxodb.current_block_height;
+    undo.hash      = block.block_hash;
+    undo.prev_hash = gs::blockhash(block.prev_block.v);
+
+    // only used if the commitment is enabled
+    std::vector<const gs::output*> commitment_added;
 
     for (auto & m : blk_outputs) {
         if (m.is_op_return()) {
@@ -63,56 +71,78 @@ void bch::process_block(
         }
 
         const gs::outpoint outpoint(m.prev_tx_id, m.prev_out_idx);
-        gs::output* const oid = &(*utxodb.outpoint_map.insert({ outpoint, m }).first).second;
+        const bool added = utxodb.add_output(m);
         ++total_added;
 
-        if (! utxodb.scriptpubkey_to_output.count(m.scriptpubkey)) {
-            utxodb.scriptpubkey_to_output.insert({ m.scriptpubkey, { oid } });
-        } else {
-            utxodb.scriptpubkey_to_output[m.scriptpubkey].insert(oid);
+        if (utxodb.commitment_enabled && added) {
+            commitment_added.push_back(&m);
         }
 
-        utxodb.mempool_outpoint_map.erase(outpoint);
-        if (utxodb.mempool_scriptpubkey_to_output.count(m.scriptpubkey) > 0) {
-            utxodb.mempool_scriptpubkey_to_output.at(m.scriptpubkey).erase(oid);
+        const auto mempool_outpoint_map_search = utxodb.mempool_outpoint_map.find(outpoint);
+        if (mempool_outpoint_map_search != utxodb.mempool_outpoint_map.end()) {
+            const gs::output& o = mempool_outpoint_map_search->second;
+            const auto addr_search = utxodb.mempool_scriptpubkey_to_output.find(o.scriptpubkey);
+            if (addr_search != utxodb.mempool_scriptpubkey_to_output.end()) {
+                addr_search->second.erase(&o);
+                if (addr_search->second.empty()) {
+                    utxodb.mempool_scriptpubkey_to_output.erase(addr_search);
+                }
+            }
+
+            utxodb.mempool_outpoint_map.erase(mempool_outpoint_map_search);
         }
-        utxodb.mempool_spent_confirmed_outpoints.erase(gs::outpoint(oid->prev_tx_id, oid->prev_out_idx));
+        utxodb.mempool_spent_confirmed_outpoints.erase(outpoint);
 
         if (save_rollback) {
-            this_block_added.push_back(outpoint);
+            // outputs are grouped by transaction
+            if (undo.txids.empty() || undo.txids.back() != m.prev_tx_id) {
+                undo.push_tx(m.prev_tx_id);
+            }
+            undo.push_added(m.prev_out_idx);
         }
         // std::cout << height << "\tadded: " << m.prev_tx_id.decompress(true) << ":" << m.prev_out_idx << "\n";
     }
 
-    slp_txs = gs::util::topological_sort(slp_txs);
+    slp_txs = gs::util::topological_sort(std::move(slp_txs));
     for (auto & m : slp_txs) {
+        if (save_rollback) {
+            const gs::tokenid tokenid = m.slp.type == gs::slp_transaction_type::genesis
+                ? gs::tokenid(m.txid.v)
+                : m.slp.tokenid;
+
+            auto token_search = slpdb.tokens.find(tokenid);
+            if (token_search == slpdb.tokens.end()) {
+                if (m.slp.type == gs::slp_transaction_type::genesis) {
+                    undo.slp_txs.emplace_back(tokenid, m.txid);
+                }
+            } else {
+                undo.push_baton(tokenid, token_search->second.mint_baton_outpoint);
+                if (token_search->second.transactions.count(m.txid) == 0) {
+                    undo.slp_txs.emplace_back(tokenid, m.txid);
+                }
+            }
+        }
+
         slpdb.add_transaction(m);
     }
 
-    for (auto & m : blk_inputs) {
-        if (utxodb.outpoint_map.count(m) > 0) {
-            const gs::output& o = utxodb.outpoint_map.at(m);
-
-            if (utxodb.scriptpubkey_to_output.count(o.scriptpubkey) > 0) {
-                absl::flat_hash_set<gs::output*> & addr_map = utxodb.scriptpubkey_to_output.at(o.scriptpubkey);
+    // only used if the commitment is enabled
+    std::vector<gs::output> commitment_removed;
 
-                if (addr_map.erase(&o)) {
-                    // std::cout << height << "\tremoved: " << m.txid.decompress(true) << ":" << m.vout << "\n";
-                }
-                if (addr_map.empty()) {
-                    utxodb.scriptpubkey_to_output.erase(o.scriptpubkey);
-                }
-
-                utxodb.mempool_spent_confirmed_outpoints.erase(gs::outpoint(o.prev_tx_id, o.prev_out_idx));
-            }
+    for (auto & m : blk_inputs) {
+        gs::output o;
+        if (utxodb.remove_output(m, o)) {
+            // std::cout << height << "\tremoved: " << m.txid.decompress(true) << ":" << m.vout << "\n";
+            utxodb.mempool_spent_confirmed_outpoints.erase(m);
 
             if (save_rollback) {
-                this_block_removed.push_back(o);
+                undo.push_removed(o);
             }
-
-            if (utxodb.outpoint_map.erase(m)) {
-                ++total_removed;
+            if (utxodb.commitment_enabled) {
+                commitment_removed.push_back(std::move(o));
             }
+
+            ++total_removed;
         }
 
         if (utxodb.mempool_outpoint_map.count(m) > 0) {
@@ -129,10 +159,6 @@ void bch::process_block(
                 }
             }
 
-            if (save_rollback) {
-                this_block_removed.push_back(o);
-            }
-
             if (utxodb.mempool_outpoint_map.erase(m)) {
                 ++total_removed;
             }
@@ -147,6 +173,15 @@ void bch::process_block(
 
         assert(slpdb.tokens.count(slp_utxo_to_tokenid_search->second) == 1);
         gs::slp_token & slp_token = slpdb.tokens[slp_utxo_to_tokenid_search->second];
+
+        if (save_rollback) {
+            const auto utxo_search = slp_token.utxos.find(m);
+            if (utxo_search != slp_token.utxos.end()) {
+                undo.push_baton(slp_utxo_to_tokenid_search->second, slp_token.mint_baton_outpoint);
+                undo.slp_removed.push_back({ slp_utxo_to_tokenid_search->second, utxo_search->second });
+            }
+        }
+
         if (! slp_token.utxos.erase(m)) {
             spdlog::error("deleted slp utxo not found");
         } else if (slp_token.mint_baton_outpoint.has_value()
@@ -156,16 +191,17 @@ void bch::process_block(
         }
     }
 
-    if (save_rollback) {
-        utxodb.last_block_added.push_back(this_block_added);
-        utxodb.last_block_removed.push_back(this_block_removed);
-
-        if (utxodb.last_block_added.size() > utxodb.rollback_depth) {
-            utxodb.last_block_added.pop_front();
-        }
-        if (utxodb.last_block_removed.size() > utxodb.rollback_depth) {
-            utxodb.last_block_removed.pop_front();
+    if (utxodb.commitment_enabled) {
+        std::vector<const gs::output*> removed;
+        removed.reserve(commitment_removed.size());
+        for (auto & m : commitment_removed) {
+            removed.push_back(&m);
         }
+        utxodb.commitment.update(commitment_added, removed);
+    }
+
+    if (save_rollback) {
+        utxodb.push_undo(std::move(undo));
     }
 
     // spdlog::info("processed block +{} -{}", total_added, total_removed);
@@ -174,6 +210,7 @@ void bch::process_block(
 void bch::process_mempool_tx(const std::vector<std::uint8_t>& msg_data)
 {
     boost::lock_guard<boost::shared_mutex> lock(lookup_mtx);
+    boost::lock_guard<boost::shared_mutex> utxodb_lock(utxodb.lookup_mtx);
 
     gs::transaction tx;
     const bool hydration_success = tx.hydrate(msg_data.begin(), msg_data.end());
@@ -192,12 +229,7 @@ void bch::process_mempool_tx(const std::vector<std::uint8_t>& msg_data)
 
         const gs::outpoint outpoint(m.prev_tx_id, m.prev_out_idx);
         gs::output* const oid = &(*utxodb.mempool_outpoint_map.insert({ outpoint, m }).first).second;
-
-        if (! utxodb.scriptpubkey_to_output.count(m.scriptpubkey)) {
-            utxodb.mempool_scriptpubkey_to_output.insert({ m.scriptpubkey, { oid } });
-        } else {
-            utxodb.mempool_scriptpubkey_to_output[m.scriptpubkey].insert(oid);
-        }
+        utxodb.mempool_scriptpubkey_to_output[m.scriptpubkey].insert(oid);
     }
 
     for (auto & m : tx.inputs) {
@@ -230,7 +262,20 @@ void bch::process_mempool_tx(const std::vector<std::uint8_t>& msg_data)
 
 
 
-void bch::rollback()
-{}
+bool bch::rollback()
+{
+    boost::lock_guard<boost::shared_mutex> lock(lookup_mtx);
+
+    gs::utxo_undo undo;
+    if (! utxodb.rollback(undo)) {
+        return false;
+    }
+
+    slpdb.rollback(undo);
+
+    spdlog::info("rolled back block {} {}", undo.height, undo.hash.decompress(true));
+
+    return true;
+}
 
 }
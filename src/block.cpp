@@ -1,6 +1,5 @@
 #include <iostream>
 #include <algorithm>
-#include <sstream>
 #include <gs++/block.hpp>
 
 
@@ -9,29 +8,37 @@ namespace gs {
 
 void block::topological_sort()
 {
-    txs = gs::util::topological_sort(txs);
+    txs = gs::util::topological_sort(std::move(txs));
 }
 
 std::vector<std::uint8_t> block::serialize() const
 {
-    std::stringstream ss;
-
-    ss.write(reinterpret_cast<const char *>(&version), sizeof(std::uint32_t));
-    ss.write(reinterpret_cast<const char *>(prev_block.data()), prev_block.size());
-    ss.write(reinterpret_cast<const char *>(merkle_root.data()), merkle_root.size());
-    ss.write(reinterpret_cast<const char *>(&timestamp), sizeof(std::uint32_t));
-    ss.write(reinterpret_cast<const char *>(&bits), sizeof(std::uint32_t));
-    ss.write(reinterpret_cast<const char *>(&nonce), sizeof(std::uint32_t));
-
     const std::vector<std::uint8_t> varint_tx_length = gs::util::num_to_var_int(txs.size());
-    ss.write(reinterpret_cast<const char *>(varint_tx_length.data()), varint_tx_length.size());
 
+    std::size_t size = 80 + varint_tx_length.size();
     for (auto & tx : txs) {
-        ss.write(reinterpret_cast<const char *>(tx.serialized.data()), tx.serialized.size());
+        size += tx.serialized.size();
     }
 
-    const std::string str = ss.str();
-    const std::vector<std::uint8_t> ret(str.begin(), str.end());
+    std::vector<std::uint8_t> ret;
+    ret.reserve(size);
+
+    auto append = [&ret](const void * data, const std::size_t len) {
+        const std::uint8_t * p = static_cast<const std::uint8_t *>(data);
+        ret.insert(ret.end(), p, p + len);
+    };
+
+    append(&version, sizeof(std::uint32_t));
+    append(prev_block.data(), prev_block.size());
+    append(merkle_root.data(), merkle_root.size());
+    append(&timestamp, sizeof(std::uint32_t));
+    append(&bits, sizeof(std::uint32_t));
+    append(&nonce, sizeof(std::uint32_t));
+    append(varint_tx_length.data(), varint_tx_length.size());
+
+    for (auto & tx : txs) {
+        append(tx.serialized.data(), tx.serialized.size());
+    }
 
     return ret;
 }
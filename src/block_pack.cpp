@@ -0,0 +1,470 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <limits>
+
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+#include <spdlog/spdlog.h>
+
+#include <gs++/block_pack.hpp>
+#include <gs++/bhash.hpp>
+
+namespace gs {
+
+namespace {
+
+std::uint32_t crc32(const std::uint8_t* data, const std::size_t len)
+{
+    boost::crc_32_type crc;
+    crc.process_bytes(data, len);
+    return crc.checksum();
+}
+
+template <typename T>
+void put(std::uint8_t* out, const T v)
+{
+    std::memcpy(out, &v, sizeof(T));
+}
+
+template <typename T>
+T get(const std::uint8_t* in)
+{
+    T v;
+    std::memcpy(&v, in, sizeof(T));
+    return v;
+}
+
+bool write_all(const int fd, const std::uint8_t* data, std::size_t len)
+{
+    while (len > 0) {
+        const ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len  -= static_cast<std::size_t>(n);
+    }
+
+    return true;
+}
+
+bool read_all(const int fd, std::uint8_t* data, std::size_t len, std::uint64_t offset)
+{
+    while (len > 0) {
+        const ssize_t n = ::pread(fd, data, len, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data   += n;
+        len    -= static_cast<std::size_t>(n);
+        offset += static_cast<std::uint64_t>(n);
+    }
+
+    return true;
+}
+
+std::uint64_t file_size(const int fd)
+{
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        return 0;
+    }
+
+    return static_cast<std::uint64_t>(st.st_size);
+}
+
+// layout of an index entry, all fields little endian
+//   0 height, 4 segment, 8 offset, 16 length, 20 checksum, 24 hash, 56 entry crc, 60 reserved
+void encode_entry(const block_pack::entry& e, std::uint8_t* out)
+{
+    std::memset(out, 0, block_pack::entry_size);
+    put<std::uint32_t>(out +  0, e.height);
+    put<std::uint32_t>(out +  4, e.segment);
+    put<std::uint64_t>(out +  8, e.offset);
+    put<std::uint32_t>(out + 16, e.length);
+    put<std::uint32_t>(out + 20, e.checksum);
+    std::copy(e.hash.v.begin(), e.hash.v.end(), out + 24);
+    put<std::uint32_t>(out + 56, crc32(out, 56));
+}
+
+bool decode_entry(const std::uint8_t* in, block_pack::entry& e)
+{
+    if (get<std::uint32_t>(in + 56) != crc32(in, 56)) {
+        return false;
+    }
+
+    e.height   = get<std::uint32_t>(in +  0);
+    e.segment  = get<std::uint32_t>(in +  4);
+    e.offset   = get<std::uint64_t>(in +  8);
+    e.length   = get<std::uint32_t>(in + 16);
+    e.checksum = get<std::uint32_t>(in + 20);
+    std::copy(in + 24, in + 56, e.hash.v.begin());
+
+    return true;
+}
+
+}
+
+constexpr std::uint32_t block_pack::magic;
+constexpr std::uint32_t block_pack::version;
+constexpr std::size_t   block_pack::header_size;
+constexpr std::size_t   block_pack::entry_size;
+
+block_pack::~block_pack()
+{
+    close();
+}
+
+std::string block_pack::segment_path(const std::string& dir, const std::uint32_t segment)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "seg-%05u.dat", segment);
+    return (boost::filesystem::path(dir) / name).string();
+}
+
+std::string block_pack::index_path(const std::string& dir)
+{
+    return (boost::filesystem::path(dir) / "index.dat").string();
+}
+
+bool block_pack::open(const std::string& dir)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+
+    if (index_fd != -1) {
+        return false;
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(dir, ec);
+    if (ec) {
+        spdlog::error("block_pack: could not create {}: {}", dir, ec.message());
+        return false;
+    }
+    this->dir = dir;
+
+    index_fd = ::open(index_path(dir).c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (index_fd == -1) {
+        spdlog::error("block_pack: could not open {}", index_path(dir));
+        return false;
+    }
+
+    std::uint64_t index_size = file_size(index_fd);
+    if (index_size < header_size) {
+        std::uint8_t header[header_size];
+        put<std::uint32_t>(header + 0, magic);
+        put<std::uint32_t>(header + 4, version);
+        if (::ftruncate(index_fd, 0) != 0 || ! write_all(index_fd, header, header_size)) {
+            spdlog::error("block_pack: could not write index header");
+            return false;
+        }
+        index_size = header_size;
+    }
+
+    std::vector<std::uint8_t> index(index_size);
+    if (! read_all(index_fd, index.data(), index.size(), 0)) {
+        spdlog::error("block_pack: could not read index");
+        return false;
+    }
+
+    if (get<std::uint32_t>(index.data()) != magic || get<std::uint32_t>(index.data() + 4) != version) {
+        spdlog::error("block_pack: {} is not a version {} index", index_path(dir), version);
+        return false;
+    }
+
+    for (std::uint32_t s=0; boost::filesystem::exists(segment_path(dir, s)); ++s) {
+        if (! open_segment(s)) {
+            return false;
+        }
+    }
+
+    // walk entries until the first one which is torn or points past its segment
+    std::uint64_t valid_end = header_size;
+    std::vector<std::uint64_t> segment_end(segments.size(), 0);
+    for (std::uint64_t pos = header_size; pos + entry_size <= index.size(); pos += entry_size) {
+        entry e;
+        if (! decode_entry(index.data() + pos, e)) {
+            break;
+        }
+
+        if (e.length == 0) {
+            entries.erase(e.height);
+            valid_end = pos + entry_size;
+            continue;
+        }
+
+        if (e.segment >= segments.size()
+         || e.offset + e.length > segments[e.segment].size
+        ) {
+            break;
+        }
+
+        entries[e.height] = e;
+        segment_end[e.segment] = std::max(segment_end[e.segment], e.offset + e.length);
+        valid_end = pos + entry_size;
+    }
+
+    if (valid_end != index.size()) {
+        spdlog::warn("block_pack: dropping {} bytes of torn index", index.size() - valid_end);
+        if (::ftruncate(index_fd, valid_end) != 0) {
+            spdlog::error("block_pack: could not truncate index");
+            return false;
+        }
+    }
+
+    // data after the last indexed block of the active segment was never committed
+    if (! segments.empty() && segments.back().size != segment_end.back()) {
+        if (::ftruncate(segments.back().fd, segment_end.back()) != 0) {
+            spdlog::error("block_pack: could not truncate segment");
+            return false;
+        }
+        segments.back().size = segment_end.back();
+    }
+
+    return true;
+}
+
+void block_pack::close()
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+
+    for (segment & seg : segments) {
+        if (seg.map != nullptr) {
+            ::munmap(seg.map, seg.map_size);
+        }
+        ::close(seg.fd);
+    }
+    for (auto & m : retired_maps) {
+        ::munmap(m.first, m.second);
+    }
+    segments.clear();
+    retired_maps.clear();
+    entries.clear();
+
+    if (index_fd != -1) {
+        ::close(index_fd);
+        index_fd = -1;
+    }
+}
+
+bool block_pack::open_segment(const std::uint32_t s)
+{
+    const std::string path = segment_path(dir, s);
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd == -1) {
+        spdlog::error("block_pack: could not open {}", path);
+        return false;
+    }
+
+    segment seg;
+    seg.fd       = fd;
+    seg.size     = file_size(fd);
+    seg.map      = nullptr;
+    seg.map_size = 0;
+    segments.push_back(seg);
+
+    return true;
+}
+
+bool block_pack::map_segment(segment& seg)
+{
+    if (seg.map != nullptr && seg.map_size >= seg.size) {
+        return true;
+    }
+
+    // mapping a whole segment up front lets later appends be read without remapping
+    const std::uint64_t map_size = std::max(segment_size, seg.size);
+    void* map = ::mmap(nullptr, map_size, PROT_READ, MAP_SHARED, seg.fd, 0);
+    if (map == MAP_FAILED) {
+        spdlog::error("block_pack: mmap failed: {}", std::strerror(errno));
+        return false;
+    }
+    ::madvise(map, map_size, MADV_SEQUENTIAL);
+
+    // earlier reads may still point into the old mapping
+    if (seg.map != nullptr) {
+        retired_maps.emplace_back(seg.map, seg.map_size);
+    }
+
+    seg.map      = static_cast<std::uint8_t*>(map);
+    seg.map_size = map_size;
+
+    return true;
+}
+
+bool block_pack::append(
+    const std::uint32_t height,
+    const gs::blockhash& hash,
+    const std::uint8_t* data,
+    const std::size_t len
+) {
+    boost::lock_guard<boost::mutex> lock(mtx);
+
+    if (index_fd == -1 || len > std::numeric_limits<std::uint32_t>::max()) {
+        return false;
+    }
+
+    if (segments.empty()
+    || (segments.back().size > 0 && segments.back().size + len > segment_size)
+    ) {
+        if (! open_segment(static_cast<std::uint32_t>(segments.size()))) {
+            return false;
+        }
+    }
+
+    segment & seg = segments.back();
+
+    entry e;
+    e.height   = height;
+    e.segment  = static_cast<std::uint32_t>(segments.size() - 1);
+    e.offset   = seg.size;
+    e.length   = static_cast<std::uint32_t>(len);
+    e.checksum = crc32(data, len);
+    e.hash     = hash;
+
+    if (! write_all(seg.fd, data, len)) {
+        spdlog::error("block_pack: could not write block {}", height);
+        // drop the partial write so offsets stay in sync with the file
+        if (::ftruncate(seg.fd, seg.size) != 0) {
+            spdlog::error("block_pack: could not truncate segment");
+        }
+        return false;
+    }
+    seg.size += len;
+
+    std::uint8_t raw[entry_size];
+    encode_entry(e, raw);
+    if (! write_all(index_fd, raw, entry_size)) {
+        spdlog::error("block_pack: could not write index entry {}", height);
+        return false;
+    }
+
+    entries[height] = e;
+
+    return true;
+}
+
+bool block_pack::drop_above(const std::uint32_t height)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+
+    std::vector<std::uint32_t> dropped;
+    for (const auto & it : entries) {
+        if (it.first > height) {
+            dropped.push_back(it.first);
+        }
+    }
+    if (dropped.empty()) {
+        return true;
+    }
+
+    // lowest first so a torn write still cuts the pack off right above height
+    std::sort(dropped.begin(), dropped.end());
+
+    std::vector<std::uint8_t> raw(dropped.size() * entry_size);
+    for (std::size_t i=0; i<dropped.size(); ++i) {
+        entry e;
+        e.height   = dropped[i];
+        e.segment  = 0;
+        e.offset   = 0;
+        e.length   = 0;
+        e.checksum = 0;
+        e.hash     = gs::blockhash();
+        encode_entry(e, raw.data() + i * entry_size);
+    }
+
+    if (! write_all(index_fd, raw.data(), raw.size())) {
+        spdlog::error("block_pack: could not drop blocks above {}", height);
+        return false;
+    }
+
+    for (const std::uint32_t h : dropped) {
+        entries.erase(h);
+    }
+
+    return true;
+}
+
+bool block_pack::has(const std::uint32_t height)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    return entries.count(height) == 1;
+}
+
+std::pair<bool, block_pack::entry> block_pack::find(const std::uint32_t height)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+
+    auto search = entries.find(height);
+    if (search == entries.end()) {
+        return { false, entry() };
+    }
+
+    return { true, search->second };
+}
+
+std::pair<bool, std::pair<const std::uint8_t*, std::size_t>> block_pack::read(const std::uint32_t height)
+{
+    entry e;
+    const std::uint8_t* data = nullptr;
+    {
+        boost::lock_guard<boost::mutex> lock(mtx);
+
+        auto search = entries.find(height);
+        if (search == entries.end()) {
+            return { false, { nullptr, 0 } };
+        }
+
+        e = search->second;
+        segment & seg = segments[e.segment];
+        if (! map_segment(seg)) {
+            return { false, { nullptr, 0 } };
+        }
+
+        data = seg.map + e.offset;
+    }
+
+    // mappings are never unmapped before close so concurrent reads can checksum unlocked
+    if (crc32(data, e.length) != e.checksum) {
+        spdlog::error("block_pack: checksum mismatch for block {}", height);
+        return { false, { nullptr, 0 } };
+    }
+
+    return { true, { data, e.length } };
+}
+
+std::uint32_t block_pack::contiguous_until(const std::uint32_t first)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+
+    std::uint32_t height = first;
+    while (entries.count(height) == 1) {
+        ++height;
+    }
+
+    return height - 1;
+}
+
+std::size_t block_pack::size()
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    return entries.size();
+}
+
+}
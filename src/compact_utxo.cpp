@@ -0,0 +1,82 @@
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include <gs++/compact_utxo.hpp>
+#include <gs++/scriptpubkey.hpp>
+
+namespace gs {
+
+bool script_ref::from_template(const gs::scriptpubkey& s, script_ref& ref)
+{
+    const std::vector<std::uint8_t>& v = s.v;
+
+    // OP_DUP OP_HASH160 <20> OP_EQUALVERIFY OP_CHECKSIG
+    if (v.size() == 25
+     && v[0]  == 0x76
+     && v[1]  == 0xA9
+     && v[2]  == 0x14
+     && v[23] == 0x88
+     && v[24] == 0xAC
+    ) {
+        ref.tag = kind::p2pkh;
+        std::copy(v.begin() + 3, v.begin() + 23, ref.data.begin());
+        return true;
+    }
+
+    // OP_HASH160 <20> OP_EQUAL
+    if (v.size() == 23
+     && v[0]  == 0xA9
+     && v[1]  == 0x14
+     && v[22] == 0x87
+    ) {
+        ref.tag = kind::p2sh;
+        std::copy(v.begin() + 2, v.begin() + 22, ref.data.begin());
+        return true;
+    }
+
+    return false;
+}
+
+script_ref script_ref::interned(const std::uint32_t id)
+{
+    script_ref ret;
+    ret.tag = kind::interned;
+    std::memcpy(ret.data.data(), &id, sizeof(id));
+    return ret;
+}
+
+std::uint32_t script_ref::interned_id() const
+{
+    std::uint32_t ret;
+    std::memcpy(&ret, data.data(), sizeof(ret));
+    return ret;
+}
+
+gs::scriptpubkey script_ref::to_scriptpubkey(const gs::interner<gs::scriptpubkey>& scripts) const
+{
+    gs::scriptpubkey ret;
+
+    switch (tag) {
+    case kind::p2pkh:
+        ret.v.reserve(25);
+        ret.v.insert(ret.v.end(), { 0x76, 0xA9, 0x14 });
+        ret.v.insert(ret.v.end(), data.begin(), data.end());
+        ret.v.insert(ret.v.end(), { 0x88, 0xAC });
+        break;
+    case kind::p2sh:
+        ret.v.reserve(23);
+        ret.v.insert(ret.v.end(), { 0xA9, 0x14 });
+        ret.v.insert(ret.v.end(), data.begin(), data.end());
+        ret.v.push_back(0x87);
+        break;
+    case kind::interned:
+        ret = scripts.get(interned_id());
+        break;
+    }
+
+    return ret;
+}
+
+}
@@ -0,0 +1,105 @@
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+
+#include <3rdparty/secp256k1/include/secp256k1_multiset.h>
+
+#include <gs++/ecmh.hpp>
+#include <gs++/bhash.hpp>
+#include <gs++/output.hpp>
+
+namespace gs {
+
+namespace {
+
+// below this many outputs per thread starting threads costs more than it saves
+constexpr std::size_t min_outputs_per_thread = 256;
+
+// reused so hashing an output does not allocate
+std::vector<std::uint8_t>& element(const gs::output& o)
+{
+    thread_local std::vector<std::uint8_t> buf;
+    buf.resize(32 + 4 + 8 + o.scriptpubkey.v.size());
+
+    std::uint8_t* it = buf.data();
+    std::copy(o.prev_tx_id.v.begin(), o.prev_tx_id.v.end(), it);
+    std::memcpy(it + 32, &o.prev_out_idx, 4);
+    std::memcpy(it + 36, &o.value, 8);
+    std::copy(o.scriptpubkey.v.begin(), o.scriptpubkey.v.end(), it + 44);
+
+    return buf;
+}
+
+}
+
+ecmh::ecmh()
+{
+    secp256k1_multiset_init(secp256k1_context_no_precomp, &ms);
+}
+
+void ecmh::add(const gs::output& o)
+{
+    const std::vector<std::uint8_t>& e = element(o);
+    secp256k1_multiset_add(secp256k1_context_no_precomp, &ms, e.data(), e.size());
+}
+
+void ecmh::remove(const gs::output& o)
+{
+    const std::vector<std::uint8_t>& e = element(o);
+    secp256k1_multiset_remove(secp256k1_context_no_precomp, &ms, e.data(), e.size());
+}
+
+void ecmh::combine(const ecmh& o)
+{
+    secp256k1_multiset_combine(secp256k1_context_no_precomp, &ms, &o.ms);
+}
+
+void ecmh::update(
+    const std::vector<const gs::output*>& added,
+    const std::vector<const gs::output*>& removed,
+    std::size_t threads
+) {
+    const std::size_t total = added.size() + removed.size();
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::max<std::size_t>(1, std::min(threads, total / min_outputs_per_thread));
+
+    // thread t takes every threads-th output of both lists
+    auto run = [&](ecmh& part, const std::size_t t) {
+        for (std::size_t i=t; i<added.size(); i+=threads) {
+            part.add(*added[i]);
+        }
+        for (std::size_t i=t; i<removed.size(); i+=threads) {
+            part.remove(*removed[i]);
+        }
+    };
+
+    if (threads == 1) {
+        run(*this, 0);
+        return;
+    }
+
+    std::vector<ecmh> parts(threads);
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (std::size_t t=0; t<threads; ++t) {
+        workers.emplace_back(run, std::ref(parts[t]), t);
+    }
+    for (std::size_t t=0; t<threads; ++t) {
+        workers[t].join();
+        combine(parts[t]);
+    }
+}
+
+gs::ecmh_hash ecmh::finalize() const
+{
+    gs::ecmh_hash ret;
+    secp256k1_multiset_finalize(secp256k1_context_no_precomp, ret.v.data(), &ms);
+    return ret;
+}
+
+}
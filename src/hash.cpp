@@ -0,0 +1,396 @@
+#include <cstdint>
+#include <cstring>
+#include <gs++/hash.hpp>
+#include <gs++/cpu_features.hpp>
+#include <3rdparty/sha2.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #define GS_HASH_X86
+    #include <immintrin.h>
+#endif
+
+namespace gs {
+
+namespace {
+
+const std::uint32_t sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+const std::uint32_t sha256_round_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline std::uint32_t read_be32(const std::uint8_t * p)
+{
+    return (static_cast<std::uint32_t>(p[0]) << 24)
+         | (static_cast<std::uint32_t>(p[1]) << 16)
+         | (static_cast<std::uint32_t>(p[2]) <<  8)
+         | (static_cast<std::uint32_t>(p[3]) <<  0);
+}
+
+inline void write_be32(std::uint8_t * p, const std::uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >>  8;
+    p[3] = v >>  0;
+}
+
+// messages are hashed as len/64 blocks read in place followed by
+// one or two padded blocks built here, returns the amount of those
+std::size_t sha256_pad_tail(
+    const std::uint8_t * data,
+    const std::size_t len,
+    std::uint8_t tail[128]
+) {
+    const std::size_t rem = len % 64;
+    const std::size_t tail_blocks = rem < 56 ? 1 : 2;
+
+    std::memset(tail, 0, 128);
+    std::memcpy(tail, data + (len - rem), rem);
+    tail[rem] = 0x80;
+
+    const std::uint64_t bits = static_cast<std::uint64_t>(len) << 3;
+    std::uint8_t * len_it = tail + tail_blocks * 64 - 8;
+    write_be32(len_it + 0, bits >> 32);
+    write_be32(len_it + 4, bits & 0xFFFFFFFF);
+
+    return tail_blocks;
+}
+
+// the second round hashes a 32 byte digest which always fits a single block
+void sha256_digest_block(const std::uint8_t digest[32], std::uint8_t block[64])
+{
+    std::memset(block, 0, 64);
+    std::memcpy(block, digest, 32);
+    block[32] = 0x80;
+    block[62] = 0x01; // 256 bits
+}
+
+void sha256d_generic(const std::uint8_t * data, const std::size_t len, std::uint8_t * out)
+{
+    sha256(data, len, out);
+    sha256(out, 32, out);
+}
+
+#ifdef GS_HASH_X86
+
+const bool cpu_has_shani = gs::cpu().shani;
+const bool cpu_has_avx2  = gs::cpu().avx2;
+
+// state is h0..h7, processes count consecutive 64 byte blocks
+__attribute__((target("sha,ssse3,sse4.1")))
+void sha256_transform_shani(
+    std::uint32_t state[8],
+    const std::uint8_t * data,
+    std::size_t count
+) {
+    const __m128i BSWAP = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 0));
+    __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+    tmp    = _mm_shuffle_epi32(tmp, 0xB1);          // CDAB
+    state1 = _mm_shuffle_epi32(state1, 0x1B);       // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);    // CDGH
+
+    for (; count > 0; --count, data += 64) {
+        const __m128i abef_save = state0;
+        const __m128i cdgh_save = state1;
+
+        __m128i w[4];
+        for (int i=0; i<4; ++i) {
+            w[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i*16)), BSWAP);
+        }
+
+        for (int i=0; i<16; ++i) {
+            if (i >= 4) {
+                // w[i&3] holds words i-4, the others i-3, i-2 and i-1
+                __m128i t = _mm_sha256msg1_epu32(w[i&3], w[(i+1)&3]);
+                t = _mm_add_epi32(t, _mm_alignr_epi8(w[(i+3)&3], w[(i+2)&3], 4));
+                w[i&3] = _mm_sha256msg2_epu32(t, w[(i+3)&3]);
+            }
+
+            __m128i msg = _mm_add_epi32(w[i&3], _mm_loadu_si128(reinterpret_cast<const __m128i*>(sha256_round_k + i*4)));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            msg    = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        }
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    tmp    = _mm_shuffle_epi32(state0, 0x1B);       // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);       // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);    // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);       // ABEF
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 0), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+}
+
+void sha256d_shani(const std::uint8_t * data, const std::size_t len, std::uint8_t * out)
+{
+    std::uint32_t state[8];
+    std::memcpy(state, sha256_iv, sizeof(state));
+
+    std::uint8_t tail[128];
+    const std::size_t tail_blocks = sha256_pad_tail(data, len, tail);
+    sha256_transform_shani(state, data, len / 64);
+    sha256_transform_shani(state, tail, tail_blocks);
+
+    std::uint8_t digest[32];
+    for (int i=0; i<8; ++i) {
+        write_be32(digest + i*4, state[i]);
+    }
+
+    std::uint8_t block[64];
+    sha256_digest_block(digest, block);
+    std::memcpy(state, sha256_iv, sizeof(state));
+    sha256_transform_shani(state, block, 1);
+
+    for (int i=0; i<8; ++i) {
+        write_be32(out + i*4, state[i]);
+    }
+}
+
+#define GS_AVX2 __attribute__((target("avx2")))
+
+GS_AVX2 inline __m256i avx2_rotr(const __m256i x, const int n)
+{
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+// one block for each of 8 messages, s[j] lane l holds word j of message l
+// only lanes set in active are updated
+GS_AVX2 void sha256_transform_avx2(
+    __m256i s[8],
+    const std::uint8_t * const blocks[8],
+    const __m256i active
+) {
+    __m256i w[16];
+    for (int t=0; t<16; ++t) {
+        w[t] = _mm256_set_epi32(
+            read_be32(blocks[7] + t*4), read_be32(blocks[6] + t*4),
+            read_be32(blocks[5] + t*4), read_be32(blocks[4] + t*4),
+            read_be32(blocks[3] + t*4), read_be32(blocks[2] + t*4),
+            read_be32(blocks[1] + t*4), read_be32(blocks[0] + t*4)
+        );
+    }
+
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+    __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (int t=0; t<64; ++t) {
+        if (t >= 16) {
+            const __m256i w15 = w[(t-15) & 15];
+            const __m256i w2  = w[(t-2)  & 15];
+            const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(avx2_rotr(w15, 7), avx2_rotr(w15, 18)), _mm256_srli_epi32(w15, 3));
+            const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(avx2_rotr(w2, 17), avx2_rotr(w2, 19)), _mm256_srli_epi32(w2, 10));
+            w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t-7) & 15], s1));
+        }
+
+        const __m256i sum1 = _mm256_xor_si256(_mm256_xor_si256(avx2_rotr(e, 6), avx2_rotr(e, 11)), avx2_rotr(e, 25));
+        const __m256i ch   = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        const __m256i t1   = _mm256_add_epi32(
+            _mm256_add_epi32(_mm256_add_epi32(h, sum1), _mm256_add_epi32(ch, _mm256_set1_epi32(sha256_round_k[t]))),
+            w[t & 15]
+        );
+        const __m256i sum0 = _mm256_xor_si256(_mm256_xor_si256(avx2_rotr(a, 2), avx2_rotr(a, 13)), avx2_rotr(a, 22));
+        const __m256i maj  = _mm256_xor_si256(_mm256_xor_si256(_mm256_and_si256(a, b), _mm256_and_si256(a, c)), _mm256_and_si256(b, c));
+        const __m256i t2   = _mm256_add_epi32(sum0, maj);
+
+        h = g; g = f; f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c; c = b; b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+
+    const __m256i v[8] = { a, b, c, d, e, f, g, h };
+    for (int j=0; j<8; ++j) {
+        s[j] = _mm256_blendv_epi8(s[j], _mm256_add_epi32(s[j], v[j]), active);
+    }
+}
+
+GS_AVX2 void sha256_init_avx2(__m256i s[8])
+{
+    for (int j=0; j<8; ++j) {
+        s[j] = _mm256_set1_epi32(sha256_iv[j]);
+    }
+}
+
+GS_AVX2 void sha256_store_avx2(const __m256i s[8], std::uint8_t out[8][32])
+{
+    alignas(32) std::uint32_t words[8][8]; // [word][lane]
+    for (int j=0; j<8; ++j) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(words[j]), s[j]);
+    }
+
+    for (int l=0; l<8; ++l) {
+        for (int j=0; j<8; ++j) {
+            write_be32(out[l] + j*4, words[j][l]);
+        }
+    }
+}
+
+// exactly 8 messages, messages of different lengths run in lockstep
+// with finished lanes masked out
+GS_AVX2 void sha256d_8way_avx2(
+    const std::uint8_t * const * datas,
+    const std::size_t * lens,
+    std::uint8_t * out
+) {
+    static const std::uint8_t zero_block[64] = { 0 };
+
+    std::uint8_t tails[8][128];
+    std::size_t full_blocks[8];
+    std::size_t total_blocks[8];
+    std::size_t max_blocks = 0;
+    for (int l=0; l<8; ++l) {
+        full_blocks[l]  = lens[l] / 64;
+        total_blocks[l] = full_blocks[l] + sha256_pad_tail(datas[l], lens[l], tails[l]);
+        if (total_blocks[l] > max_blocks) {
+            max_blocks = total_blocks[l];
+        }
+    }
+
+    __m256i s[8];
+    sha256_init_avx2(s);
+
+    for (std::size_t i=0; i<max_blocks; ++i) {
+        const std::uint8_t * blocks[8];
+        alignas(32) std::int32_t mask[8];
+        for (int l=0; l<8; ++l) {
+            mask[l] = i < total_blocks[l] ? -1 : 0;
+            blocks[l] = i < full_blocks[l]  ? datas[l] + i*64
+                      : i < total_blocks[l] ? tails[l] + (i - full_blocks[l])*64
+                      : zero_block;
+        }
+        sha256_transform_avx2(s, blocks, _mm256_load_si256(reinterpret_cast<const __m256i*>(mask)));
+    }
+
+    std::uint8_t digests[8][32];
+    sha256_store_avx2(s, digests);
+
+    std::uint8_t second[8][64];
+    const std::uint8_t * blocks[8];
+    for (int l=0; l<8; ++l) {
+        sha256_digest_block(digests[l], second[l]);
+        blocks[l] = second[l];
+    }
+
+    sha256_init_avx2(s);
+    sha256_transform_avx2(s, blocks, _mm256_set1_epi32(-1));
+    sha256_store_avx2(s, digests);
+
+    for (int l=0; l<8; ++l) {
+        std::memcpy(out + l*32, digests[l], 32);
+    }
+}
+
+#undef GS_AVX2
+
+#endif
+
+}
+
+bool sha256_supported(const sha256_impl impl)
+{
+    switch (impl) {
+        case sha256_impl::generic: return true;
+#ifdef GS_HASH_X86
+        case sha256_impl::shani:   return cpu_has_shani;
+        case sha256_impl::avx2:    return cpu_has_avx2;
+#endif
+        default: return false;
+    }
+}
+
+sha256_impl sha256_detect()
+{
+    if (sha256_supported(sha256_impl::shani)) {
+        return sha256_impl::shani;
+    }
+
+    return sha256_impl::generic;
+}
+
+const char * sha256_impl_name(const sha256_impl impl)
+{
+    switch (impl) {
+        case sha256_impl::generic: return "generic";
+        case sha256_impl::shani:   return "shani";
+        case sha256_impl::avx2:    return "avx2";
+        default: return "unknown";
+    }
+}
+
+void sha256d(
+    const std::uint8_t * data,
+    const std::size_t len,
+    std::uint8_t * out
+) {
+#ifdef GS_HASH_X86
+    if (cpu_has_shani) {
+        sha256d_shani(data, len, out);
+        return;
+    }
+#endif
+
+    sha256d_generic(data, len, out);
+}
+
+void sha256d_many(
+    const std::uint8_t * const * datas,
+    const std::size_t * lens,
+    const std::size_t count,
+    std::uint8_t * out
+) {
+    // a single sha-ni stream beats 8 avx2 lanes
+    const sha256_impl impl = sha256_supported(sha256_impl::shani) ? sha256_impl::shani
+                           : sha256_supported(sha256_impl::avx2)  ? sha256_impl::avx2
+                           : sha256_impl::generic;
+
+    sha256d_many(datas, lens, count, out, impl);
+}
+
+void sha256d_many(
+    const std::uint8_t * const * datas,
+    const std::size_t * lens,
+    const std::size_t count,
+    std::uint8_t * out,
+    const sha256_impl impl
+) {
+    std::size_t i = 0;
+
+#ifdef GS_HASH_X86
+    if (impl == sha256_impl::avx2) {
+        for (; i+8 <= count; i+=8) {
+            sha256d_8way_avx2(datas + i, lens + i, out + i*32);
+        }
+    }
+
+    if (impl == sha256_impl::shani) {
+        for (; i<count; ++i) {
+            sha256d_shani(datas[i], lens[i], out + i*32);
+        }
+    }
+#endif
+
+    // generic, and the remainder which did not fill all avx2 lanes
+    for (; i<count; ++i) {
+        sha256d_generic(datas[i], lens[i], out + i*32);
+    }
+}
+
+}
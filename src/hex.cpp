@@ -0,0 +1,211 @@
+#include <cstdint>
+#include <gs++/hex.hpp>
+#include <gs++/cpu_features.hpp>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #define GS_HEX_X86
+    #include <immintrin.h>
+#endif
+
+namespace gs {
+
+namespace {
+
+// 0xFF marks characters which are not hex
+struct hex_table_init
+{
+    std::uint8_t v[256];
+
+    hex_table_init()
+    {
+        for (unsigned i=0; i<256; ++i) {
+            v[i] = 0xFF;
+        }
+        for (unsigned i=0; i<10; ++i) {
+            v['0'+i] = i;
+        }
+        for (unsigned i=0; i<6; ++i) {
+            v['a'+i] = 10+i;
+            v['A'+i] = 10+i;
+        }
+    }
+} hex_table;
+
+bool hex_decode_generic(const char * in, const std::size_t len, std::uint8_t * out)
+{
+    for (std::size_t i=0; i<len; i+=2) {
+        const std::uint8_t hi = hex_table.v[static_cast<std::uint8_t>(in[i+0])];
+        const std::uint8_t lo = hex_table.v[static_cast<std::uint8_t>(in[i+1])];
+        if ((hi | lo) == 0xFF) {
+            return false;
+        }
+
+        *out++ = (hi << 4) | lo;
+    }
+
+    return true;
+}
+
+#ifdef GS_HEX_X86
+
+const bool cpu_has_ssse3 = gs::cpu().ssse3;
+const bool cpu_has_avx2  = gs::cpu().avx2;
+
+// turns characters into nibble values, valid gets 0xFF in lanes which were hex
+// digits are checked before folding case, as folding maps 0x10-0x19 onto '0'-'9'
+__attribute__((target("ssse3")))
+inline __m128i hex_nibbles_ssse3(const __m128i c, __m128i & valid)
+{
+    const __m128i digit   = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    const __m128i alpha   = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    const __m128i isdigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    const __m128i isalpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+
+    valid = _mm_or_si128(isdigit, isalpha);
+    return _mm_or_si128(
+        _mm_and_si128(isdigit, digit),
+        _mm_andnot_si128(isdigit, _mm_add_epi8(alpha, _mm_set1_epi8(10)))
+    );
+}
+
+__attribute__((target("ssse3")))
+std::size_t hex_decode_ssse3(const char * in, const std::size_t len, std::uint8_t * out, bool & ok)
+{
+    // adjacent nibbles become hi*16 + lo
+    const __m128i weights = _mm_set1_epi16(0x0110);
+
+    std::size_t i = 0;
+    for (; i+32 <= len; i+=32) {
+        __m128i v0, v1;
+        const __m128i n0 = hex_nibbles_ssse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)),      v0);
+        const __m128i n1 = hex_nibbles_ssse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 16)), v1);
+
+        if (_mm_movemask_epi8(_mm_and_si128(v0, v1)) != 0xFFFF) {
+            ok = false;
+            return i;
+        }
+
+        const __m128i bytes = _mm_packus_epi16(
+            _mm_maddubs_epi16(n0, weights),
+            _mm_maddubs_epi16(n1, weights)
+        );
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i/2), bytes);
+    }
+
+    ok = true;
+    return i;
+}
+
+__attribute__((target("avx2")))
+inline __m256i hex_nibbles_avx2(const __m256i c, __m256i & valid)
+{
+    const __m256i digit   = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+    const __m256i alpha   = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    const __m256i isdigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    const __m256i isalpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8(5)), alpha);
+
+    valid = _mm256_or_si256(isdigit, isalpha);
+    return _mm256_blendv_epi8(_mm256_add_epi8(alpha, _mm256_set1_epi8(10)), digit, isdigit);
+}
+
+__attribute__((target("avx2")))
+std::size_t hex_decode_avx2(const char * in, const std::size_t len, std::uint8_t * out, bool & ok)
+{
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+
+    std::size_t i = 0;
+    for (; i+64 <= len; i+=64) {
+        __m256i v0, v1;
+        const __m256i n0 = hex_nibbles_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)),      v0);
+        const __m256i n1 = hex_nibbles_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 32)), v1);
+
+        if (_mm256_movemask_epi8(_mm256_and_si256(v0, v1)) != -1) {
+            ok = false;
+            return i;
+        }
+
+        // packus works within 128 bit lanes, so put the quadwords back in order
+        const __m256i bytes = _mm256_permute4x64_epi64(
+            _mm256_packus_epi16(
+                _mm256_maddubs_epi16(n0, weights),
+                _mm256_maddubs_epi16(n1, weights)
+            ),
+            0xD8
+        );
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i/2), bytes);
+    }
+
+    ok = true;
+    return i;
+}
+
+
+#endif
+
+}
+
+bool hex_supported(const hex_impl impl)
+{
+    switch (impl) {
+        case hex_impl::generic: return true;
+#ifdef GS_HEX_X86
+        case hex_impl::ssse3:   return cpu_has_ssse3;
+        case hex_impl::avx2:    return cpu_has_avx2;
+#endif
+        default: return false;
+    }
+}
+
+const char * hex_impl_name(const hex_impl impl)
+{
+    switch (impl) {
+        case hex_impl::generic: return "generic";
+        case hex_impl::ssse3:   return "ssse3";
+        case hex_impl::avx2:    return "avx2";
+        default: return "unknown";
+    }
+}
+
+bool hex_decode(
+    const char * in,
+    const std::size_t len,
+    std::uint8_t * out
+) {
+    const hex_impl impl = hex_supported(hex_impl::avx2)  ? hex_impl::avx2
+                        : hex_supported(hex_impl::ssse3) ? hex_impl::ssse3
+                        : hex_impl::generic;
+
+    return hex_decode(in, len, out, impl);
+}
+
+bool hex_decode(
+    const char * in,
+    const std::size_t len,
+    std::uint8_t * out,
+    const hex_impl impl
+) {
+    if (len % 2 != 0) {
+        return false;
+    }
+
+    std::size_t i = 0;
+
+#ifdef GS_HEX_X86
+    bool ok = true;
+    if (impl == hex_impl::avx2) {
+        i = hex_decode_avx2(in, len, out, ok);
+    }
+    else if (impl == hex_impl::ssse3) {
+        i = hex_decode_ssse3(in, len, out, ok);
+    }
+
+    if (! ok) {
+        return false;
+    }
+#endif
+
+    // generic, and the tail which did not fill a whole vector
+    return hex_decode_generic(in + i, len - i, out + i/2);
+}
+
+}
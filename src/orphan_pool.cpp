@@ -0,0 +1,126 @@
+#include <vector>
+#include <cstdint>
+#include <absl/container/flat_hash_map.h>
+#include <absl/container/flat_hash_set.h>
+#include <gs++/orphan_pool.hpp>
+#include <gs++/transaction.hpp>
+#include <gs++/bhash.hpp>
+
+namespace gs {
+
+bool orphan_pool::add(
+    const gs::transaction& tx,
+    const std::vector<gs::txid>& missing_parents,
+    const std::uint64_t added
+) {
+    if (max_size == 0 || missing_parents.empty() || has(tx.txid)) {
+        return false;
+    }
+
+    while (orphans.size() >= max_size && ! arrival.empty()) {
+        const auto oldest = arrival.front();
+        arrival.pop_front();
+
+        auto search = orphans.find(oldest.second);
+        if (search != orphans.end() && search->second.added == oldest.first) {
+            remove(oldest.second);
+        }
+    }
+
+    orphan o;
+    o.tx              = tx;
+    o.missing_parents = missing_parents;
+    o.added           = added;
+    orphans.insert({ tx.txid, o });
+
+    for (const gs::txid & parent : missing_parents) {
+        by_parent[parent].insert(tx.txid);
+    }
+
+    arrival.emplace_back(added, tx.txid);
+
+    return true;
+}
+
+bool orphan_pool::has(const gs::txid& txid) const
+{
+    return orphans.count(txid) == 1;
+}
+
+bool orphan_pool::remove(const gs::txid& txid)
+{
+    auto search = orphans.find(txid);
+    if (search == orphans.end()) {
+        return false;
+    }
+
+    for (const gs::txid & parent : search->second.missing_parents) {
+        auto parent_search = by_parent.find(parent);
+        if (parent_search == by_parent.end()) {
+            continue;
+        }
+
+        parent_search->second.erase(txid);
+        if (parent_search->second.empty()) {
+            by_parent.erase(parent_search);
+        }
+    }
+
+    orphans.erase(search);
+
+    return true;
+}
+
+std::vector<gs::transaction> orphan_pool::take_children(const gs::txid& parent)
+{
+    std::vector<gs::transaction> ret;
+
+    auto parent_search = by_parent.find(parent);
+    if (parent_search == by_parent.end()) {
+        return ret;
+    }
+
+    // copy because remove modifies by_parent
+    const std::vector<gs::txid> children(
+        parent_search->second.begin(),
+        parent_search->second.end()
+    );
+
+    ret.reserve(children.size());
+    for (const gs::txid & child : children) {
+        auto search = orphans.find(child);
+        if (search == orphans.end()) {
+            continue;
+        }
+
+        ret.push_back(search->second.tx);
+        remove(child);
+    }
+
+    return ret;
+}
+
+std::size_t orphan_pool::expire(const std::uint64_t now)
+{
+    std::size_t ret = 0;
+
+    while (! arrival.empty() && arrival.front().first + expiry <= now) {
+        const auto oldest = arrival.front();
+        arrival.pop_front();
+
+        auto search = orphans.find(oldest.second);
+        if (search != orphans.end() && search->second.added == oldest.first) {
+            remove(oldest.second);
+            ++ret;
+        }
+    }
+
+    return ret;
+}
+
+std::size_t orphan_pool::size() const
+{
+    return orphans.size();
+}
+
+}
@@ -0,0 +1,104 @@
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+#include <gs++/reorg_journal.hpp>
+#include <gs++/bhash.hpp>
+#include <gs++/output.hpp>
+#include <gs++/txgraph.hpp>
+#include <gs++/slp_validator.hpp>
+
+namespace gs {
+
+void reorg_journal::connect(const std::uint32_t height, const gs::blockhash& hash)
+{
+    if (depth == 0) {
+        return;
+    }
+
+    // a block after a gap can not be rolled back to the blocks before it
+    if (! blocks.empty() && blocks.back().height + 1 != height) {
+        blocks.clear();
+    }
+
+    blocks.emplace_back();
+    blocks.back().height = height;
+    blocks.back().hash   = hash;
+
+    while (blocks.size() > depth) {
+        blocks.pop_front();
+    }
+}
+
+void reorg_journal::record_added(const gs::txid& txid)
+{
+    if (blocks.empty()) {
+        return;
+    }
+
+    blocks.back().added.push_back(txid);
+}
+
+void reorg_journal::record_spent(const std::vector<gs::outpoint>& spent)
+{
+    if (blocks.empty()) {
+        return;
+    }
+
+    std::vector<gs::outpoint> & v = blocks.back().spent;
+    v.insert(v.end(), spent.begin(), spent.end());
+}
+
+const block_undo* reorg_journal::find(const gs::blockhash& hash) const
+{
+    for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+        if (it->hash == hash) {
+            return &*it;
+        }
+    }
+
+    return nullptr;
+}
+
+bool reorg_journal::rollback(
+    const gs::blockhash& fork_hash,
+    gs::txgraph& g,
+    gs::slp_validator& validator
+) {
+    if (find(fork_hash) == nullptr) {
+        return false;
+    }
+
+    while (blocks.back().hash != fork_hash) {
+        const block_undo & b = blocks.back();
+
+        // everything inserted after the block was recorded, so no remaining node points at these
+        g.remove_txs(b.added);
+        for (const gs::txid & txid : b.added) {
+            validator.remove_tx(txid);
+        }
+
+        // after removing, outputs of transactions which are gone stay gone
+        for (const gs::outpoint & outpoint : b.spent) {
+            validator.unspend_output(outpoint);
+        }
+
+        blocks.pop_back();
+    }
+
+    return true;
+}
+
+std::size_t reorg_journal::memory_usage() const
+{
+    std::size_t ret = 0;
+    for (const block_undo & b : blocks) {
+        ret += sizeof(block_undo)
+             + b.added.capacity() * sizeof(gs::txid)
+             + b.spent.capacity() * sizeof(gs::outpoint);
+    }
+
+    return ret;
+}
+
+}
@@ -60,6 +60,46 @@ std::pair<bool, std::vector<std::uint8_t>> RpcClient::get_raw_transaction(const
     }
 }   
 
+std::pair<bool, std::vector<gs::blockhash>> RpcClient::get_block_hashes(
+    const std::size_t first_height,
+    const std::size_t last_height
+) {
+    if (RpcClient::rpc_json) {
+        return RpcClient::rpc_json->get_block_hashes(first_height, last_height);
+    }
+
+    std::vector<gs::blockhash> ret;
+    for (std::size_t height=first_height; height<=last_height; ++height) {
+        const std::pair<bool, gs::blockhash> block_hash = RpcClient::rpc_grpc->get_block_hash(height);
+        if (! block_hash.first) {
+            return { false, {} };
+        }
+        ret.push_back(block_hash.second);
+    }
+
+    return { true, ret };
+}
+
+std::pair<bool, std::vector<std::vector<std::uint8_t>>> RpcClient::get_raw_transactions(
+    const std::vector<gs::txid>& txids
+) {
+    if (RpcClient::rpc_json) {
+        return RpcClient::rpc_json->get_raw_transactions(txids);
+    }
+
+    std::vector<std::vector<std::uint8_t>> ret;
+    ret.reserve(txids.size());
+    for (const gs::txid & txid : txids) {
+        std::pair<bool, std::vector<std::uint8_t>> txdata = RpcClient::rpc_grpc->get_raw_transaction(txid);
+        if (! txdata.first) {
+            return { false, {} };
+        }
+        ret.push_back(std::move(txdata.second));
+    }
+
+    return { true, ret };
+}
+
 int RpcClient::subscribe_raw_transactions(std::function<void (std::string txn)> callback) {
     return RpcClient::rpc_grpc->subscribe_raw_transactions(callback);
 }
@@ -3,14 +3,56 @@
 #include <memory>
 #include <cassert>
 #include <iostream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 #include <httplib/httplib.h>
 #include <nlohmann/json.hpp>
 #include <gs++/util.hpp>
+#include <gs++/hex.hpp>
 #include <gs++/bhash.hpp>
 #include <gs++/rpc_json.hpp>
 
 namespace gs {
 
+namespace {
+
+// block and transaction hex is decoded straight out of the response body
+// the json document is only built when the fast path does not understand the reply
+std::pair<bool, std::vector<std::uint8_t>> decode_hex_result(const std::string& body)
+{
+    const std::pair<bool, std::pair<std::size_t, std::size_t>> result {
+        gs::util::json_rpc_result_string(body)
+    };
+    if (result.first) {
+        std::vector<std::uint8_t> ret(result.second.second / 2);
+        if (gs::hex_decode(body.data() + result.second.first, result.second.second, ret.data())) {
+            return { true, std::move(ret) };
+        }
+    }
+
+    auto jbody = nlohmann::json::parse(body);
+
+    if (jbody.size() == 0) {
+        return { false, {} };
+    }
+    if (! jbody[0]["error"].is_null()) {
+        std::cerr << jbody[0]["error"] << "\n";
+        return { false, {} };
+    }
+
+    const std::string hex_str = jbody[0]["result"].get<std::string>();
+    std::vector<std::uint8_t> ret(hex_str.size() / 2);
+    if (! gs::hex_decode(hex_str.data(), hex_str.size(), ret.data())) {
+        std::cerr << "result is not hex\n";
+        return { false, {} };
+    }
+
+    return { true, std::move(ret) };
+}
+
+}
+
 std::shared_ptr<httplib::Response> rpc::query(
     const std::string & method,
     const nlohmann::json & params
@@ -30,6 +72,159 @@ std::shared_ptr<httplib::Response> rpc::query(
     );
 }
 
+std::pair<bool, std::vector<std::pair<bool, nlohmann::json>>> rpc::batch_query(
+    const std::string & method,
+    const std::vector<nlohmann::json> & params_list
+) {
+    std::vector<std::pair<bool, nlohmann::json>> results(params_list.size(), { false, nullptr });
+    if (params_list.empty()) {
+        return { true, std::move(results) };
+    }
+
+    const std::size_t per_request   = std::max<std::size_t>(1, batch_size);
+    const std::size_t request_count = (params_list.size() + per_request - 1) / per_request;
+    const std::size_t worker_count  = std::min(pool.size(), request_count);
+
+    // each worker sends every worker_count'th request through its pooled client
+    // the connection is kept alive for all of a worker's requests in this call
+    // ids are indexes into params_list so replies can come back in any order
+    std::atomic<bool> success { true };
+    auto send_requests = [&](const std::size_t offset) {
+        std::vector<httplib::Request> requests;
+        for (std::size_t r=offset; r<request_count; r+=worker_count) {
+            nlohmann::json batch = nlohmann::json::array();
+            const std::size_t end = std::min(params_list.size(), (r+1) * per_request);
+            for (std::size_t i=r*per_request; i<end; ++i) {
+                batch.push_back({
+                    { "jsonrpc", "2.0" },
+                    { "method", method },
+                    { "params", params_list[i] },
+                    { "id", i }
+                });
+            }
+
+            httplib::Request req;
+            req.method = "POST";
+            req.path   = "/";
+            req.headers.insert(httplib::make_basic_authentication_header(rpc_user, rpc_pass));
+            req.headers.emplace("Content-Type", "application/json-rpc");
+            req.body   = batch.dump();
+            requests.push_back(std::move(req));
+        }
+
+        std::vector<httplib::Response> responses;
+        if (! pool[offset].send(requests, responses) || responses.size() != requests.size()) {
+            success = false;
+            return;
+        }
+
+        for (const httplib::Response & res : responses) {
+            if (res.status != 200) {
+                success = false;
+                return;
+            }
+
+            const nlohmann::json jbody = nlohmann::json::parse(res.body, nullptr, false);
+            if (! jbody.is_array()) {
+                success = false;
+                return;
+            }
+
+            for (const nlohmann::json & reply : jbody) {
+                if (! reply.contains("id") || ! reply["id"].is_number_unsigned()
+                 || reply["id"].get<std::size_t>() >= results.size()
+                ) {
+                    success = false;
+                    return;
+                }
+
+                const std::size_t id = reply["id"].get<std::size_t>();
+                const auto error  = reply.find("error");
+                const auto result = reply.find("result");
+                if ((error == reply.end() || error->is_null()) && result != reply.end()) {
+                    results[id] = { true, *result };
+                } else {
+                    results[id] = { false, error != reply.end() ? *error : nlohmann::json(nullptr) };
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t t=1; t<worker_count; ++t) {
+        workers.emplace_back(send_requests, t);
+    }
+    send_requests(0);
+    for (auto & w : workers) {
+        w.join();
+    }
+
+    return { success, std::move(results) };
+}
+
+std::pair<bool, std::vector<gs::blockhash>> rpc::get_block_hashes(
+    const std::size_t first_height,
+    const std::size_t last_height
+) {
+    std::vector<nlohmann::json> params_list;
+    for (std::size_t height=first_height; height<=last_height; ++height) {
+        params_list.push_back(nlohmann::json::array({ height }));
+    }
+
+    const auto replies = batch_query("getblockhash", params_list);
+    if (! replies.first) {
+        return { false, {} };
+    }
+
+    std::vector<gs::blockhash> ret;
+    ret.reserve(replies.second.size());
+    for (const std::pair<bool, nlohmann::json> & reply : replies.second) {
+        if (! reply.first || ! reply.second.is_string()) {
+            std::cerr << reply.second << "\n";
+            return { false, {} };
+        }
+
+        ret.emplace_back(reply.second.get<std::string>());
+    }
+
+    return { true, ret };
+}
+
+std::pair<bool, std::vector<std::vector<std::uint8_t>>> rpc::get_raw_transactions(
+    const std::vector<gs::txid>& txids
+) {
+    std::vector<nlohmann::json> params_list;
+    params_list.reserve(txids.size());
+    for (const gs::txid & txid : txids) {
+        params_list.push_back(nlohmann::json::array({ txid.decompress(true), 0 }));
+    }
+
+    const auto replies = batch_query("getrawtransaction", params_list);
+    if (! replies.first) {
+        return { false, {} };
+    }
+
+    std::vector<std::vector<std::uint8_t>> ret;
+    ret.reserve(replies.second.size());
+    for (const std::pair<bool, nlohmann::json> & reply : replies.second) {
+        if (! reply.first || ! reply.second.is_string()) {
+            std::cerr << reply.second << "\n";
+            return { false, {} };
+        }
+
+        const std::string & hex_str = reply.second.get_ref<const std::string&>();
+        std::vector<std::uint8_t> txdata(hex_str.size() / 2);
+        if (! gs::hex_decode(hex_str.data(), hex_str.size(), txdata.data())) {
+            std::cerr << "result is not hex\n";
+            return { false, {} };
+        }
+
+        ret.push_back(std::move(txdata));
+    }
+
+    return { true, std::move(ret) };
+}
+
 std::pair<bool, gs::blockhash> rpc::get_block_hash(const std::size_t height)
 {
     std::shared_ptr<httplib::Response> res = query("getblockhash", nlohmann::json::array({ height }));
@@ -59,8 +254,6 @@ std::pair<bool, gs::blockhash> rpc::get_block_hash(const std::size_t height)
 std::pair<bool, std::vector<std::uint8_t>> rpc::get_raw_block(
     const gs::blockhash& block_hash
 ) {
-    std::string block_data_str;
-
     std::shared_ptr<httplib::Response> res = query("getblock",
         nlohmann::json::array({ block_hash.decompress(false), 0 })
     );
@@ -72,20 +265,7 @@ std::pair<bool, std::vector<std::uint8_t>> rpc::get_raw_block(
         return { false, {} };
     }
 
-    auto jbody = nlohmann::json::parse(res->body);
-    // std::cout << jbody << std::endl;
-
-    if (jbody.size() == 0) {
-        return { false, {} };
-    }
-    if (! jbody[0]["error"].is_null()) {
-        std::cerr << jbody[0]["error"] << "\n";
-        return { false, {} };
-    }
-
-    block_data_str = jbody[0]["result"].get<std::string>();
-
-    return { true, gs::util::unhex(block_data_str) };
+    return decode_hex_result(res->body);
 }
 
 std::pair<bool, std::uint32_t> rpc::get_best_block_height()
@@ -185,21 +365,7 @@ std::pair<bool, std::vector<std::uint8_t>> rpc::get_raw_transaction(const gs::tx
         return { false, {} };
     }
 
-    // std::cout << res->body << std::endl;
-    auto jbody = nlohmann::json::parse(res->body);
-
-    if (jbody.size() == 0) {
-        return { false, {} };
-    }
-
-    if (! jbody[0]["error"].is_null()) {
-        std::cerr << jbody[0]["error"] << "\n";
-        return { false, {} };
-    }
-
-    std::vector<std::uint8_t> ret = gs::util::unhex(jbody[0]["result"].get<std::string>());
-
-    return { true, ret };
+    return decode_hex_result(res->body);
 }
 
 }
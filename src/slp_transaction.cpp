@@ -1,4 +1,6 @@
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 #include <absl/types/variant.h>
 #include <gs++/slp_transaction.hpp>
 
@@ -87,6 +89,278 @@ slp_transaction::slp_transaction(const gs::scriptpubkey& scriptpubkey)
     hydrate(scriptpubkey);
 }
 
+namespace {
+
+// pushdata chunk pointing into the script being parsed
+struct slp_chunk
+{
+    const std::uint8_t * data;
+    std::size_t          len;
+};
+
+// lokad id, token_type, action, tokenid and 19 amounts
+// scripts with more chunks than this can never be valid
+constexpr std::size_t max_slp_chunks = 23;
+
+// slp encodes all numbers big endian
+std::uint64_t chunk_to_number(const slp_chunk& c)
+{
+    std::uint64_t ret = 0;
+    for (std::size_t i=0; i<c.len; ++i) {
+        ret = (ret << 8) | c.data[i];
+    }
+
+    return ret;
+}
+
+bool chunk_to_tokenid(const slp_chunk& c, gs::tokenid& tokenid)
+{
+    if (c.len != tokenid.v.size()) {
+        return false;
+    }
+
+    std::reverse_copy(c.data, c.data + c.len, tokenid.v.begin());
+    return true;
+}
+
+std::string chunk_to_string(const slp_chunk& c)
+{
+    return std::string(reinterpret_cast<const char*>(c.data), c.len);
+}
+
+slp_transaction_type chunk_to_action_type(const slp_chunk& c)
+{
+    switch (c.len) {
+        case 7:
+            if (c.data[0] == 'G' && std::memcmp(c.data, "GENESIS", 7) == 0) {
+                return slp_transaction_type::genesis;
+            }
+            break;
+        case 4:
+            switch (c.data[0]) {
+                case 'M':
+                    if (std::memcmp(c.data, "MINT", 4) == 0) {
+                        return slp_transaction_type::mint;
+                    }
+                    break;
+                case 'S':
+                    if (std::memcmp(c.data, "SEND", 4) == 0) {
+                        return slp_transaction_type::send;
+                    }
+                    break;
+            }
+            break;
+    }
+
+    return slp_transaction_type::invalid;
+}
+
+}
+
+// must accept and reject exactly what hydrate_reference does
+bool slp_transaction::hydrate(const std::uint8_t * begin, const std::uint8_t * end)
+{
+    auto fail = [this]() -> bool {
+        this->type   = slp_transaction_type::invalid;
+        this->slp_tx = slp_transaction_invalid{};
+        return false;
+    };
+
+    // TODO what is correct minimum size?
+    if (end - begin < 10 || begin[0] != 0x6A) {
+        return fail();
+    }
+
+    slp_chunk chunks[max_slp_chunks];
+    std::size_t chunk_count = 0;
+
+    const std::uint8_t * it = begin + 1;
+    while (it != end) {
+        const std::uint8_t opcode = *it++;
+        const std::size_t remaining = end - it;
+
+        std::size_t len = 0;
+        if (opcode > 0x00 && opcode < 0x4C) {
+            len = opcode;
+        }
+        else if (opcode == 0x4C && remaining > 1) {
+            len = it[0];
+            it += 1;
+        }
+        else if (opcode == 0x4D && remaining > 2) {
+            len = static_cast<std::size_t>(it[0])
+               | (static_cast<std::size_t>(it[1]) << 8);
+            it += 2;
+        }
+        else if (opcode == 0x4E && remaining > 4) {
+            len = static_cast<std::size_t>(it[0])
+               | (static_cast<std::size_t>(it[1]) << 8)
+               | (static_cast<std::size_t>(it[2]) << 16)
+               | (static_cast<std::size_t>(it[3]) << 24);
+            it += 4;
+        }
+        else {
+            // other opcodes not allowed, truncated length
+            return fail();
+        }
+
+        if (len > static_cast<std::size_t>(end - it)) {
+            return fail();
+        }
+
+        if (chunk_count < max_slp_chunks) {
+            chunks[chunk_count] = slp_chunk { it, len };
+        }
+        ++chunk_count;
+        it += len;
+
+        // quick exit optimization
+        if (chunk_count == 1 && (len != 4 || std::memcmp(chunks[0].data, "SLP\0", 4) != 0)) {
+            return fail();
+        }
+    }
+
+    if (chunk_count < 2) {
+        return fail();
+    }
+
+    std::uint16_t token_type = 0;
+    {
+        const slp_chunk& c = chunks[1];
+        if (c.len != 1 && c.len != 2) {
+            return fail();
+        }
+
+        token_type = chunk_to_number(c);
+        if (! (token_type == 1 || token_type == 0x41 || token_type == 0x81)) {
+            return fail();
+        }
+    }
+
+    if (chunk_count < 3) {
+        return fail();
+    }
+    this->token_type = token_type;
+
+    switch (chunk_to_action_type(chunks[2])) {
+        case slp_transaction_type::genesis: {
+            if (chunk_count != 10) {
+                return fail();
+            }
+
+            const slp_chunk& document_hash = chunks[6];
+            if (! (document_hash.len == 0 || document_hash.len == 32)) {
+                return fail();
+            }
+
+            const slp_chunk& decimals_chunk = chunks[7];
+            if (decimals_chunk.len != 1) {
+                return fail();
+            }
+            const std::uint32_t decimals = decimals_chunk.data[0];
+            if (decimals > 9) {
+                return fail();
+            }
+
+            const slp_chunk& mint_baton_chunk = chunks[8];
+            if (mint_baton_chunk.len >= 2) {
+                return fail();
+            }
+            const bool has_mint_baton = mint_baton_chunk.len == 1;
+            const std::uint32_t mint_baton_vout = has_mint_baton ? mint_baton_chunk.data[0] : 0;
+            if (has_mint_baton && mint_baton_vout < 2) {
+                return fail();
+            }
+
+            const slp_chunk& qty_chunk = chunks[9];
+            if (qty_chunk.len != 8) {
+                return fail();
+            }
+            const std::uint64_t qty = chunk_to_number(qty_chunk);
+
+            if (token_type == 0x41) {
+                if (decimals != 0 || mint_baton_vout != 0 || qty != 1) {
+                    return fail();
+                }
+            }
+
+            this->type = slp_transaction_type::genesis;
+            this->slp_tx = slp_transaction_genesis(
+                chunk_to_string(chunks[3]),
+                chunk_to_string(chunks[4]),
+                chunk_to_string(chunks[5]),
+                chunk_to_string(document_hash),
+                decimals,
+                has_mint_baton,
+                mint_baton_vout,
+                qty
+            );
+            return true;
+        }
+        case slp_transaction_type::mint: {
+            if (token_type == 0x41 || chunk_count != 6) {
+                return fail();
+            }
+
+            gs::tokenid tokenid;
+            if (! chunk_to_tokenid(chunks[3], tokenid)) {
+                return fail();
+            }
+
+            const slp_chunk& mint_baton_chunk = chunks[4];
+            if (mint_baton_chunk.len >= 2) {
+                return fail();
+            }
+            const bool has_mint_baton = mint_baton_chunk.len == 1;
+            const std::uint32_t mint_baton_vout = has_mint_baton ? mint_baton_chunk.data[0] : 0;
+            if (has_mint_baton && mint_baton_vout < 2) {
+                return fail();
+            }
+
+            const slp_chunk& qty_chunk = chunks[5];
+            if (qty_chunk.len != 8) {
+                return fail();
+            }
+
+            this->tokenid = tokenid;
+            this->type    = slp_transaction_type::mint;
+            this->slp_tx  = slp_transaction_mint(
+                has_mint_baton,
+                mint_baton_vout,
+                chunk_to_number(qty_chunk)
+            );
+            return true;
+        }
+        case slp_transaction_type::send: {
+            // at least one amount and at most 19
+            if (chunk_count < 5 || chunk_count > max_slp_chunks) {
+                return fail();
+            }
+
+            gs::tokenid tokenid;
+            if (! chunk_to_tokenid(chunks[3], tokenid)) {
+                return fail();
+            }
+
+            std::vector<std::uint64_t> token_amounts;
+            token_amounts.reserve(chunk_count - 4);
+            for (std::size_t i=4; i<chunk_count; ++i) {
+                if (chunks[i].len != 8) {
+                    return fail();
+                }
+                token_amounts.push_back(chunk_to_number(chunks[i]));
+            }
+
+            this->tokenid = tokenid;
+            this->type    = slp_transaction_type::send;
+            this->slp_tx  = slp_transaction_send(token_amounts);
+            return true;
+        }
+        default:
+            return fail();
+    }
+}
+
 }
 
 std::ostream & operator<<(std::ostream &os, const gs::slp_transaction & slp)
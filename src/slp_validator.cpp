@@ -1,6 +1,8 @@
 #include <vector>
 #include <cstdint>
 #include <functional>
+#include <algorithm>
+#include <deque>
 
 #include <absl/types/variant.h>
 #include <absl/container/flat_hash_map.h>
@@ -20,6 +22,9 @@ bool slp_validator::add_tx(const gs::transaction& tx)
         const auto p = transaction_map.insert({ tx.txid, tx });
 
         if (validate(tx.txid)) {
+            if (p.second) {
+                track_outputs(tx);
+            }
             return p.second;
         } else {
             return false;
@@ -29,8 +34,25 @@ bool slp_validator::add_tx(const gs::transaction& tx)
     return false;
 }
 
+bool slp_validator::add_assumed_valid_tx(const gs::transaction& tx)
+{
+    if (tx.slp.type != gs::slp_transaction_type::invalid) {
+        const auto p = transaction_map.insert({ tx.txid, tx });
+        add_valid_txid(tx.txid);
+        if (p.second) {
+            track_outputs(tx);
+        }
+
+        return p.second;
+    }
+
+    return false;
+}
+
 bool slp_validator::remove_tx(const gs::txid& txid)
 {
+    unspent_outputs.erase(txid);
+    valid.erase(txid);
     return transaction_map.erase(txid) > 0;
 }
 
@@ -54,6 +76,97 @@ gs::transaction slp_validator::get(const gs::txid& txid) const
     return transaction_map.at(txid);
 }
 
+void slp_validator::track_outputs(const gs::transaction& tx)
+{
+    if (! pruning) {
+        return;
+    }
+
+    const std::uint32_t baton_vout = tx.mint_baton_outpoint().vout;
+
+    std::vector<std::uint32_t> vouts;
+    for (std::uint32_t vout=1; vout<tx.outputs.size(); ++vout) {
+        if (tx.output_slp_amount(vout) > 0 || vout == baton_vout) {
+            vouts.push_back(vout);
+        }
+    }
+
+    // nothing to spend, we keep these as we have no height to prune them at
+    if (! vouts.empty()) {
+        unspent_outputs[tx.txid] = vouts;
+    }
+}
+
+std::vector<gs::outpoint> slp_validator::spend_inputs(const gs::transaction& tx, const std::uint32_t height)
+{
+    return spend_inputs(tx.inputs, height);
+}
+
+std::vector<gs::outpoint> slp_validator::spend_inputs(const std::vector<gs::outpoint>& inputs, const std::uint32_t height)
+{
+    std::vector<gs::outpoint> spent;
+    if (! pruning) {
+        return spent;
+    }
+
+    for (const gs::outpoint & i_outpoint : inputs) {
+        auto search = unspent_outputs.find(i_outpoint.txid);
+        if (search == unspent_outputs.end()) {
+            continue;
+        }
+
+        std::vector<std::uint32_t> & vouts = search->second;
+        const auto it = std::find(vouts.begin(), vouts.end(), i_outpoint.vout);
+        if (it == vouts.end()) {
+            continue;
+        }
+        vouts.erase(it);
+        spent.push_back(i_outpoint);
+
+        if (vouts.empty()) {
+            fully_spent.emplace_back(height, i_outpoint.txid);
+            unspent_outputs.erase(search);
+        }
+    }
+
+    return spent;
+}
+
+void slp_validator::unspend_output(const gs::outpoint& outpoint)
+{
+    // a fully_spent entry left behind is skipped by prune once this is tracked again
+    if (! pruning || ! has(outpoint.txid)) {
+        return;
+    }
+
+    std::vector<std::uint32_t> & vouts = unspent_outputs[outpoint.txid];
+    if (std::find(vouts.begin(), vouts.end(), outpoint.vout) == vouts.end()) {
+        vouts.push_back(outpoint.vout);
+    }
+}
+
+std::size_t slp_validator::prune(const std::uint32_t max_height)
+{
+    std::size_t ret = 0;
+
+    while (! fully_spent.empty() && fully_spent.front().first <= max_height) {
+        const gs::txid txid = fully_spent.front().second;
+        fully_spent.pop_front();
+
+        // tracked again since, ex: re-added after a reorg
+        if (unspent_outputs.count(txid) > 0) {
+            continue;
+        }
+
+        if (transaction_map.erase(txid) > 0) {
+            valid.erase(txid);
+            ++ret;
+        }
+    }
+
+    return ret;
+}
+
 // #define ENABLE_SLP_VALIDATE_DEBUG_PRINTING
 
 #ifdef ENABLE_SLP_VALIDATE_DEBUG_PRINTING
@@ -251,4 +364,73 @@ bool slp_validator::validate(const gs::txid & txid)
     return is_valid;
 }
 
+std::vector<gs::txid> slp_validator::missing_token_parents(
+    const gs::transaction & tx,
+    const std::function<bool(const gs::outpoint&)> & is_known
+) const {
+    std::vector<gs::txid> ret;
+
+    auto unknown = [&](const gs::outpoint & i_outpoint) {
+        return ! has(i_outpoint.txid) && ! is_known(i_outpoint);
+    };
+    auto push_unknown = [&](const gs::outpoint & i_outpoint) {
+        if (unknown(i_outpoint) && std::find(ret.begin(), ret.end(), i_outpoint.txid) == ret.end()) {
+            ret.push_back(i_outpoint.txid);
+        }
+    };
+
+    switch (tx.slp.type) {
+        case gs::slp_transaction_type::send: {
+            const auto & s = absl::get<gs::slp_transaction_send>(tx.slp.slp_tx);
+
+            absl::uint128 output_amount = 0;
+            for (const auto n : s.amounts) {
+                output_amount += n;
+            }
+
+            // what the inputs we know of bring, if that covers the outputs it failed for another reason
+            absl::uint128 input_amount = 0;
+            for (const auto & i_outpoint : tx.inputs) {
+                if (! has_valid(i_outpoint.txid)) {
+                    push_unknown(i_outpoint);
+                    continue;
+                }
+
+                const gs::transaction & txi = transaction_map.at(i_outpoint.txid);
+                if (txi.slp.token_type == tx.slp.token_type && txi.slp.tokenid == tx.slp.tokenid) {
+                    input_amount += txi.output_slp_amount(i_outpoint.vout);
+                }
+            }
+
+            if (output_amount <= input_amount) {
+                ret.clear();
+            }
+            break;
+        }
+        case gs::slp_transaction_type::mint: {
+            for (const auto & i_outpoint : tx.inputs) {
+                if (has_valid(i_outpoint.txid)) {
+                    const gs::transaction & txi = transaction_map.at(i_outpoint.txid);
+                    if (txi.slp.tokenid == tx.slp.tokenid && i_outpoint == txi.mint_baton_outpoint()) {
+                        return {}; // the baton is there
+                    }
+                }
+                push_unknown(i_outpoint);
+            }
+            break;
+        }
+        case gs::slp_transaction_type::genesis: {
+            // only an nft1 child genesis depends on a parent, its group input
+            if (tx.slp.token_type == 0x41 && ! tx.inputs.empty()) {
+                push_unknown(tx.inputs[0]);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    return ret;
+}
+
 }
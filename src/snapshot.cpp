@@ -0,0 +1,449 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <limits>
+
+#include <boost/crc.hpp>
+#include <boost/thread.hpp>
+#include <absl/container/flat_hash_map.h>
+#include <spdlog/spdlog.h>
+
+#include <gs++/snapshot.hpp>
+#include <gs++/txgraph.hpp>
+#include <gs++/slp_validator.hpp>
+#include <gs++/transaction.hpp>
+#include <gs++/bhash.hpp>
+
+namespace gs {
+
+namespace {
+
+constexpr std::uint32_t snapshot_magic   = 0x4e534753; // "GSSN"
+constexpr std::uint32_t snapshot_version = 1;
+
+// validator entries either point at graph txdata or carry their own
+constexpr std::uint8_t tx_in_graph = 0;
+constexpr std::uint8_t tx_inline   = 1;
+
+struct snapshot_writer
+{
+    int fd;
+    std::vector<std::uint8_t> buf;
+    boost::crc_32_type crc;
+    bool ok;
+
+    snapshot_writer(const int fd)
+    : fd(fd)
+    , ok(true)
+    {
+        buf.reserve(1 << 20);
+    }
+
+    void bytes(const std::uint8_t* data, const std::size_t len)
+    {
+        crc.process_bytes(data, len);
+        buf.insert(buf.end(), data, data + len);
+        if (buf.size() >= (1 << 20)) {
+            flush();
+        }
+    }
+
+    template <typename T>
+    void num(const T v)
+    {
+        std::uint8_t b[sizeof(T)];
+        std::memcpy(b, &v, sizeof(T));
+        bytes(b, sizeof(T));
+    }
+
+    template <typename Tag>
+    void hash(const gs::bhash<Tag>& h)
+    {
+        bytes(h.v.data(), h.v.size());
+    }
+
+    bool flush()
+    {
+        const std::uint8_t* data = buf.data();
+        std::size_t len = buf.size();
+        while (ok && len > 0) {
+            const ssize_t n = ::write(fd, data, len);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            data += n;
+            len  -= static_cast<std::size_t>(n);
+        }
+        buf.clear();
+
+        return ok;
+    }
+};
+
+// every read is bounds checked, ok turns false once the data runs out
+struct snapshot_reader
+{
+    const std::uint8_t* pos;
+    const std::uint8_t* end;
+    bool ok;
+
+    snapshot_reader(const std::uint8_t* begin, const std::uint8_t* end)
+    : pos(begin)
+    , end(end)
+    , ok(true)
+    {}
+
+    const std::uint8_t* bytes(const std::size_t len)
+    {
+        if (! ok || static_cast<std::size_t>(end - pos) < len) {
+            ok = false;
+            return nullptr;
+        }
+
+        const std::uint8_t* ret = pos;
+        pos += len;
+        return ret;
+    }
+
+    template <typename T>
+    T num()
+    {
+        T v = 0;
+        const std::uint8_t* p = bytes(sizeof(T));
+        if (p != nullptr) {
+            std::memcpy(&v, p, sizeof(T));
+        }
+        return v;
+    }
+
+    template <typename Tag>
+    void hash(gs::bhash<Tag>& h)
+    {
+        const std::uint8_t* p = bytes(h.v.size());
+        if (p != nullptr) {
+            std::copy(p, p + h.v.size(), h.v.begin());
+        }
+    }
+
+    // a count can not be larger than the records left in the file
+    std::uint64_t count(const std::size_t min_record_size)
+    {
+        const std::uint64_t n = num<std::uint64_t>();
+        if (n > static_cast<std::uint64_t>(end - pos) / min_record_size) {
+            ok = false;
+            return 0;
+        }
+        return n;
+    }
+};
+
+}
+
+bool save_snapshot(
+    const std::string& path,
+    gs::txgraph& g,
+    const gs::slp_validator& validator,
+    const snapshot_tip& tip
+) {
+    boost::shared_lock<boost::shared_mutex> lock(g.lookup_mtx);
+
+    const std::string tmp_path = path + ".tmp";
+    const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        spdlog::error("snapshot: could not open {}: {}", tmp_path, std::strerror(errno));
+        return false;
+    }
+
+    snapshot_writer w(fd);
+    w.num<std::uint32_t>(snapshot_magic);
+    w.num<std::uint32_t>(snapshot_version);
+    w.num<std::uint32_t>(tip.height);
+    w.hash(tip.hash);
+
+    std::uint64_t node_count = 0;
+    for (const auto & t : g.tokens) {
+        node_count += t.second.graph.size();
+    }
+    w.num<std::uint64_t>(node_count);
+
+    // nodes are numbered in write order, inputs are stored relative to their token
+    absl::flat_hash_map<const gs::graph_node*, std::uint64_t> node_index;
+    node_index.reserve(node_count);
+
+    w.num<std::uint64_t>(g.tokens.size());
+    for (const auto & t : g.tokens) {
+        const std::uint64_t token_base = node_index.size();
+        for (const auto & n : t.second.graph) {
+            node_index.emplace(&n.second, node_index.size());
+        }
+
+        w.hash(t.first);
+        w.num<std::uint64_t>(t.second.graph.size());
+        for (const auto & n : t.second.graph) {
+            w.hash(n.first);
+            w.num<std::uint32_t>(n.second.txdata.size());
+            w.bytes(n.second.txdata.data(), n.second.txdata.size());
+            w.num<std::uint32_t>(n.second.inputs.size());
+            for (const gs::graph_node* input : n.second.inputs) {
+                w.num<std::uint32_t>(node_index[input] - token_base);
+            }
+        }
+    }
+
+    w.num<std::uint64_t>(validator.transaction_map.size());
+    for (const auto & m : validator.transaction_map) {
+        const gs::transaction & tx = m.second;
+        w.hash(m.first);
+
+        const gs::graph_node* node = nullptr;
+        auto token_search = g.txid_to_token.find(m.first);
+        if (token_search != g.txid_to_token.end()) {
+            auto node_search = token_search->second->graph.find(m.first);
+            if (node_search != token_search->second->graph.end()
+             && node_search->second.txdata == tx.serialized
+            ) {
+                node = &node_search->second;
+            }
+        }
+
+        if (node != nullptr) {
+            w.num<std::uint8_t>(tx_in_graph);
+            w.num<std::uint64_t>(node_index[node]);
+        } else {
+            w.num<std::uint8_t>(tx_inline);
+            w.num<std::uint32_t>(tx.serialized.size());
+            w.bytes(tx.serialized.data(), tx.serialized.size());
+        }
+    }
+
+    w.num<std::uint64_t>(validator.valid.size());
+    for (const gs::txid & txid : validator.valid) {
+        w.hash(txid);
+    }
+
+    w.num<std::uint64_t>(validator.unspent_outputs.size());
+    for (const auto & m : validator.unspent_outputs) {
+        w.hash(m.first);
+        w.num<std::uint32_t>(m.second.size());
+        for (const std::uint32_t vout : m.second) {
+            w.num<std::uint32_t>(vout);
+        }
+    }
+
+    w.num<std::uint64_t>(validator.fully_spent.size());
+    for (const auto & m : validator.fully_spent) {
+        w.num<std::uint32_t>(m.first);
+        w.hash(m.second);
+    }
+
+    const std::uint32_t checksum = w.crc.checksum();
+    w.num<std::uint32_t>(checksum);
+    w.flush();
+
+    const bool synced = w.ok && ::fsync(fd) == 0;
+    ::close(fd);
+
+    if (! synced || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        spdlog::error("snapshot: could not write {}: {}", path, std::strerror(errno));
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+std::pair<bool, snapshot_tip> load_snapshot(
+    const std::string& path,
+    gs::txgraph& g,
+    gs::slp_validator& validator
+) {
+    snapshot_tip tip;
+    tip.height = 0;
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return { false, tip };
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < 4) {
+        ::close(fd);
+        spdlog::error("snapshot: {} is truncated", path);
+        return { false, tip };
+    }
+    const std::size_t size = static_cast<std::size_t>(st.st_size);
+
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        spdlog::error("snapshot: mmap failed: {}", std::strerror(errno));
+        return { false, tip };
+    }
+    ::madvise(map, size, MADV_SEQUENTIAL);
+
+    const std::uint8_t* data = static_cast<const std::uint8_t*>(map);
+    struct unmap_guard
+    {
+        void* map;
+        std::size_t size;
+        ~unmap_guard() { ::munmap(map, size); }
+    } guard { map, size };
+
+    boost::crc_32_type crc;
+    crc.process_bytes(data, size - 4);
+    std::uint32_t checksum;
+    std::memcpy(&checksum, data + size - 4, 4);
+    if (crc.checksum() != checksum) {
+        spdlog::error("snapshot: {} fails its checksum", path);
+        return { false, tip };
+    }
+
+    snapshot_reader r(data, data + size - 4);
+    if (r.num<std::uint32_t>() != snapshot_magic || r.num<std::uint32_t>() != snapshot_version) {
+        spdlog::error("snapshot: {} is not a version {} snapshot", path, snapshot_version);
+        return { false, tip };
+    }
+    tip.height = r.num<std::uint32_t>();
+    r.hash(tip.hash);
+
+    boost::lock_guard<boost::shared_mutex> lock(g.lookup_mtx);
+
+    const std::uint64_t node_count = r.count(32 + 4 + 4);
+    g.txid_to_token.reserve(node_count);
+    std::vector<const gs::graph_node*> nodes;
+    nodes.reserve(node_count);
+
+    const std::uint64_t token_count = r.count(32 + 8);
+    for (std::uint64_t t=0; r.ok && t<token_count; ++t) {
+        gs::tokenid tokenid;
+        r.hash(tokenid);
+        gs::token_details & token = g.tokens.emplace(tokenid, tokenid).first->second;
+
+        const std::uint64_t count = r.count(32 + 4 + 4);
+        token.graph.reserve(count);
+
+        // inputs may point at nodes later in the token so they are linked after all are placed
+        std::vector<gs::graph_node*> local;
+        std::vector<std::pair<gs::graph_node*, const std::uint8_t*>> links;
+        local.reserve(count);
+        links.reserve(count);
+
+        for (std::uint64_t i=0; r.ok && i<count; ++i) {
+            gs::txid txid;
+            r.hash(txid);
+            const std::uint32_t txdata_len = r.num<std::uint32_t>();
+            const std::uint8_t* txdata = r.bytes(txdata_len);
+            const std::uint32_t input_count = r.num<std::uint32_t>();
+            const std::uint8_t* inputs = r.bytes(std::size_t(input_count) * 4);
+            if (! r.ok) {
+                break;
+            }
+
+            gs::graph_node & node = token.graph[txid];
+            node.txdata.assign(txdata, txdata + txdata_len);
+            node.inputs.resize(input_count);
+            g.txid_to_token.emplace(txid, &token);
+
+            local.push_back(&node);
+            links.emplace_back(&node, inputs);
+            nodes.push_back(&node);
+        }
+
+        for (auto & l : links) {
+            for (std::size_t i=0; i<l.first->inputs.size(); ++i) {
+                std::uint32_t idx;
+                std::memcpy(&idx, l.second + i * 4, 4);
+                if (idx >= local.size()) {
+                    r.ok = false;
+                    break;
+                }
+                l.first->inputs[i] = local[idx];
+            }
+        }
+    }
+
+    const std::uint64_t tx_count = r.count(32 + 1 + 4);
+    validator.transaction_map.reserve(tx_count);
+    for (std::uint64_t i=0; r.ok && i<tx_count; ++i) {
+        gs::txid txid;
+        r.hash(txid);
+
+        const std::uint8_t* begin = nullptr;
+        const std::uint8_t* end   = nullptr;
+        const std::uint8_t kind = r.num<std::uint8_t>();
+        if (kind == tx_in_graph) {
+            const std::uint64_t idx = r.num<std::uint64_t>();
+            if (idx >= nodes.size()) {
+                r.ok = false;
+                break;
+            }
+            begin = nodes[idx]->txdata.data();
+            end   = begin + nodes[idx]->txdata.size();
+        } else {
+            const std::uint32_t len = r.num<std::uint32_t>();
+            begin = r.bytes(len);
+            end   = begin + len;
+        }
+
+        gs::transaction tx;
+        if (! r.ok || ! tx.hydrate(begin, end) || tx.txid != txid) {
+            spdlog::error("snapshot: transaction {} does not hydrate", txid.decompress(true));
+            r.ok = false;
+            break;
+        }
+        validator.transaction_map.emplace(txid, std::move(tx));
+    }
+
+    const std::uint64_t valid_count = r.count(32);
+    validator.valid.reserve(valid_count);
+    for (std::uint64_t i=0; r.ok && i<valid_count; ++i) {
+        gs::txid txid;
+        r.hash(txid);
+        validator.valid.insert(txid);
+    }
+
+    const std::uint64_t unspent_count = r.count(32 + 4);
+    validator.unspent_outputs.reserve(unspent_count);
+    for (std::uint64_t i=0; r.ok && i<unspent_count; ++i) {
+        gs::txid txid;
+        r.hash(txid);
+        const std::uint32_t vout_count = r.num<std::uint32_t>();
+        const std::uint8_t* vouts = r.bytes(std::size_t(vout_count) * 4);
+        if (! r.ok) {
+            break;
+        }
+
+        std::vector<std::uint32_t> & v = validator.unspent_outputs[txid];
+        v.resize(vout_count);
+        std::memcpy(v.data(), vouts, std::size_t(vout_count) * 4);
+    }
+
+    const std::uint64_t spent_count = r.count(4 + 32);
+    for (std::uint64_t i=0; r.ok && i<spent_count; ++i) {
+        const std::uint32_t height = r.num<std::uint32_t>();
+        gs::txid txid;
+        r.hash(txid);
+        validator.fully_spent.emplace_back(height, txid);
+    }
+
+    if (! r.ok || r.pos != r.end) {
+        spdlog::error("snapshot: {} is malformed", path);
+        return { false, tip };
+    }
+
+    return { true, tip };
+}
+
+}
@@ -27,6 +27,175 @@ std::uint64_t transaction::output_slp_amount(const std::uint64_t vout) const
     return 0;
 }
 
+bool transaction_view::parse(const std::uint8_t * begin, const std::uint8_t * end)
+{
+    constexpr std::uint64_t MAX_TX_SIZE = 1000000;
+    constexpr std::uint64_t MAX_INPUTS  = MAX_TX_SIZE;
+    constexpr std::uint64_t MAX_OUTPUTS = MAX_TX_SIZE;
+    constexpr std::uint64_t MAX_SCRIPT_SIZE = MAX_TX_SIZE;
+
+    // same bounds as transaction::hydrate, written to not form pointers past end
+    #define CHECK_END(n) {                                          \
+        if (static_cast<std::uint64_t>(n) >= static_cast<std::uint64_t>(end - it)) { \
+            return false;                                           \
+        }                                                           \
+    }
+
+    const std::uint8_t * it = begin;
+
+    CHECK_END(4);
+    version = gs::util::extract_i32(it);
+
+    CHECK_END(0);
+    CHECK_END(1+gs::util::var_int_additional_size(it));
+    in_count = gs::util::extract_var_int(it);
+    if (in_count >= MAX_INPUTS) {
+        return false;
+    }
+
+    inputs_offset = it - begin;
+    for (std::uint64_t in_i=0; in_i<in_count; ++in_i) {
+        CHECK_END(32);
+        it+=32;
+
+        CHECK_END(4);
+        it+=4;
+        CHECK_END(0);
+        CHECK_END(1+gs::util::var_int_additional_size(it));
+        const std::uint64_t script_len { gs::util::extract_var_int(it) };
+        if (script_len >= MAX_SCRIPT_SIZE) {
+            return false;
+        }
+
+        CHECK_END(script_len);
+        it+=script_len;
+
+        CHECK_END(4);
+        it+=4;
+    }
+
+    CHECK_END(0);
+    CHECK_END(1+gs::util::var_int_additional_size(it));
+    out_count = gs::util::extract_var_int(it);
+    if (out_count >= MAX_OUTPUTS) {
+        return false;
+    }
+
+    outputs_offset = it - begin;
+    for (std::uint64_t out_i=0; out_i<out_count; ++out_i) {
+        CHECK_END(8);
+        it+=8;
+
+        CHECK_END(0);
+        CHECK_END(1+gs::util::var_int_additional_size(it));
+        const std::uint64_t script_len { gs::util::extract_var_int(it) };
+        if (script_len >= MAX_SCRIPT_SIZE) {
+            return false;
+        }
+
+        CHECK_END(script_len);
+        if (out_i == 0) {
+            first_script_offset = it - begin;
+            first_script_len    = script_len;
+        }
+        it+=script_len;
+    }
+
+    CHECK_END(4-1); // minus 1 because +4 could be the end
+    lock_time = gs::util::extract_u32(it);
+
+    data = begin;
+    size = it - begin;
+
+    return true;
+    #undef CHECK_END
+}
+
+gs::txid transaction_view::compute_txid() const
+{
+    gs::txid ret;
+    gs::sha256d(data, size, ret.v.data());
+    return ret;
+}
+
+bool transaction_view::op_return(const std::uint8_t *& script, std::size_t& script_len) const
+{
+    if (out_count == 0 || first_script_len == 0 || data[first_script_offset] != 0x6a) {
+        return false;
+    }
+
+    script     = data + first_script_offset;
+    script_len = first_script_len;
+
+    return true;
+}
+
+bool transaction_view::slp_candidate() const
+{
+    const std::uint8_t * script;
+    std::size_t script_len;
+    if (! op_return(script, script_len) || script_len < 10) {
+        return false;
+    }
+
+    // the lokad id may be pushed directly or with any OP_PUSHDATA
+    // script_len >= 10 covers the longest form, OP_PUSHDATA4
+    static const std::uint8_t lokad_id[4] = { 'S', 'L', 'P', 0x00 };
+    const std::uint8_t * it = script + 1;
+    const std::uint8_t op = gs::util::extract_u8(it);
+
+    std::uint64_t push_len;
+         if (op  < 0x4C) push_len = op;
+    else if (op == 0x4C) push_len = gs::util::extract_u8(it);
+    else if (op == 0x4D) push_len = gs::util::extract_u16(it);
+    else if (op == 0x4E) push_len = gs::util::extract_u32(it);
+    else                 return false;
+
+    return push_len == 4 && std::memcmp(it, lokad_id, 4) == 0;
+}
+
+void transaction_view::materialize(gs::transaction& tx) const
+{
+    materialize(tx, compute_txid());
+}
+
+void transaction_view::materialize(gs::transaction& tx, const gs::txid& txid) const
+{
+    tx.version   = version;
+    tx.lock_time = lock_time;
+    tx.serialized.assign(data, data+size);
+    tx.txid = txid;
+
+    tx.inputs.clear();
+    tx.inputs.reserve(in_count);
+    for_each_input([&](const gs::txid& prev_tx_id, const std::uint32_t prev_out_idx) {
+        tx.inputs.emplace_back(prev_tx_id, prev_out_idx);
+    });
+
+    tx.outputs.clear();
+    tx.outputs.reserve(out_count);
+    for_each_output([&](
+        const std::uint32_t vout,
+        const std::uint64_t value,
+        const std::uint8_t * script,
+        const std::size_t script_len
+    ) {
+        gs::scriptpubkey scriptpubkey(script_len);
+        scriptpubkey.v.assign(script, script+script_len);
+        tx.outputs.emplace_back(tx.txid, vout, value, scriptpubkey);
+    });
+
+    tx.slp = gs::slp_transaction();
+    if (tx.outputs.size() > 0) {
+        if (tx.outputs[0].is_op_return()) {
+            tx.slp = gs::slp_transaction(tx.outputs[0].scriptpubkey);
+            if (tx.slp.type == gs::slp_transaction_type::genesis) {
+                tx.slp.tokenid = gs::tokenid(tx.txid.v);
+            }
+        }
+    }
+}
+
 gs::outpoint transaction::mint_baton_outpoint() const
 {
     if (slp.type == slp_transaction_type::mint) {
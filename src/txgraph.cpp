@@ -90,6 +90,30 @@ txgraph::graph_search__ptr(
     return { graph_search_status::OK, ret };
 }
 
+bool txgraph::has_tx(const gs::txid& lookup_txid)
+{
+    boost::shared_lock<boost::shared_mutex> lock(lookup_mtx);
+
+    return txid_to_token.count(lookup_txid) > 0;
+}
+
+std::pair<bool, std::vector<std::uint8_t>> txgraph::get_txdata(const gs::txid& lookup_txid)
+{
+    boost::shared_lock<boost::shared_mutex> lock(lookup_mtx);
+
+    const auto token = txid_to_token.find(lookup_txid);
+    if (token == txid_to_token.end()) {
+        return { false, {} };
+    }
+
+    const auto node = token->second->graph.find(lookup_txid);
+    if (node == token->second->graph.end()) {
+        return { false, {} };
+    }
+
+    return { true, node->second.txdata };
+}
+
 unsigned txgraph::insert_token_data (
     const gs::tokenid & tokenid,
     const std::vector<gs::transaction> & txs
@@ -156,4 +180,30 @@ unsigned txgraph::insert_token_data (
     return ret;
 }
 
+unsigned txgraph::remove_txs(const std::vector<gs::txid> & txids)
+{
+    boost::lock_guard<boost::shared_mutex> lock(lookup_mtx);
+
+    unsigned ret = 0;
+
+    for (const gs::txid & txid : txids) {
+        auto search = txid_to_token.find(txid);
+        if (search == txid_to_token.end()) {
+            continue;
+        }
+
+        token_details* token = search->second;
+        token->graph.erase(txid);
+        txid_to_token.erase(search);
+        ++ret;
+
+        // no txid points at the token anymore
+        if (token->graph.empty()) {
+            tokens.erase(token->tokenid);
+        }
+    }
+
+    return ret;
+}
+
 }
@@ -1,6 +1,9 @@
 #include <vector>
+#include <string>
+#include <utility>
+#include <queue>
+#include <functional>
 #include <absl/container/flat_hash_map.h>
-#include <absl/container/flat_hash_set.h>
 #include <gs++/transaction.hpp>
 #include <gs++/bhash.hpp>
 #include <gs++/output.hpp>
@@ -9,54 +12,181 @@ namespace gs {
 
 namespace util {
 
-void topological_sort_internal(
-    const gs::transaction& tx,
-    const absl::flat_hash_map<gs::txid, gs::transaction> & transactions,
-    std::vector<gs::transaction> & stack,
-    absl::flat_hash_set<gs::txid> & visited
+std::vector<std::size_t> topological_order(
+    const std::vector<gs::transaction>& tx_list
 ) {
-    visited.insert(tx.txid);
+    const std::size_t n = tx_list.size();
+
+    // later copies of a txid are dropped
+    absl::flat_hash_map<gs::txid, std::size_t> index;
+    index.reserve(n);
+    std::vector<bool> duplicate(n, false);
+    for (std::size_t i=0; i<n; ++i) {
+        duplicate[i] = ! index.emplace(tx_list[i].txid, i).second;
+    }
 
-    for (const gs::outpoint & outpoint : tx.inputs) {
-        if (visited.count(outpoint.txid)      != 0
-        || transactions.count(outpoint.txid)  != 1
-        ) {
+    // in-block parent -> child edges, one per spending input
+    std::vector<std::pair<std::size_t, std::size_t>> edges;
+    std::vector<std::size_t> in_degree(n, 0);
+    std::vector<std::size_t> first_child(n+1, 0);
+    for (std::size_t i=0; i<n; ++i) {
+        if (duplicate[i]) {
             continue;
         }
 
-        topological_sort_internal(
-            transactions.at(outpoint.txid),
-            transactions,
-            stack,
-            visited
-        );
+        for (const gs::outpoint & outpoint : tx_list[i].inputs) {
+            auto search = index.find(outpoint.txid);
+            if (search == index.end() || search->second == i) {
+                continue;
+            }
+
+            edges.emplace_back(search->second, i);
+            ++first_child[search->second+1];
+            ++in_degree[i];
+        }
+    }
+
+    // children of i are children[first_child[i] .. first_child[i+1])
+    for (std::size_t i=0; i<n; ++i) {
+        first_child[i+1] += first_child[i];
+    }
+    std::vector<std::size_t> children(edges.size());
+    {
+        std::vector<std::size_t> cursor(first_child.begin(), first_child.end()-1);
+        for (const auto & edge : edges) {
+            children[cursor[edge.first]++] = edge.second;
+        }
+    }
+
+    // always emitting the lowest ready index keeps already sorted input as is
+    std::priority_queue<std::size_t, std::vector<std::size_t>, std::greater<std::size_t>> ready;
+    for (std::size_t i=0; i<n; ++i) {
+        if (! duplicate[i] && in_degree[i] == 0) {
+            ready.push(i);
+        }
+    }
+
+    std::vector<std::size_t> order;
+    order.reserve(index.size());
+    while (! ready.empty()) {
+        const std::size_t i = ready.top();
+        ready.pop();
+        order.push_back(i);
+
+        for (std::size_t c=first_child[i]; c<first_child[i+1]; ++c) {
+            if (--in_degree[children[c]] == 0) {
+                ready.push(children[c]);
+            }
+        }
     }
 
-    stack.push_back(tx);
+    // cycles cannot happen with real txids, keep whatever is left rather than losing it
+    if (order.size() < index.size()) {
+        for (std::size_t i=0; i<n; ++i) {
+            if (! duplicate[i] && in_degree[i] != 0) {
+                order.push_back(i);
+            }
+        }
+    }
+
+    return order;
 }
 
 std::vector<gs::transaction> topological_sort(
-    const std::vector<gs::transaction>& tx_list
+    std::vector<gs::transaction> tx_list
 ) {
-    absl::flat_hash_map<gs::txid, gs::transaction> transactions;
-    transactions.reserve(tx_list.size());
-    for (const gs::transaction & tx : tx_list) {
-        transactions.insert({ tx.txid, tx });
+    const std::vector<std::size_t> order = topological_order(tx_list);
+
+    std::vector<gs::transaction> ret;
+    ret.reserve(order.size());
+    for (const std::size_t i : order) {
+        ret.push_back(std::move(tx_list[i]));
     }
 
-    std::vector<gs::transaction> stack;
-    stack.reserve(tx_list.size());
+    return ret;
+}
 
-    absl::flat_hash_set<gs::txid> visited;
-    visited.reserve(tx_list.size());
+std::pair<bool, std::pair<std::size_t, std::size_t>> json_rpc_result_string(
+    const std::string& body
+) {
+    const std::pair<bool, std::pair<std::size_t, std::size_t>> fail { false, { 0, 0 } };
 
-    for (const gs::transaction & tx : tx_list) {
-        if (visited.count(tx.txid) == 0) {
-            topological_sort_internal(tx, transactions, stack, visited);
+    std::size_t pos = 0;
+    auto skip_ws = [&]() {
+        while (pos < body.size() && (body[pos] == ' ' || body[pos] == '\t' || body[pos] == '\n' || body[pos] == '\r')) {
+            ++pos;
+        }
+    };
+    auto expect = [&](const char c) -> bool {
+        skip_ws();
+        if (pos < body.size() && body[pos] == c) {
+            ++pos;
+            return true;
         }
+        return false;
+    };
+    // strings here never contain escapes, one that does ends the string early and fails later
+    auto read_string = [&](std::size_t & start, std::size_t & len) -> bool {
+        if (! expect('"')) {
+            return false;
+        }
+        const std::size_t end = body.find('"', pos);
+        if (end == std::string::npos) {
+            return false;
+        }
+        start = pos;
+        len   = end - pos;
+        pos   = end + 1;
+        return true;
+    };
+
+    if (! expect('[') || ! expect('{')) {
+        return fail;
+    }
+
+    bool found = false;
+    std::pair<std::size_t, std::size_t> result;
+    do {
+        std::size_t key_start, key_len;
+        if (! read_string(key_start, key_len) || ! expect(':')) {
+            return fail;
+        }
+        skip_ws();
+
+        if (body.compare(key_start, key_len, "result") == 0) {
+            if (! read_string(result.first, result.second)) {
+                return fail;
+            }
+            found = true;
+        }
+        else if (body.compare(key_start, key_len, "error") == 0) {
+            if (body.compare(pos, 4, "null") != 0) {
+                return fail;
+            }
+            pos += 4;
+        }
+        else if (pos < body.size() && body[pos] == '"') {
+            std::size_t ignored_start, ignored_len;
+            if (! read_string(ignored_start, ignored_len)) {
+                return fail;
+            }
+        }
+        else {
+            // numbers and literals such as the id, nested values are not expected
+            while (pos < body.size() && body[pos] != ',' && body[pos] != '}') {
+                if (body[pos] == '{' || body[pos] == '[' || body[pos] == '"') {
+                    return fail;
+                }
+                ++pos;
+            }
+        }
+    } while (expect(','));
+
+    if (! found || ! expect('}') || ! expect(']')) {
+        return fail;
     }
 
-    return stack;
+    return { true, result };
 }
 
 std::vector<std::uint8_t> num_to_var_int(const std::uint64_t n)
@@ -0,0 +1,463 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <algorithm>
+
+#include <boost/crc.hpp>
+#include <boost/thread.hpp>
+#include <absl/hash/hash.h>
+#include <absl/container/flat_hash_map.h>
+#include <absl/container/flat_hash_set.h>
+#include <spdlog/spdlog.h>
+
+#include <gs++/utxo_checkpoint.hpp>
+#include <gs++/utxodb.hpp>
+#include <gs++/snapshot.hpp>
+#include <gs++/output.hpp>
+#include <gs++/scriptpubkey.hpp>
+#include <gs++/bhash.hpp>
+#include <gs++/ecmh.hpp>
+#include <gs++/util.hpp>
+#include <gs++/compact_utxo.hpp>
+
+namespace gs {
+
+namespace {
+
+constexpr std::uint32_t checkpoint_magic   = 0x43555347; // "GSUC"
+constexpr std::uint32_t checkpoint_version = 3;
+
+constexpr std::size_t header_size      = 4 + 4 + 4 + 32 + 8 + 1 + 32;
+constexpr std::size_t table_entry_size = 8 + 8 + 4;
+constexpr std::size_t footer_size      = 8 + 4;
+
+constexpr std::uint64_t outputs_per_chunk = 1 << 16;
+
+struct chunk_entry
+{
+    std::uint64_t offset;
+    std::uint64_t count;
+    std::uint32_t crc;
+};
+
+struct checkpoint_writer
+{
+    int fd;
+    std::vector<std::uint8_t> buf;
+    std::uint64_t offset; // of the next byte, buffered or not
+    boost::crc_32_type crc; // reset by the caller for every chunk
+    bool ok;
+
+    checkpoint_writer(const int fd)
+    : fd(fd)
+    , offset(0)
+    , ok(true)
+    {
+        buf.reserve(1 << 20);
+    }
+
+    void bytes(const std::uint8_t* data, const std::size_t len)
+    {
+        crc.process_bytes(data, len);
+        buf.insert(buf.end(), data, data + len);
+        offset += len;
+        if (buf.size() >= (1 << 20)) {
+            flush();
+        }
+    }
+
+    template <typename T>
+    void num(const T v)
+    {
+        std::uint8_t b[sizeof(T)];
+        std::memcpy(b, &v, sizeof(T));
+        bytes(b, sizeof(T));
+    }
+
+    // same encoding as gs::util::num_to_var_int without a vector per call
+    void var_int(const std::uint64_t n)
+    {
+        if (n <= 0xFC) {
+            num<std::uint8_t>(n);
+        } else if (n <= 0xFFFF) {
+            num<std::uint8_t>(0xFD);
+            num<std::uint16_t>(n);
+        } else if (n <= 0xFFFFFFFF) {
+            num<std::uint8_t>(0xFE);
+            num<std::uint32_t>(n);
+        } else {
+            num<std::uint8_t>(0xFF);
+            num<std::uint64_t>(n);
+        }
+    }
+
+    template <typename Tag>
+    void hash(const gs::bhash<Tag>& h)
+    {
+        bytes(h.v.data(), h.v.size());
+    }
+
+    bool flush()
+    {
+        const std::uint8_t* data = buf.data();
+        std::size_t len = buf.size();
+        while (ok && len > 0) {
+            const ssize_t n = ::write(fd, data, len);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            data += n;
+            len  -= static_cast<std::size_t>(n);
+        }
+        buf.clear();
+
+        return ok;
+    }
+};
+
+template <typename T>
+T read_num(const std::uint8_t* p)
+{
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+// false if the var_int at pos runs past end
+bool read_var_int(const std::uint8_t* & pos, const std::uint8_t* end, std::uint64_t& v)
+{
+    if (pos == end || static_cast<std::size_t>(end - pos) < 1 + gs::util::var_int_additional_size(pos)) {
+        return false;
+    }
+
+    v = gs::util::extract_var_int(pos);
+    return true;
+}
+
+// runs f(0) .. f(threads-1) at once and waits for all of them
+void run_parallel(const std::size_t threads, const std::function<void(std::size_t)>& f)
+{
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (std::size_t t=0; t<threads; ++t) {
+        workers.emplace_back(f, t);
+    }
+    for (auto & w : workers) {
+        w.join();
+    }
+}
+
+// checks the crc and bounds of one chunk and unpacks its outputs
+// commitment, unless nullptr, gets every output
+bool parse_chunk(
+    const std::uint8_t* begin,
+    const std::uint8_t* end,
+    const chunk_entry& entry,
+    std::vector<gs::output>& outputs,
+    gs::ecmh* commitment
+) {
+    boost::crc_32_type crc;
+    crc.process_bytes(begin, end - begin);
+    if (crc.checksum() != entry.crc) {
+        return false;
+    }
+
+    outputs.reserve(entry.count);
+
+    const std::uint8_t* pos = begin;
+    for (std::uint64_t i=0; i<entry.count; ++i) {
+        if (static_cast<std::size_t>(end - pos) < 32) {
+            return false;
+        }
+
+        gs::output o;
+        std::copy(pos, pos + 32, o.prev_tx_id.v.begin());
+        pos += 32;
+
+        std::uint64_t vout;
+        std::uint64_t script_len;
+        if (! read_var_int(pos, end, vout)
+         || ! read_var_int(pos, end, o.value)
+         || ! read_var_int(pos, end, script_len)
+         || vout > 0xFFFFFFFF
+         || static_cast<std::uint64_t>(end - pos) < script_len
+        ) {
+            return false;
+        }
+        o.prev_out_idx = vout;
+        o.scriptpubkey.v.assign(pos, pos + script_len);
+        pos += script_len;
+
+        if (commitment != nullptr) {
+            commitment->add(o);
+        }
+        outputs.push_back(std::move(o));
+    }
+
+    return pos == end;
+}
+
+}
+
+bool save_utxo_checkpoint(
+    const std::string& path,
+    gs::utxodb& utxodb
+) {
+    boost::shared_lock<boost::shared_mutex> lock(utxodb.lookup_mtx);
+
+    const std::string tmp_path = path + ".tmp";
+    const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        spdlog::error("utxo checkpoint: could not open {}: {}", tmp_path, std::strerror(errno));
+        return false;
+    }
+
+    checkpoint_writer w(fd);
+    w.num<std::uint32_t>(checkpoint_magic);
+    w.num<std::uint32_t>(checkpoint_version);
+    w.num<std::uint32_t>(utxodb.current_block_height);
+    w.hash(utxodb.current_block_hash);
+    w.num<std::uint64_t>(utxodb.outpoint_map.size());
+    w.num<std::uint8_t>(utxodb.commitment_enabled ? 1 : 0);
+    w.hash(utxodb.commitment_enabled ? utxodb.commitment.finalize() : gs::ecmh_hash());
+    const boost::crc_32_type header_crc = w.crc;
+
+    std::vector<chunk_entry> chunks;
+    chunks.reserve(utxodb.outpoint_map.size() / outputs_per_chunk + 1);
+
+    for (const auto & m : utxodb.outpoint_map) {
+        if (chunks.empty() || chunks.back().count == outputs_per_chunk) {
+            if (! chunks.empty()) {
+                chunks.back().crc = w.crc.checksum();
+            }
+            chunks.push_back({ w.offset, 0, 0 });
+            w.crc.reset();
+        }
+
+        const gs::scriptpubkey scriptpubkey = m.second.script.to_scriptpubkey(utxodb.scripts);
+        w.hash(utxodb.txids.get(m.first.tx));
+        w.var_int(m.first.vout);
+        w.var_int(m.second.value);
+        w.var_int(scriptpubkey.v.size());
+        w.bytes(scriptpubkey.v.data(), scriptpubkey.v.size());
+        ++chunks.back().count;
+    }
+    if (! chunks.empty()) {
+        chunks.back().crc = w.crc.checksum();
+    }
+
+    w.crc = header_crc;
+    for (const chunk_entry & c : chunks) {
+        w.num<std::uint64_t>(c.offset);
+        w.num<std::uint64_t>(c.count);
+        w.num<std::uint32_t>(c.crc);
+    }
+    w.num<std::uint64_t>(chunks.size());
+
+    const std::uint32_t checksum = w.crc.checksum();
+    w.num<std::uint32_t>(checksum);
+    w.flush();
+
+    const bool synced = w.ok && ::fsync(fd) == 0;
+    ::close(fd);
+
+    if (! synced || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        spdlog::error("utxo checkpoint: could not write {}: {}", path, std::strerror(errno));
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+std::pair<bool, snapshot_tip> load_utxo_checkpoint(
+    const std::string& path,
+    gs::utxodb& utxodb,
+    std::size_t threads
+) {
+    snapshot_tip tip;
+    tip.height = 0;
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return { false, tip };
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < header_size + footer_size) {
+        ::close(fd);
+        spdlog::error("utxo checkpoint: {} is truncated", path);
+        return { false, tip };
+    }
+    const std::size_t size = static_cast<std::size_t>(st.st_size);
+
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        spdlog::error("utxo checkpoint: mmap failed: {}", std::strerror(errno));
+        return { false, tip };
+    }
+    // chunks are read by many threads at once, not front to back
+    ::madvise(map, size, MADV_WILLNEED);
+
+    const std::uint8_t* data = static_cast<const std::uint8_t*>(map);
+    struct unmap_guard
+    {
+        void* map;
+        std::size_t size;
+        ~unmap_guard() { ::munmap(map, size); }
+    } guard { map, size };
+
+    const std::uint8_t* footer = data + size - footer_size;
+    const std::uint64_t chunk_count = read_num<std::uint64_t>(footer);
+    if (chunk_count > (size - header_size - footer_size) / table_entry_size) {
+        spdlog::error("utxo checkpoint: {} is truncated", path);
+        return { false, tip };
+    }
+    const std::uint8_t* table = footer - chunk_count * table_entry_size;
+
+    // the chunk count directly follows the table
+    boost::crc_32_type crc;
+    crc.process_bytes(data, header_size);
+    crc.process_bytes(table, chunk_count * table_entry_size + 8);
+    if (crc.checksum() != read_num<std::uint32_t>(footer + 8)) {
+        spdlog::error("utxo checkpoint: {} fails its checksum", path);
+        return { false, tip };
+    }
+
+    if (read_num<std::uint32_t>(data) != checkpoint_magic
+     || read_num<std::uint32_t>(data + 4) != checkpoint_version
+    ) {
+        spdlog::error("utxo checkpoint: {} is not a version {} checkpoint", path, checkpoint_version);
+        return { false, tip };
+    }
+    tip.height = read_num<std::uint32_t>(data + 8);
+    std::copy(data + 12, data + 44, tip.hash.v.begin());
+    const std::uint64_t output_count = read_num<std::uint64_t>(data + 44);
+    const bool has_commitment = data[52] != 0;
+    gs::ecmh_hash stored_commitment;
+    std::copy(data + 53, data + 85, stored_commitment.v.begin());
+
+    // chunks lie back to back between the header and the table
+    std::vector<chunk_entry> chunks(chunk_count);
+    std::uint64_t counted = 0;
+    for (std::uint64_t i=0; i<chunk_count; ++i) {
+        const std::uint8_t* e = table + i * table_entry_size;
+        chunks[i] = { read_num<std::uint64_t>(e), read_num<std::uint64_t>(e + 8), read_num<std::uint32_t>(e + 16) };
+
+        const std::uint64_t expected = i == 0 ? header_size : chunks[i-1].offset;
+        const std::uint64_t limit    = static_cast<std::uint64_t>(table - data);
+        if (chunks[i].offset < expected || chunks[i].offset > limit || (i == 0 && chunks[i].offset != header_size)) {
+            spdlog::error("utxo checkpoint: {} has a corrupt chunk table", path);
+            return { false, tip };
+        }
+        counted += chunks[i].count;
+    }
+    if (counted != output_count) {
+        spdlog::error("utxo checkpoint: {} has a corrupt chunk table", path);
+        return { false, tip };
+    }
+
+    auto chunk_end = [&](const std::uint64_t i) -> const std::uint8_t* {
+        return i + 1 < chunk_count ? data + chunks[i+1].offset : table;
+    };
+
+    std::vector<gs::ecmh> commitments(threads); // of the outputs each thread parsed
+    std::atomic<std::uint64_t> next_chunk(0);
+    std::atomic<bool> failed(false);
+    boost::mutex store_mtx; // interning takes one writer
+
+    boost::lock_guard<boost::shared_mutex> lock(utxodb.lookup_mtx);
+    utxodb.outpoint_map.reserve(output_count);
+
+    // chunks are interned as soon as they are parsed so every thread holds at most one as gs::output
+    run_parallel(threads, [&](const std::size_t t) {
+        gs::ecmh* commitment = utxodb.commitment_enabled ? &commitments[t] : nullptr;
+        std::vector<gs::output> outputs;
+        for (std::uint64_t i = next_chunk++; i < chunk_count && ! failed; i = next_chunk++) {
+            outputs.clear();
+            if (! parse_chunk(data + chunks[i].offset, chunk_end(i), chunks[i], outputs, commitment)) {
+                spdlog::error("utxo checkpoint: {} has a corrupt chunk", path);
+                failed = true;
+                break;
+            }
+
+            boost::lock_guard<boost::mutex> store_lock(store_mtx);
+            for (const gs::output & o : outputs) {
+                if (! utxodb.store_output(o).first) {
+                    spdlog::error("utxo checkpoint: {} holds {}:{} twice", path, o.prev_tx_id.decompress(true), o.prev_out_idx);
+                    failed = true;
+                    break;
+                }
+            }
+        }
+    });
+    if (failed) {
+        return { false, tip };
+    }
+
+    // recomputed from the outputs rather than trusted, so a match proves the set itself
+    gs::ecmh commitment;
+    if (utxodb.commitment_enabled) {
+        for (const gs::ecmh & m : commitments) {
+            commitment.combine(m);
+        }
+
+        if (has_commitment && commitment.finalize() != stored_commitment) {
+            spdlog::error("utxo checkpoint: {} does not match its utxo commitment", path);
+            return { false, tip };
+        }
+    }
+
+    // every thread indexes the scripts of its shard, the shards are disjoint so merging only moves sets
+    // shards are picked from the high bits, the maps themselves probe with the low ones
+    std::vector<absl::flat_hash_map<gs::script_ref, absl::flat_hash_set<gs::utxo_key>>> shards(threads);
+    run_parallel(threads, [&](const std::size_t t) {
+        auto & shard = shards[t];
+        for (const auto & m : utxodb.outpoint_map) {
+            const std::uint64_t h = absl::Hash<gs::script_ref>()(m.second.script);
+            if ((h >> 48) % threads == t) {
+                shard[m.second.script].insert(m.first);
+            }
+        }
+    });
+
+    std::size_t script_count = 0;
+    for (auto & shard : shards) {
+        script_count += shard.size();
+    }
+    utxodb.scriptpubkey_to_output.reserve(script_count);
+    for (auto & shard : shards) {
+        for (auto & m : shard) {
+            utxodb.scriptpubkey_to_output.emplace(m.first, std::move(m.second));
+        }
+        shard.clear();
+    }
+
+    utxodb.current_block_height = tip.height;
+    utxodb.current_block_hash   = tip.hash;
+    utxodb.commitment           = commitment;
+
+    return { true, tip };
+}
+
+}
@@ -0,0 +1,86 @@
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include <gs++/utxo_undo.hpp>
+#include <gs++/bhash.hpp>
+#include <gs++/output.hpp>
+#include <gs++/util.hpp>
+
+namespace gs {
+
+void utxo_undo::push_tx(const gs::txid& txid)
+{
+    txids.push_back(txid);
+}
+
+void utxo_undo::push_added(const std::uint32_t vout)
+{
+    added.push_back(txids.size() - 1);
+    added.push_back(vout);
+}
+
+void utxo_undo::push_removed(const gs::output& o)
+{
+    const std::vector<std::uint8_t> vout       = gs::util::num_to_var_int(o.prev_out_idx);
+    const std::vector<std::uint8_t> value      = gs::util::num_to_var_int(o.value);
+    const std::vector<std::uint8_t> script_len = gs::util::num_to_var_int(o.scriptpubkey.v.size());
+
+    const std::size_t pos = removed.size();
+    removed.resize(pos + 32 + vout.size() + value.size() + script_len.size() + o.scriptpubkey.v.size());
+
+    std::uint8_t* it = removed.data() + pos;
+    it = std::copy(o.prev_tx_id.v.begin(), o.prev_tx_id.v.end(), it);
+    it = std::copy(vout.begin(), vout.end(), it);
+    it = std::copy(value.begin(), value.end(), it);
+    it = std::copy(script_len.begin(), script_len.end(), it);
+    std::copy(o.scriptpubkey.v.begin(), o.scriptpubkey.v.end(), it);
+
+    ++removed_count;
+}
+
+void utxo_undo::push_baton(const gs::tokenid& tokenid, const absl::optional<gs::outpoint>& baton)
+{
+    for (auto & m : slp_batons) {
+        if (m.first == tokenid) {
+            return;
+        }
+    }
+
+    slp_batons.emplace_back(tokenid, baton);
+}
+
+std::vector<gs::output> utxo_undo::removed_outputs() const
+{
+    std::vector<gs::output> ret;
+    ret.reserve(removed_count);
+
+    const std::uint8_t* it = removed.data();
+    for (std::uint32_t i=0; i<removed_count; ++i) {
+        gs::output o;
+        std::copy(it, it+32, o.prev_tx_id.v.begin());
+        it += 32;
+        o.prev_out_idx = gs::util::extract_var_int(it);
+        o.value        = gs::util::extract_var_int(it);
+        const std::uint64_t script_len = gs::util::extract_var_int(it);
+        o.scriptpubkey.v.assign(it, it + script_len);
+        it += script_len;
+
+        ret.push_back(std::move(o));
+    }
+
+    return ret;
+}
+
+std::size_t utxo_undo::memory_usage() const
+{
+    return sizeof(utxo_undo)
+         + txids.capacity()       * sizeof(gs::txid)
+         + added.capacity()       * sizeof(std::uint32_t)
+         + removed.capacity()
+         + slp_removed.capacity() * sizeof(slp_utxo)
+         + slp_txs.capacity()     * sizeof(std::pair<gs::tokenid, gs::txid>)
+         + slp_batons.capacity()  * sizeof(std::pair<gs::tokenid, absl::optional<gs::outpoint>>);
+}
+
+}
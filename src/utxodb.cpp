@@ -30,58 +30,213 @@ namespace gs {
 
 utxodb::utxodb()
 : current_block_height(0)
-, current_block_hash("0000000000000000000000000000000000000000000000000000000000000000")
+, commitment_enabled(false)
+, rollback_depth(10)
 {}
 
-void utxodb::rollback()
+void utxodb::push_undo(gs::utxo_undo&& undo)
 {
-    boost::lock_guard<boost::shared_mutex> lock(lookup_mtx);
-
-    if (last_block_removed.empty() || last_block_added.empty()) {
+    if (rollback_depth == 0) {
         return;
     }
 
-    const std::vector<gs::output> rb_removed = last_block_removed.back();
-    const std::vector<gs::outpoint> rb_added = last_block_added.back();
-    last_block_removed.pop_back();
-    last_block_added.pop_back();
+    // the buffers grew while the block was processed, only what they hold is kept
+    undo.txids.shrink_to_fit();
+    undo.added.shrink_to_fit();
+    undo.removed.shrink_to_fit();
 
-    for (auto m : rb_removed) {
-        gs::output* const oid = &(*outpoint_map.insert({
-            gs::outpoint(m.prev_tx_id, m.prev_out_idx),
-            m
-        }).first).second;
+    undo_journal.push_back(std::move(undo));
+    while (undo_journal.size() > rollback_depth) {
+        undo_journal.pop_front();
+    }
+}
 
-        if (! scriptpubkey_to_output.count(m.scriptpubkey)) {
-            scriptpubkey_to_output.insert({ m.scriptpubkey, { oid } });
-        } else {
-            scriptpubkey_to_output[m.scriptpubkey].insert(oid);
+bool utxodb::add_output(const gs::output& o)
+{
+    const std::pair<bool, gs::utxo_key> stored = store_output(o);
+    if (! stored.first) {
+        return false;
+    }
+
+    scriptpubkey_to_output[outpoint_map.at(stored.second).script].insert(stored.second);
+
+    return true;
+}
+
+std::pair<bool, gs::utxo_key> utxodb::store_output(const gs::output& o)
+{
+    const gs::utxo_key key(txids.acquire(o.prev_tx_id), o.prev_out_idx);
+
+    gs::utxo_entry entry;
+    entry.value = o.value;
+    if (! gs::script_ref::from_template(o.scriptpubkey, entry.script)) {
+        entry.script = gs::script_ref::interned(scripts.acquire(o.scriptpubkey));
+    }
+
+    if (! outpoint_map.emplace(key, entry).second) {
+        if (entry.script.tag == gs::script_ref::kind::interned) {
+            scripts.release(entry.script.interned_id());
         }
+        txids.release(key.tx);
+
+        return { false, key };
+    }
+
+    return { true, key };
+}
 
-        // std::cout << "\tadded: " << m.prev_tx_id.decompress(true) << ":" << m.prev_out_idx << "\n";
+bool utxodb::remove_output(const gs::outpoint& outpoint, gs::output& removed)
+{
+    const std::pair<bool, std::uint32_t> tx = txids.find(outpoint.txid);
+    if (! tx.first) {
+        return false;
     }
 
-    for (auto m : rb_added) {
-        if (outpoint_map.count(m) == 0) {
-            continue;
+    const gs::utxo_key key(tx.second, outpoint.vout);
+    const auto outpoint_map_search = outpoint_map.find(key);
+    if (outpoint_map_search == outpoint_map.end()) {
+        return false;
+    }
+
+    const gs::utxo_entry entry = outpoint_map_search->second;
+    removed = to_output(key, entry);
+    outpoint_map.erase(outpoint_map_search);
+
+    const auto addr_search = scriptpubkey_to_output.find(entry.script);
+    if (addr_search != scriptpubkey_to_output.end()) {
+        addr_search->second.erase(key);
+        if (addr_search->second.empty()) {
+            scriptpubkey_to_output.erase(addr_search);
         }
+    }
+
+    // only once nothing refers to the ids anymore, they may be handed out again
+    if (entry.script.tag == gs::script_ref::kind::interned) {
+        scripts.release(entry.script.interned_id());
+    }
+    txids.release(key.tx);
+
+    return true;
+}
+
+bool utxodb::find_output(const gs::outpoint& outpoint, gs::output& found) const
+{
+    const std::pair<bool, std::uint32_t> tx = txids.find(outpoint.txid);
+    if (! tx.first) {
+        return false;
+    }
+
+    const gs::utxo_key key(tx.second, outpoint.vout);
+    const auto outpoint_map_search = outpoint_map.find(key);
+    if (outpoint_map_search == outpoint_map.end()) {
+        return false;
+    }
+
+    found = to_output(key, outpoint_map_search->second);
+
+    return true;
+}
+
+bool utxodb::find_script_ref(const gs::scriptpubkey& scriptpubkey, gs::script_ref& ref) const
+{
+    if (gs::script_ref::from_template(scriptpubkey, ref)) {
+        return true;
+    }
+
+    const std::pair<bool, std::uint32_t> id = scripts.find(scriptpubkey);
+    if (! id.first) {
+        return false;
+    }
 
-        const gs::output& o                 = outpoint_map.at(m);
-        const gs::scriptpubkey scriptpubkey = o.scriptpubkey;
+    ref = gs::script_ref::interned(id.second);
 
-        if (! scriptpubkey_to_output.count(scriptpubkey)) {
-            continue;
+    return true;
+}
+
+gs::output utxodb::to_output(const gs::utxo_key& key, const gs::utxo_entry& entry) const
+{
+    return gs::output(txids.get(key.tx), key.vout, entry.value, entry.script.to_scriptpubkey(scripts));
+}
+
+bool utxodb::rollback(gs::utxo_undo& undone)
+{
+    boost::lock_guard<boost::shared_mutex> lock(lookup_mtx);
+
+    if (undo_journal.empty()) {
+        return false;
+    }
+
+    undone = std::move(undo_journal.back());
+    undo_journal.pop_back();
+
+    // grown once up front instead of rehashing while the spent outputs go back in
+    outpoint_map.reserve(outpoint_map.size() + undone.removed_count);
+
+    const std::vector<gs::output> removed = undone.removed_outputs();
+    std::vector<const gs::output*> restored;
+    for (auto & m : removed) {
+        if (add_output(m) && commitment_enabled) {
+            restored.push_back(&m);
         }
-        absl::flat_hash_set<gs::output*> & addr_map = scriptpubkey_to_output.at(scriptpubkey);
-        if (addr_map.erase(&o)) {
-            // std::cout << "\tremoved: " << m.txid.decompress(true) << ":" << m.vout << "\n";
-            if (addr_map.empty()) {
-                scriptpubkey_to_output.erase(scriptpubkey);
-            }
+    }
+
+    // outputs created and spent in the same block were put back above and go again here
+    std::vector<gs::output> created;
+    created.reserve(undone.added_count());
+    for (std::size_t i=0; i<undone.added_count(); ++i) {
+        gs::output o;
+        if (remove_output(undone.added_outpoint(i), o)) {
+            created.push_back(std::move(o));
+        }
+    }
+
+    if (commitment_enabled) {
+        std::vector<const gs::output*> created_outputs;
+        created_outputs.reserve(created.size());
+        for (auto & m : created) {
+            created_outputs.push_back(&m);
         }
+        commitment.update(restored, created_outputs);
     }
+
+    --current_block_height;
+    current_block_hash = undone.prev_hash;
+
+    return true;
 }
 
+std::size_t utxodb::undo_memory_usage()
+{
+    boost::shared_lock<boost::shared_mutex> lock(lookup_mtx);
+
+    std::size_t ret = 0;
+    for (const gs::utxo_undo & m : undo_journal) {
+        ret += m.memory_usage();
+    }
+
+    return ret;
+}
+
+
+std::size_t utxodb::memory_usage()
+{
+    boost::shared_lock<boost::shared_mutex> lock(lookup_mtx);
+
+    // flat maps hold one control byte per slot
+    std::size_t ret = outpoint_map.capacity() * (sizeof(decltype(outpoint_map)::value_type) + 1)
+                    + scriptpubkey_to_output.capacity() * (sizeof(decltype(scriptpubkey_to_output)::value_type) + 1)
+                    + txids.memory_usage()
+                    + scripts.memory_usage();
+
+    for (const auto & m : scriptpubkey_to_output) {
+        ret += m.second.capacity() * (sizeof(gs::utxo_key) + 1);
+    }
+    for (const gs::scriptpubkey & m : scripts.values) {
+        ret += m.v.capacity();
+    }
+
+    return ret;
+}
 
 std::vector<gs::output> utxodb::get_outputs_by_outpoints(
     const std::vector<gs::outpoint> outpoints
@@ -92,10 +247,10 @@ std::vector<gs::output> utxodb::get_outputs_by_outpoints(
     ret.reserve(outpoints.size()); // most of the time this will be same size
 
     for (auto o : outpoints) {
-        const auto outpoint_map_search = outpoint_map.find(o);
-        if (outpoint_map_search != outpoint_map.end()) {
+        gs::output found;
+        if (find_output(o, found)) {
             if (mempool_spent_confirmed_outpoints.count(o) == 0) {
-                ret.push_back(outpoint_map_search->second);
+                ret.push_back(std::move(found));
             }
         } else {
             const auto mempool_outpoint_map_search = mempool_outpoint_map.find(o);
@@ -116,12 +271,17 @@ std::vector<gs::output> utxodb::get_outputs_by_scriptpubkey(
 
     std::vector<gs::output> ret;
 
-    if (scriptpubkey_to_output.count(scriptpubkey) > 0) {
-        const absl::flat_hash_set<gs::output*>& pk_utxos = scriptpubkey_to_output.at(scriptpubkey);
-
-        for (const gs::output* u : pk_utxos) {
-            if (mempool_spent_confirmed_outpoints.count(gs::outpoint(u->prev_tx_id, u->prev_out_idx)) == 0) {
-                ret.push_back(*u);
+    gs::script_ref ref;
+    const auto addr_search = find_script_ref(scriptpubkey, ref)
+        ? scriptpubkey_to_output.find(ref)
+        : scriptpubkey_to_output.end();
+
+    if (addr_search != scriptpubkey_to_output.end()) {
+        for (const gs::utxo_key & k : addr_search->second) {
+            const gs::txid & txid = txids.get(k.tx);
+            if (mempool_spent_confirmed_outpoints.count(gs::outpoint(txid, k.vout)) == 0) {
+                // every output in the set has the script that was asked for
+                ret.emplace_back(txid, k.vout, outpoint_map.at(k).value, scriptpubkey);
                 if (ret.size() == limit) {
                     break;
                 }
@@ -150,12 +310,15 @@ std::uint64_t utxodb::get_balance_by_scriptpubkey(
 
     std::uint64_t ret = 0;
 
-    if (scriptpubkey_to_output.count(scriptpubkey) > 0) {
-        const absl::flat_hash_set<gs::output*>& pk_utxos = scriptpubkey_to_output.at(scriptpubkey);
+    gs::script_ref ref;
+    const auto addr_search = find_script_ref(scriptpubkey, ref)
+        ? scriptpubkey_to_output.find(ref)
+        : scriptpubkey_to_output.end();
 
-        for (const gs::output* u : pk_utxos) {
-            if (mempool_spent_confirmed_outpoints.count(gs::outpoint(u->prev_tx_id, u->prev_out_idx)) == 0) {
-                ret += u->value;
+    if (addr_search != scriptpubkey_to_output.end()) {
+        for (const gs::utxo_key & k : addr_search->second) {
+            if (mempool_spent_confirmed_outpoints.count(gs::outpoint(txids.get(k.tx), k.vout)) == 0) {
+                ret += outpoint_map.at(k).value;
             }
         }
     }
@@ -0,0 +1,317 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <limits>
+
+#include <boost/crc.hpp>
+#include <spdlog/spdlog.h>
+
+#include <gs++/wal.hpp>
+#include <gs++/bhash.hpp>
+
+namespace gs {
+
+namespace {
+
+constexpr std::size_t record_header_size = 1 + 4 + 4;
+
+std::uint32_t record_crc(const std::uint8_t type, const std::uint8_t* data, const std::size_t len)
+{
+    boost::crc_32_type crc;
+    crc.process_byte(type);
+    crc.process_bytes(data, len);
+    return crc.checksum();
+}
+
+// returns the records and the length of the intact prefix
+std::pair<std::vector<wal::record>, std::size_t> parse_records(const std::vector<std::uint8_t>& buf)
+{
+    std::vector<wal::record> records;
+    std::size_t pos = 0;
+
+    while (buf.size() - pos >= record_header_size) {
+        const std::uint8_t type = buf[pos];
+        std::uint32_t len;
+        std::uint32_t crc;
+        std::memcpy(&len, buf.data() + pos + 1, 4);
+        std::memcpy(&crc, buf.data() + pos + 5, 4);
+
+        const std::uint8_t* data = buf.data() + pos + record_header_size;
+        if (buf.size() - pos - record_header_size < len || record_crc(type, data, len) != crc) {
+            break;
+        }
+
+        wal::record r;
+        r.type = static_cast<wal::record_type>(type);
+        r.data.assign(data, data + len);
+        records.push_back(std::move(r));
+
+        pos += record_header_size + len;
+    }
+
+    return { std::move(records), pos };
+}
+
+std::pair<bool, std::vector<std::uint8_t>> read_file(const std::string& path)
+{
+    std::vector<std::uint8_t> buf;
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return { errno == ENOENT, buf };
+    }
+
+    std::uint8_t chunk[1 << 16];
+    while (true) {
+        const ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            ::close(fd);
+            return { false, buf };
+        }
+        if (n == 0) {
+            break;
+        }
+        buf.insert(buf.end(), chunk, chunk + n);
+    }
+    ::close(fd);
+
+    return { true, buf };
+}
+
+bool write_all(const int fd, const std::uint8_t* data, std::size_t len)
+{
+    while (len > 0) {
+        const ssize_t n = ::write(fd, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len  -= static_cast<std::size_t>(n);
+    }
+
+    return true;
+}
+
+}
+
+wal::~wal()
+{
+    close();
+}
+
+std::pair<bool, std::vector<wal::record>> wal::read(const std::string& path)
+{
+    const std::pair<bool, std::vector<std::uint8_t>> file = read_file(path);
+    if (! file.first) {
+        spdlog::error("wal: could not read {}", path);
+        return { false, {} };
+    }
+
+    auto parsed = parse_records(file.second);
+    if (parsed.second != file.second.size()) {
+        spdlog::warn("wal: ignoring {} bytes of torn tail", file.second.size() - parsed.second);
+    }
+
+    return { true, std::move(parsed.first) };
+}
+
+bool wal::open(const std::string& path)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+
+    if (fd != -1) {
+        return false;
+    }
+
+    const std::pair<bool, std::vector<std::uint8_t>> file = read_file(path);
+    if (! file.first) {
+        spdlog::error("wal: could not read {}", path);
+        return false;
+    }
+    const std::size_t valid_end = parse_records(file.second).second;
+
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd == -1) {
+        spdlog::error("wal: could not open {}: {}", path, std::strerror(errno));
+        return false;
+    }
+
+    // later records would be unreachable behind a torn one
+    if (valid_end != file.second.size() && ::ftruncate(fd, valid_end) != 0) {
+        spdlog::error("wal: could not truncate {}", path);
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    resets_done = resets;
+    failed   = false;
+    stopping = false;
+    flusher = std::thread([this] { flush_loop(); });
+
+    return true;
+}
+
+void wal::close()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+
+    if (flusher.joinable()) {
+        flusher.join();
+    }
+
+    boost::lock_guard<boost::mutex> lock(mtx);
+    if (fd != -1) {
+        ::close(fd);
+        fd = -1;
+    }
+    cv.notify_all();
+}
+
+void wal::append(const record_type type, const std::uint8_t* data, const std::size_t len)
+{
+    std::uint8_t header[record_header_size];
+    header[0] = static_cast<std::uint8_t>(type);
+    const std::uint32_t len32 = static_cast<std::uint32_t>(len);
+    const std::uint32_t crc   = record_crc(header[0], data, len);
+    std::memcpy(header + 1, &len32, 4);
+    std::memcpy(header + 5, &crc, 4);
+
+    boost::lock_guard<boost::mutex> lock(mtx);
+    if (fd == -1 || failed) {
+        return;
+    }
+
+    pending.insert(pending.end(), header, header + record_header_size);
+    pending.insert(pending.end(), data, data + len);
+    ++appended;
+}
+
+void wal::append_tx(const std::vector<std::uint8_t>& serialized)
+{
+    append(record_type::tx, serialized.data(), serialized.size());
+}
+
+void wal::append_block(const std::uint32_t height, const gs::blockhash& hash)
+{
+    std::uint8_t data[4 + 32];
+    std::memcpy(data, &height, 4);
+    std::copy(hash.v.begin(), hash.v.end(), data + 4);
+    append(record_type::block, data, sizeof(data));
+}
+
+std::pair<std::uint32_t, gs::blockhash> wal::decode_block(const record& r)
+{
+    std::uint32_t height = 0;
+    gs::blockhash hash;
+    if (r.type == record_type::block && r.data.size() == 4 + 32) {
+        std::memcpy(&height, r.data.data(), 4);
+        std::copy(r.data.begin() + 4, r.data.end(), hash.v.begin());
+    }
+
+    return { height, hash };
+}
+
+bool wal::sync()
+{
+    boost::unique_lock<boost::mutex> lock(mtx);
+    if (fd == -1) {
+        return false;
+    }
+
+    const std::uint64_t target       = appended;
+    const std::uint64_t reset_target = resets;
+    sync_target = std::max(sync_target, target);
+    cv.notify_all();
+    cv.wait(lock, [&] {
+        return (synced >= target && resets_done >= reset_target) || failed || fd == -1;
+    });
+
+    return synced >= target && resets_done >= reset_target && ! failed;
+}
+
+bool wal::reset()
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    if (fd == -1 || failed) {
+        return false;
+    }
+
+    // dropped records count as synced once the flusher has truncated
+    pending.clear();
+    ++resets;
+
+    return true;
+}
+
+void wal::flush_loop()
+{
+    std::vector<std::uint8_t> buf;
+    bool truncate;
+    std::uint64_t target;
+    std::uint64_t reset_target;
+
+    while (true) {
+        {
+            boost::unique_lock<boost::mutex> lock(mtx);
+            cv.timed_wait(lock, boost::posix_time::milliseconds(sync_interval.count()), [this] {
+                return stopping || sync_target > synced || resets > resets_done;
+            });
+
+            if (pending.empty() && resets == resets_done) {
+                if (stopping) {
+                    return;
+                }
+                continue;
+            }
+
+            buf.swap(pending);
+            truncate     = resets > resets_done;
+            reset_target = resets;
+            target       = appended;
+        }
+
+        // appends are O_APPEND so they land at the start again after truncating
+        bool written = ! truncate || ::ftruncate(fd, 0) == 0;
+        written = written
+            && (buf.empty() || write_all(fd, buf.data(), buf.size()))
+            && ::fdatasync(fd) == 0;
+        buf.clear();
+
+        boost::unique_lock<boost::mutex> lock(mtx);
+        if (written) {
+            synced      = std::max(synced, target);
+            resets_done = reset_target;
+            cv.notify_all();
+            continue;
+        }
+
+        // the file may end in a partial record now, which read drops as a torn tail
+        // writing after it would leave those records unreachable
+        spdlog::error("wal: write failed, no longer logging: {}", std::strerror(errno));
+        failed = true;
+        pending.clear();
+        cv.notify_all();
+        cv.wait(lock, [this] { return stopping; });
+        return;
+    }
+}
+
+}
@@ -3,7 +3,15 @@
 #include <string>
 #include <fstream>
 #include <streambuf>
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <thread>
 #include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
 #include <vector>
 #include <string>
 
@@ -18,6 +26,22 @@
 #include <gs++/slp_transaction.hpp>
 #include <gs++/slp_validator.hpp>
 #include <gs++/bch.hpp>
+#include <gs++/lru_cache.hpp>
+#include <gs++/orphan_pool.hpp>
+#include <gs++/prefetcher.hpp>
+#include <gs++/worker_pool.hpp>
+#include <gs++/hash.hpp>
+#include <gs++/hex.hpp>
+#include <gs++/block_pack.hpp>
+#include <gs++/snapshot.hpp>
+#include <gs++/wal.hpp>
+#include <gs++/ingest_queue.hpp>
+#include <gs++/reorg_journal.hpp>
+#include <gs++/utxo_undo.hpp>
+#include <gs++/utxo_checkpoint.hpp>
+#include <gs++/ecmh.hpp>
+#include <gs++/compact_utxo.hpp>
+#include <gs++/block.hpp>
 
 
 int create_txgraph()
@@ -177,6 +201,82 @@ TEST_CASE( "slp_decoding_tx_tests", "[single-file]" ) {
     }
 }
 
+TEST_CASE( "slp_parser_reference", "[single-file]" ) {
+	std::ifstream test_data_stream("../test/slp_decoding_tx_tests.json");
+	std::string test_data_str((std::istreambuf_iterator<char>(test_data_stream)),
+							   std::istreambuf_iterator<char>());
+
+	auto test_data = nlohmann::json::parse(test_data_str);
+
+    auto require_same_parse = [](const std::vector<std::uint8_t>& script) {
+        const gs::scriptpubkey scriptpubkey(script);
+
+        gs::slp_transaction a;
+        gs::slp_transaction b;
+        a.token_type = b.token_type = 0;
+
+        REQUIRE( a.hydrate(scriptpubkey) == b.hydrate_reference(scriptpubkey) );
+        REQUIRE( a.type       == b.type );
+        REQUIRE( a.token_type == b.token_type );
+        REQUIRE( a.tokenid    == b.tokenid );
+
+        if (a.type == gs::slp_transaction_type::genesis) {
+            const auto & x = absl::get<gs::slp_transaction_genesis>(a.slp_tx);
+            const auto & y = absl::get<gs::slp_transaction_genesis>(b.slp_tx);
+            REQUIRE( x.ticker          == y.ticker );
+            REQUIRE( x.name            == y.name );
+            REQUIRE( x.document_uri    == y.document_uri );
+            REQUIRE( x.document_hash   == y.document_hash );
+            REQUIRE( x.decimals        == y.decimals );
+            REQUIRE( x.has_mint_baton  == y.has_mint_baton );
+            REQUIRE( x.mint_baton_vout == y.mint_baton_vout );
+            REQUIRE( x.qty             == y.qty );
+        }
+        else if (a.type == gs::slp_transaction_type::mint) {
+            const auto & x = absl::get<gs::slp_transaction_mint>(a.slp_tx);
+            const auto & y = absl::get<gs::slp_transaction_mint>(b.slp_tx);
+            REQUIRE( x.has_mint_baton  == y.has_mint_baton );
+            REQUIRE( x.mint_baton_vout == y.mint_baton_vout );
+            REQUIRE( x.qty             == y.qty );
+        }
+        else if (a.type == gs::slp_transaction_type::send) {
+            const auto & x = absl::get<gs::slp_transaction_send>(a.slp_tx);
+            const auto & y = absl::get<gs::slp_transaction_send>(b.slp_tx);
+            REQUIRE( x.amounts == y.amounts );
+        }
+    };
+
+    SECTION("\tcorpus scripts parse the same") {
+        for (auto m : test_data) {
+            require_same_parse(gs::util::unhex(m["script"].get<std::string>()));
+        }
+    }
+
+    SECTION("\ttruncated scripts parse the same") {
+        for (auto m : test_data) {
+            const std::vector<std::uint8_t> script = gs::util::unhex(m["script"].get<std::string>());
+            for (std::size_t i=0; i<script.size(); ++i) {
+                require_same_parse(std::vector<std::uint8_t>(script.begin(), script.begin()+i));
+            }
+        }
+    }
+
+    SECTION("\tmutated scripts parse the same") {
+        const std::uint8_t replacements[] = { 0x00, 0x01, 0x02, 0x04, 0x08, 0x20, 0x41, 0x4C, 0x4D, 0x4E, 0x81, 0xFF };
+
+        for (auto m : test_data) {
+            const std::vector<std::uint8_t> script = gs::util::unhex(m["script"].get<std::string>());
+            for (std::size_t i=0; i<script.size(); ++i) {
+                for (const std::uint8_t r : replacements) {
+                    std::vector<std::uint8_t> mutated = script;
+                    mutated[i] = r;
+                    require_same_parse(mutated);
+                }
+            }
+        }
+    }
+}
+
 TEST_CASE( "bch_decoding_tx_to_slp_tests", "[single-file]" ) {
 	std::ifstream test_data_stream("../test/bch_decoding_tx_to_slp_tests.json");
 	std::string test_data_str((std::istreambuf_iterator<char>(test_data_stream)),
@@ -305,6 +405,51 @@ TEST_CASE( "topological_sorting", "[single-file]" ) {
     }
 }
 
+TEST_CASE( "topological_order", "[single-file]" ) {
+    auto make_txid = [](const std::uint32_t n) {
+        gs::txid txid;
+        txid.v.fill(0);
+        std::memcpy(txid.v.data(), &n, sizeof(n));
+        return txid;
+    };
+
+    // deep enough to overflow the stack with a recursive sort
+    const std::uint32_t chain_len = 200000;
+
+    std::vector<gs::transaction> chain(chain_len);
+    for (std::uint32_t i=0; i<chain_len; ++i) {
+        gs::transaction & tx = chain[chain_len - 1 - i];
+        tx.txid = make_txid(i);
+        if (i > 0) {
+            tx.inputs.emplace_back(make_txid(i - 1), 0);
+        }
+    }
+
+    SECTION ("\treversed chain sorts parents first") {
+        const std::vector<std::size_t> order = gs::util::topological_order(chain);
+        REQUIRE( order.size() == chain_len );
+        for (std::size_t i=0; i<order.size(); ++i) {
+            REQUIRE( order[i] == chain_len - 1 - i );
+        }
+
+        const std::vector<gs::transaction> sorted = gs::util::topological_sort(std::move(chain));
+        REQUIRE( sorted.size() == chain_len );
+        REQUIRE( sorted.front().txid == make_txid(0) );
+        REQUIRE( sorted.back().txid  == make_txid(chain_len - 1) );
+    }
+
+    SECTION ("\tsorted input keeps its order and duplicates are dropped") {
+        std::vector<gs::transaction> txs(chain.rbegin(), chain.rbegin() + 10);
+        txs.push_back(txs[3]);
+
+        const std::vector<std::size_t> order = gs::util::topological_order(txs);
+        REQUIRE( order.size() == 10 );
+        for (std::size_t i=0; i<order.size(); ++i) {
+            REQUIRE( order[i] == i );
+        }
+    }
+}
+
 TEST_CASE( "varint_encode", "[single-file]" ) {
     SECTION ("\ttest equality <= 0xFC") {
         std::vector<std::uint8_t> data; auto it = data.begin();
@@ -359,3 +504,1446 @@ TEST_CASE( "varint_encode", "[single-file]" ) {
         REQUIRE (data == gs::util::num_to_var_int(gs::util::extract_var_int(it)));
     }
 }
+
+TEST_CASE( "lru_cache", "[single-file]" ) {
+    gs::lru_cache<int, std::string> cache(2);
+    std::string v;
+
+    SECTION ("\tevicts least recently used") {
+        cache.put(1, "a");
+        cache.put(2, "b");
+        REQUIRE( cache.get(1, v) );
+        REQUIRE( v == "a" );
+
+        cache.put(3, "c");
+        REQUIRE( cache.size() == 2 );
+        REQUIRE( ! cache.get(2, v) );
+        REQUIRE( cache.get(1, v) );
+        REQUIRE( cache.get(3, v) );
+        REQUIRE( v == "c" );
+    }
+
+    SECTION ("\tclear removes everything") {
+        cache.put(1, "a");
+        cache.clear();
+        REQUIRE( cache.size() == 0 );
+        REQUIRE( ! cache.get(1, v) );
+    }
+}
+
+TEST_CASE( "orphan_pool", "[single-file]" ) {
+    gs::orphan_pool pool(2, 60);
+
+    auto make_tx = [](const std::uint8_t id) {
+        gs::transaction tx;
+        tx.txid.v[0] = id;
+        return tx;
+    };
+    auto make_txid = [](const std::uint8_t id) {
+        gs::txid txid;
+        txid.v[0] = id;
+        return txid;
+    };
+
+    SECTION ("\tchildren are released by parent") {
+        REQUIRE( pool.add(make_tx(1), { make_txid(10), make_txid(11) }, 0) );
+        REQUIRE( pool.add(make_tx(2), { make_txid(10) }, 0) );
+        REQUIRE( pool.take_children(make_txid(11)).size() == 1 );
+        REQUIRE( ! pool.has(make_txid(1)) );
+        REQUIRE( pool.take_children(make_txid(10)).size() == 1 );
+        REQUIRE( pool.size() == 0 );
+        REQUIRE( pool.by_parent.empty() );
+    }
+
+    SECTION ("\tno missing parents is rejected") {
+        REQUIRE( ! pool.add(make_tx(1), {}, 0) );
+    }
+
+    SECTION ("\toldest is evicted when full") {
+        REQUIRE( pool.add(make_tx(1), { make_txid(10) }, 0) );
+        REQUIRE( pool.add(make_tx(2), { make_txid(10) }, 1) );
+        REQUIRE( pool.add(make_tx(3), { make_txid(10) }, 2) );
+        REQUIRE( pool.size() == 2 );
+        REQUIRE( ! pool.has(make_txid(1)) );
+    }
+
+    SECTION ("\texpiry drops old orphans") {
+        REQUIRE( pool.add(make_tx(1), { make_txid(10) }, 0) );
+        REQUIRE( pool.add(make_tx(2), { make_txid(10) }, 30) );
+        REQUIRE( pool.expire(60) == 1 );
+        REQUIRE( pool.has(make_txid(2)) );
+        REQUIRE( pool.expire(90) == 1 );
+        REQUIRE( pool.size() == 0 );
+    }
+}
+
+TEST_CASE( "prefetcher", "[single-file]" ) {
+    SECTION ("\tresults come out in height order") {
+        std::atomic<std::uint32_t> max_seen { 0 };
+        std::atomic<std::uint32_t> delivered { 100 };
+        std::atomic<bool> outside_window { false };
+
+        gs::prefetcher<std::uint32_t> p(100, 300, 8, 4, [&](const std::uint32_t height) {
+            // later heights finish first
+            std::this_thread::sleep_for(std::chrono::microseconds((height % 5) * 200));
+
+            std::uint32_t seen = max_seen;
+            while (height > seen && ! max_seen.compare_exchange_weak(seen, height)) {}
+            // delivered lags next() by one height
+            if (height > delivered + 8) {
+                outside_window = true;
+            }
+
+            return std::make_pair(true, height * 2);
+        });
+
+        for (std::uint32_t h=100; h<=300; ++h) {
+            REQUIRE( p.next_height() == h );
+            const std::pair<bool, std::uint32_t> r = p.next();
+            REQUIRE( r.first );
+            REQUIRE( r.second == h * 2 );
+            delivered = h + 1;
+        }
+
+        REQUIRE( ! p.next().first );
+        REQUIRE( max_seen == 300 );
+        REQUIRE( ! outside_window );
+        // 4 in 5 fetches sleep at least 200us
+        REQUIRE( p.busy_us().first >= 160 * 200 );
+    }
+
+    SECTION ("\tfailure stops delivery at the failed height") {
+        gs::prefetcher<std::uint32_t> p(0, 100, 4, 2, [](const std::uint32_t height) {
+            return std::make_pair(height != 10, height);
+        });
+
+        for (std::uint32_t h=0; h<10; ++h) {
+            REQUIRE( p.next().first );
+        }
+        REQUIRE( ! p.next().first );
+        REQUIRE( ! p.next().first );
+        REQUIRE( p.next_height() == 10 );
+    }
+}
+
+TEST_CASE( "slp_validator_pruning", "[single-file]" ) {
+    gs::slp_validator validator;
+    validator.pruning = true;
+
+    gs::tokenid tokenid;
+    tokenid.v[0] = 1;
+
+    auto make_send = [&](const std::uint8_t id, const std::vector<gs::outpoint>& inputs, const std::vector<std::uint64_t>& amounts) {
+        gs::transaction tx;
+        tx.txid.v[0] = id;
+        tx.inputs = inputs;
+        tx.outputs.resize(amounts.size() + 1);
+        tx.slp = gs::slp_transaction(gs::slp_transaction_send(amounts));
+        tx.slp.tokenid = tokenid;
+        tx.slp.token_type = 0x01;
+        return tx;
+    };
+
+    const gs::transaction parent = make_send(1, {}, { 5, 5 });
+    REQUIRE( validator.add_assumed_valid_tx(parent) );
+    REQUIRE( validator.unspent_outputs.at(parent.txid).size() == 2 );
+
+    SECTION ("\tpartially spent is kept") {
+        validator.spend_inputs(make_send(2, { gs::outpoint(parent.txid, 1) }, { 5 }), 100);
+        REQUIRE( validator.prune(200) == 0 );
+        REQUIRE( validator.has_valid(parent.txid) );
+    }
+
+    SECTION ("\tfully spent is pruned once deep enough") {
+        const gs::transaction child = make_send(2, { gs::outpoint(parent.txid, 1), gs::outpoint(parent.txid, 2) }, { 10 });
+        validator.spend_inputs(child, 100);
+        REQUIRE( validator.add_tx(child) );
+        REQUIRE( validator.prune(99) == 0 );
+        REQUIRE( validator.prune(100) == 1 );
+        REQUIRE( ! validator.has(parent.txid) );
+        REQUIRE( ! validator.has_valid(parent.txid) );
+        REQUIRE( validator.has_valid(child.txid) );
+    }
+
+    SECTION ("\tburned by a transaction we do not keep") {
+        const std::vector<gs::outpoint> inputs { gs::outpoint(parent.txid, 1), gs::outpoint(parent.txid, 2) };
+        REQUIRE( validator.spend_inputs(inputs, 100).size() == 2 );
+        REQUIRE( validator.spend_inputs(inputs, 100).empty() );
+        REQUIRE( validator.prune(100) == 1 );
+        REQUIRE( ! validator.has(parent.txid) );
+    }
+}
+
+TEST_CASE( "slp_validator_missing_token_parents", "[single-file]" ) {
+    gs::slp_validator validator;
+
+    gs::tokenid tokenid;
+    tokenid.v[0] = 1;
+
+    auto make_send = [&](const std::uint8_t id, const std::vector<gs::outpoint>& inputs, const std::vector<std::uint64_t>& amounts) {
+        gs::transaction tx;
+        tx.txid.v[0] = id;
+        tx.inputs = inputs;
+        tx.outputs.resize(amounts.size() + 1);
+        tx.slp = gs::slp_transaction(gs::slp_transaction_send(amounts));
+        tx.slp.tokenid = tokenid;
+        tx.slp.token_type = 0x01;
+        return tx;
+    };
+    auto make_txid = [](const std::uint8_t id) {
+        gs::txid txid;
+        txid.v[0] = id;
+        return txid;
+    };
+
+    const gs::transaction parent = make_send(1, {}, { 5, 5 });
+    REQUIRE( validator.add_assumed_valid_tx(parent) );
+
+    // txids 100 and up stand for plain bch transactions
+    auto is_known = [](const gs::outpoint& o) { return o.txid.v[0] >= 100; };
+
+    SECTION ("\tsend with only bch parents is rejected") {
+        const gs::transaction tx = make_send(2, { gs::outpoint(make_txid(100), 0), gs::outpoint(make_txid(101), 1) }, { 5 });
+        REQUIRE( ! validator.add_tx(tx) );
+        REQUIRE( validator.missing_token_parents(tx, is_known).empty() );
+    }
+
+    SECTION ("\tsend short of token input waits on unknown parents") {
+        const gs::transaction tx = make_send(2, {
+            gs::outpoint(parent.txid, 1),
+            gs::outpoint(make_txid(50), 0),
+            gs::outpoint(make_txid(100), 0)
+        }, { 8 });
+        REQUIRE( ! validator.add_tx(tx) );
+        REQUIRE( validator.missing_token_parents(tx, is_known) == std::vector<gs::txid>({ make_txid(50) }) );
+    }
+
+    SECTION ("\tmint waits on its baton only while it is unknown") {
+        gs::transaction tx;
+        tx.txid.v[0] = 2;
+        tx.inputs = { gs::outpoint(make_txid(100), 0) };
+        tx.outputs.resize(2);
+        tx.slp = gs::slp_transaction(gs::slp_transaction_mint(false, 0, 10));
+        tx.slp.tokenid = tokenid;
+        tx.slp.token_type = 0x01;
+        REQUIRE( ! validator.add_tx(tx) );
+        REQUIRE( validator.missing_token_parents(tx, is_known).empty() );
+
+        tx.inputs.emplace_back(make_txid(50), 2);
+        REQUIRE( validator.missing_token_parents(tx, is_known) == std::vector<gs::txid>({ make_txid(50) }) );
+    }
+}
+
+TEST_CASE( "transaction_view", "[single-file]" ) {
+	std::ifstream test_data_stream("../test/bch_decoding_tx_to_slp_tests.json");
+	std::string test_data_str((std::istreambuf_iterator<char>(test_data_stream)),
+							   std::istreambuf_iterator<char>());
+
+	auto test_data = nlohmann::json::parse(test_data_str);
+
+    for (auto m : test_data) {
+        SECTION(m["msg"].get<std::string>()) {
+            for (auto& j_tx : m["transactions"]) {
+                const std::vector<std::uint8_t> txhex = gs::util::unhex(j_tx.get<std::string>());
+                gs::transaction tx;
+                REQUIRE( tx.hydrate(txhex.begin(), txhex.end()) );
+
+                gs::transaction_view view;
+                REQUIRE( view.parse(txhex.data(), txhex.data() + txhex.size()) );
+                REQUIRE( view.size == tx.serialized.size() );
+                REQUIRE( view.compute_txid() == tx.txid );
+
+                gs::transaction mtx;
+                view.materialize(mtx);
+                REQUIRE( mtx.serialized == tx.serialized );
+                REQUIRE( mtx.inputs.size() == tx.inputs.size() );
+                for (std::size_t i=0; i<tx.inputs.size(); ++i) {
+                    REQUIRE( mtx.inputs[i] == tx.inputs[i] );
+                }
+                REQUIRE( mtx.outputs.size() == tx.outputs.size() );
+                for (std::size_t i=0; i<tx.outputs.size(); ++i) {
+                    REQUIRE( mtx.outputs[i].value == tx.outputs[i].value );
+                    REQUIRE( mtx.outputs[i].scriptpubkey == tx.outputs[i].scriptpubkey );
+                }
+                REQUIRE( mtx.slp.type == tx.slp.type );
+                REQUIRE( mtx.slp.tokenid == tx.slp.tokenid );
+                if (tx.slp.type != gs::slp_transaction_type::invalid) {
+                    REQUIRE( view.slp_candidate() );
+                }
+
+                // every truncation must be rejected like hydrate does
+                for (std::size_t len=0; len<txhex.size(); len += 7) {
+                    gs::transaction ttx;
+                    gs::transaction_view tview;
+                    REQUIRE( tview.parse(txhex.data(), txhex.data() + len)
+                          == ttx.hydrate(txhex.begin(), txhex.begin() + len) );
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE( "sha256d", "[single-file]" ) {
+    // covers every padding case and leaves avx2 lanes partly filled
+    std::vector<std::vector<std::uint8_t>> msgs;
+    for (std::size_t len=0; len<=200; ++len) {
+        std::vector<std::uint8_t> m(len);
+        for (std::size_t i=0; i<len; ++i) {
+            m[i] = static_cast<std::uint8_t>(i * 31 + len);
+        }
+        msgs.push_back(m);
+    }
+
+    std::vector<const std::uint8_t *> datas;
+    std::vector<std::size_t> lens;
+    for (const auto & m : msgs) {
+        datas.push_back(m.data());
+        lens.push_back(m.size());
+    }
+
+    std::vector<std::uint8_t> reference(msgs.size() * 32);
+    gs::sha256d_many(datas.data(), lens.data(), msgs.size(), reference.data(), gs::sha256_impl::generic);
+
+    SECTION ("\tempty message") {
+        REQUIRE( gs::util::hex(std::vector<std::uint8_t>(reference.begin(), reference.begin() + 32))
+              == "5df6e0e2761359d30a8275058e299fcc0381534545f55cf43e41983f5d4c9456" );
+    }
+
+    for (const gs::sha256_impl impl : { gs::sha256_impl::shani, gs::sha256_impl::avx2 }) {
+        if (! gs::sha256_supported(impl)) {
+            continue;
+        }
+
+        SECTION (std::string("\t") + gs::sha256_impl_name(impl)) {
+            std::vector<std::uint8_t> out(msgs.size() * 32);
+            gs::sha256d_many(datas.data(), lens.data(), msgs.size(), out.data(), impl);
+            REQUIRE( out == reference );
+        }
+    }
+}
+
+TEST_CASE( "block_decode", "[single-file]" ) {
+	std::ifstream test_data_stream("../test/bch_decoding_tx_to_slp_tests.json");
+	std::string test_data_str((std::istreambuf_iterator<char>(test_data_stream)),
+							   std::istreambuf_iterator<char>());
+
+	auto test_data = nlohmann::json::parse(test_data_str);
+
+    gs::block src;
+    src.version   = 1;
+    src.timestamp = 2;
+    src.bits      = 3;
+    src.nonce     = 4;
+    for (auto m : test_data) {
+        for (auto& j_tx : m["transactions"]) {
+            const std::vector<std::uint8_t> txhex = gs::util::unhex(j_tx.get<std::string>());
+            gs::transaction tx;
+            REQUIRE( tx.hydrate(txhex.begin(), txhex.end()) );
+            src.txs.push_back(tx);
+        }
+    }
+    REQUIRE( src.txs.size() > 1 );
+
+    const std::vector<std::uint8_t> serialized = src.serialize();
+
+    SECTION ("\thydrate round trips") {
+        gs::block block;
+        REQUIRE( block.hydrate(serialized.begin(), serialized.end()) );
+        REQUIRE( block.txs.size() == src.txs.size() );
+        for (std::size_t i=0; i<src.txs.size(); ++i) {
+            REQUIRE( block.txs[i].txid == src.txs[i].txid );
+        }
+        REQUIRE( block.serialize() == serialized );
+    }
+
+    SECTION ("\tvisitor can stop early") {
+        gs::block block;
+        std::size_t visited = 0;
+        REQUIRE( block.decode(serialized.begin(), serialized.end(), [&](gs::transaction&&) {
+            ++visited;
+            return false;
+        }) );
+        REQUIRE( visited == 1 );
+        REQUIRE( block.txs.empty() );
+        REQUIRE( block.nonce == 4 );
+    }
+
+    SECTION ("\tslp_only keeps the inputs of skipped transactions") {
+        // version, one input of txid 11.. vout 3 with empty sigscript, one OP_TRUE output, lock time
+        std::vector<std::uint8_t> bch_txdata { 1, 0, 0, 0, 1 };
+        bch_txdata.insert(bch_txdata.end(), 32, 0x11);
+        bch_txdata.insert(bch_txdata.end(), { 3, 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF, 1 });
+        bch_txdata.insert(bch_txdata.end(), { 0xE8, 0x03, 0, 0, 0, 0, 0, 0, 1, 0x51, 0, 0, 0, 0 });
+        gs::transaction bch_tx;
+        REQUIRE( bch_tx.hydrate(bch_txdata.begin(), bch_txdata.end()) );
+
+        gs::block mixed = src;
+        mixed.txs.insert(mixed.txs.begin() + 1, bch_tx);
+        const std::vector<std::uint8_t> mixed_serialized = mixed.serialize();
+
+        std::vector<gs::outpoint> expected;
+        std::size_t kept = 0;
+        for (const gs::transaction & tx : mixed.txs) {
+            if (tx.slp.type == gs::slp_transaction_type::invalid) {
+                expected.insert(expected.end(), tx.inputs.begin(), tx.inputs.end());
+            } else {
+                ++kept;
+            }
+        }
+        REQUIRE( ! expected.empty() );
+
+        gs::block block;
+        REQUIRE( block.hydrate(mixed_serialized.begin(), mixed_serialized.end(), true) );
+        REQUIRE( block.txs.size() == kept );
+        REQUIRE( block.skipped_inputs == expected );
+        REQUIRE( block.skipped_inputs.back() == gs::outpoint(bch_tx.inputs[0].txid, 3) );
+    }
+
+    SECTION ("\ttruncated block fails") {
+        gs::block block;
+        REQUIRE( ! block.hydrate(serialized.begin(), serialized.end() - 5) );
+    }
+}
+
+TEST_CASE( "hex_decode", "[single-file]" ) {
+    std::vector<std::uint8_t> bytes(300);
+    for (std::size_t i=0; i<bytes.size(); ++i) {
+        bytes[i] = (i * 167 + 13) & 0xFF;
+    }
+    const std::string lower = gs::util::hex(bytes);
+    std::string upper = lower;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+    for (const gs::hex_impl impl : { gs::hex_impl::generic, gs::hex_impl::ssse3, gs::hex_impl::avx2 }) {
+        if (! gs::hex_supported(impl)) {
+            continue;
+        }
+
+        SECTION (std::string("\t") + gs::hex_impl_name(impl) + " decodes every length and case") {
+            for (std::size_t len=0; len<=lower.size(); len+=2) {
+                std::vector<std::uint8_t> out(len / 2);
+                REQUIRE( gs::hex_decode(lower.data(), len, out.data(), impl) );
+                REQUIRE( std::equal(out.begin(), out.end(), bytes.begin()) );
+                REQUIRE( gs::hex_decode(upper.data(), len, out.data(), impl) );
+                REQUIRE( std::equal(out.begin(), out.end(), bytes.begin()) );
+            }
+            REQUIRE( gs::util::unhex(lower) == bytes );
+        }
+
+        SECTION (std::string("\t") + gs::hex_impl_name(impl) + " rejects non hex") {
+            std::vector<std::uint8_t> out(lower.size() / 2);
+            REQUIRE( ! gs::hex_decode(lower.data(), lower.size() - 1, out.data(), impl) );
+
+            const char bad[] = { 'g', 'G', '/', ':', '@', '`', '"', '\\', ' ', '\0', 0x10, 0x19, 0x41 - 0x20, char(0xB0) };
+            for (std::size_t pos=0; pos<lower.size(); pos+=7) {
+                for (const char c : bad) {
+                    std::string s = lower;
+                    s[pos] = c;
+                    REQUIRE( ! gs::hex_decode(s.data(), s.size(), out.data(), impl) );
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE( "json_rpc_result_string", "[single-file]" ) {
+    auto result_of = [](const std::string & body) -> std::string {
+        const auto r = gs::util::json_rpc_result_string(body);
+        return r.first ? body.substr(r.second.first, r.second.second) : "FAIL";
+    };
+
+    SECTION ("\tfinds result in any key order") {
+        REQUIRE( result_of("[{\"result\":\"00ff\",\"error\":null,\"id\":0}]") == "00ff" );
+        REQUIRE( result_of("[{\"id\":0,\"error\":null,\"result\":\"abcd\"}]\n") == "abcd" );
+        REQUIRE( result_of(" [ { \"result\" : \"\" , \"error\" : null , \"id\" : \"x\" } ] ") == "" );
+    }
+
+    SECTION ("\tfails on errors and unexpected replies") {
+        REQUIRE( result_of("[{\"result\":null,\"error\":{\"code\":-5,\"message\":\"Block not found\"},\"id\":0}]") == "FAIL" );
+        REQUIRE( result_of("[{\"result\":{\"blocks\":1},\"error\":null,\"id\":0}]") == "FAIL" );
+        REQUIRE( result_of("[{\"error\":null,\"id\":0}]") == "FAIL" );
+        REQUIRE( result_of("{\"result\":\"00\",\"error\":null,\"id\":0}") == "FAIL" );
+        REQUIRE( result_of("[{\"result\":\"00\",\"error\":null,\"id\":0}") == "FAIL" );
+        REQUIRE( result_of("[{\"result\":\"0\\\"0\",\"error\":null,\"id\":0}]") == "FAIL" );
+        REQUIRE( result_of("") == "FAIL" );
+    }
+}
+
+TEST_CASE( "block_pack", "[single-file]" ) {
+    const boost::filesystem::path dir = boost::filesystem::temp_directory_path()
+                                      / boost::filesystem::unique_path("gs-block-pack-%%%%-%%%%");
+
+    auto block_data = [](const std::uint32_t height) {
+        std::vector<std::uint8_t> data(100 + (height * 37) % 300);
+        for (std::size_t i=0; i<data.size(); ++i) {
+            data[i] = static_cast<std::uint8_t>(height * 7 + i);
+        }
+        return data;
+    };
+
+    auto block_hash = [](const std::uint32_t height) {
+        gs::blockhash hash;
+        hash.v[0] = static_cast<std::uint8_t>(height);
+        hash.v[31] = static_cast<std::uint8_t>(height >> 8);
+        return hash;
+    };
+
+    auto matches = [&](gs::block_pack & pack, const std::uint32_t height) {
+        const auto r = pack.read(height);
+        const std::vector<std::uint8_t> data = block_data(height);
+        return r.first
+            && r.second.second == data.size()
+            && std::equal(data.begin(), data.end(), r.second.first);
+    };
+
+    {
+        gs::block_pack pack(4096);
+        REQUIRE( pack.open(dir.string()) );
+        for (std::uint32_t h=0; h<100; ++h) {
+            const std::vector<std::uint8_t> data = block_data(h);
+            REQUIRE( pack.append(h, block_hash(h), data.data(), data.size()) );
+        }
+        // the active segment can be read while it is appended to
+        REQUIRE( matches(pack, 99) );
+        const std::vector<std::uint8_t> big(10000, 0xab);
+        REQUIRE( pack.append(100, block_hash(100), big.data(), big.size()) );
+        REQUIRE( pack.read(100).first );
+        REQUIRE( pack.contiguous_until(0) == 100 );
+    }
+
+    SECTION ("\treopened pack serves every block") {
+        gs::block_pack pack(4096);
+        REQUIRE( pack.open(dir.string()) );
+        REQUIRE( pack.size() == 101 );
+        REQUIRE( boost::filesystem::exists(gs::block_pack::segment_path(dir.string(), 5)) );
+        for (std::uint32_t h=0; h<100; ++h) {
+            REQUIRE( matches(pack, h) );
+            REQUIRE( pack.find(h).second.hash == block_hash(h) );
+        }
+        REQUIRE( ! pack.has(101) );
+        REQUIRE( pack.contiguous_until(101) == 100 );
+    }
+
+    SECTION ("\tlatest append of a height wins") {
+        {
+            gs::block_pack pack(4096);
+            REQUIRE( pack.open(dir.string()) );
+            const std::vector<std::uint8_t> data = block_data(5000);
+            REQUIRE( pack.append(7, block_hash(5000), data.data(), data.size()) );
+        }
+        gs::block_pack pack(4096);
+        REQUIRE( pack.open(dir.string()) );
+        REQUIRE( pack.find(7).second.hash == block_hash(5000) );
+        REQUIRE( pack.read(7).second.second == block_data(5000).size() );
+    }
+
+    SECTION ("\tdropped blocks stay dropped after reopen") {
+        {
+            gs::block_pack pack(4096);
+            REQUIRE( pack.open(dir.string()) );
+            REQUIRE( pack.drop_above(90) );
+            REQUIRE( ! pack.has(91) );
+            REQUIRE( pack.contiguous_until(0) == 90 );
+
+            // the new branch is appended over the dropped heights
+            const std::vector<std::uint8_t> data = block_data(5000);
+            REQUIRE( pack.append(91, block_hash(5000), data.data(), data.size()) );
+        }
+        gs::block_pack pack(4096);
+        REQUIRE( pack.open(dir.string()) );
+        REQUIRE( pack.size() == 92 );
+        REQUIRE( pack.find(91).second.hash == block_hash(5000) );
+        REQUIRE( ! pack.has(92) );
+        REQUIRE( pack.contiguous_until(0) == 91 );
+        REQUIRE( matches(pack, 90) );
+    }
+
+    SECTION ("\ttorn index tail is dropped") {
+        const std::string index = gs::block_pack::index_path(dir.string());
+        const std::uintmax_t full = boost::filesystem::file_size(index);
+        boost::filesystem::resize_file(index, full - 10);
+
+        gs::block_pack pack(4096);
+        REQUIRE( pack.open(dir.string()) );
+        REQUIRE( pack.size() == 100 );
+        REQUIRE( ! pack.has(100) );
+        REQUIRE( boost::filesystem::file_size(index) == full - gs::block_pack::entry_size );
+        REQUIRE( matches(pack, 99) );
+
+        // appends continue cleanly after the dropped entry
+        const std::vector<std::uint8_t> data = block_data(100);
+        REQUIRE( pack.append(100, block_hash(100), data.data(), data.size()) );
+        REQUIRE( matches(pack, 100) );
+    }
+
+    SECTION ("\tcorrupt block data fails its checksum") {
+        std::uint64_t offset = 0;
+        std::string segment;
+        {
+            gs::block_pack pack(4096);
+            REQUIRE( pack.open(dir.string()) );
+            const auto e = pack.find(42).second;
+            offset = e.offset;
+            segment = gs::block_pack::segment_path(dir.string(), e.segment);
+        }
+        {
+            std::fstream f(segment, std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(offset + 3);
+            f.put(static_cast<char>(0xff ^ block_data(42)[3]));
+        }
+
+        gs::block_pack pack(4096);
+        REQUIRE( pack.open(dir.string()) );
+        REQUIRE( pack.has(42) );
+        REQUIRE( ! pack.read(42).first );
+        REQUIRE( matches(pack, 41) );
+        REQUIRE( matches(pack, 43) );
+    }
+
+    boost::filesystem::remove_all(dir);
+}
+
+TEST_CASE( "snapshot", "[single-file]" ) {
+    const std::string path = (
+        boost::filesystem::temp_directory_path()
+      / boost::filesystem::unique_path("gs-snapshot-%%%%-%%%%")
+    ).string();
+
+    const std::vector<std::uint8_t> txdata = gs::util::unhex(std::string("0200000002168bef68766234af97c65c60f2891be0bc8bbc2894f6517b9a216da95ba12c1f020000006a47304402206fcbf79712d6c84f4367c0ba6d7ec27f4d4690dd65d8c4e49cfe7f543a515736022007d7b4fb3f6315e432c673a8793dc1a7ccbd1e73eeba6498bb636ed409daa0c941210350090260acd0cd7a5f7030b2aad76ec6454626ab0872246031f3809d210e4569ffffffff168bef68766234af97c65c60f2891be0bc8bbc2894f6517b9a216da95ba12c1f030000006b483045022100dabdf03df22031dc386761aa40e15dbb654a42e8dc27803f2de9eda2651236cd02205321628ad9d75dc76d16365cb77c2fa75d03a2497a116b23230eebed2f23f9d741210350090260acd0cd7a5f7030b2aad76ec6454626ab0872246031f3809d210e4569ffffffff040000000000000000406a04534c500001010453454e44207f8889682d57369ed0e32336f8b7e0ffec625a35cca183f4e81fde4e71a538a1080000000000000cdb08000000001936f55b22020000000000001976a9140315c06540c4445792ea3ff407a978ec18da1d8188ac22020000000000001976a9144942f11b739a3835d867554ff93cc6685eb1eb5388ac5fb27100000000001976a9144942f11b739a3835d867554ff93cc6685eb1eb5388ac00000000"));
+    gs::transaction tx;
+    REQUIRE( tx.hydrate(txdata.begin(), txdata.end()) );
+
+    gs::txgraph g;
+    gs::slp_validator validator;
+    validator.pruning = true;
+    REQUIRE( validator.add_assumed_valid_tx(tx) );
+    validator.fully_spent.emplace_back(7, tx.txid);
+
+    gs::snapshot_tip tip;
+    tip.height = 600000;
+    tip.hash.v[0] = 0xaa;
+
+    SECTION ("\tgraph and validator round trip") {
+        g.insert_token_data(tx.slp.tokenid, { tx });
+
+        // a child linking to the real tx and a second token, graph txdata is opaque
+        gs::token_details & token = g.tokens[tx.slp.tokenid];
+        gs::txid child_txid;
+        child_txid.v[0] = 1;
+        gs::graph_node & child = token.graph[child_txid];
+        child.txdata = { 1, 2, 3 };
+        child.inputs.push_back(&token.graph[tx.txid]);
+        g.txid_to_token[child_txid] = &token;
+
+        gs::tokenid other_tokenid;
+        other_tokenid.v[0] = 2;
+        g.tokens.emplace(other_tokenid, other_tokenid);
+        gs::txid other_txid;
+        other_txid.v[0] = 3;
+        g.tokens[other_tokenid].graph[other_txid].txdata = { 4 };
+        g.txid_to_token[other_txid] = &g.tokens[other_tokenid];
+
+        REQUIRE( gs::save_snapshot(path, g, validator, tip) );
+
+        gs::txgraph g2;
+        gs::slp_validator validator2;
+        const std::pair<bool, gs::snapshot_tip> loaded = gs::load_snapshot(path, g2, validator2);
+        REQUIRE( loaded.first );
+        REQUIRE( loaded.second.height == tip.height );
+        REQUIRE( loaded.second.hash == tip.hash );
+
+        REQUIRE( g2.tokens.size() == 2 );
+        REQUIRE( g2.txid_to_token.size() == 3 );
+        gs::token_details & token2 = g2.tokens.at(tx.slp.tokenid);
+        REQUIRE( token2.graph.at(tx.txid).txdata == txdata );
+        REQUIRE( token2.graph.at(child_txid).inputs.size() == 1 );
+        REQUIRE( token2.graph.at(child_txid).inputs[0] == &token2.graph.at(tx.txid) );
+        REQUIRE( g2.txid_to_token.at(other_txid) == &g2.tokens.at(other_tokenid) );
+
+        REQUIRE( validator2.has_valid(tx.txid) );
+        REQUIRE( validator2.get(tx.txid).serialized == txdata );
+        REQUIRE( validator2.get(tx.txid).slp.tokenid == tx.slp.tokenid );
+        REQUIRE( validator2.unspent_outputs == validator.unspent_outputs );
+        REQUIRE( validator2.fully_spent == validator.fully_spent );
+    }
+
+    SECTION ("\ttransactions missing from the graph are stored inline") {
+        REQUIRE( gs::save_snapshot(path, g, validator, tip) );
+
+        gs::txgraph g2;
+        gs::slp_validator validator2;
+        REQUIRE( gs::load_snapshot(path, g2, validator2).first );
+        REQUIRE( g2.tokens.empty() );
+        REQUIRE( validator2.get(tx.txid).serialized == txdata );
+    }
+
+    SECTION ("\tcorrupt or missing snapshots are rejected") {
+        REQUIRE( gs::save_snapshot(path, g, validator, tip) );
+        {
+            std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(60);
+            f.put('x');
+        }
+
+        gs::txgraph g2;
+        gs::slp_validator validator2;
+        REQUIRE( ! gs::load_snapshot(path, g2, validator2).first );
+        REQUIRE( ! gs::load_snapshot(path + ".missing", g2, validator2).first );
+    }
+
+    boost::filesystem::remove(path);
+}
+
+TEST_CASE( "wal", "[single-file]" ) {
+    const std::string path = (
+        boost::filesystem::temp_directory_path()
+      / boost::filesystem::unique_path("gs-wal-%%%%-%%%%")
+    ).string();
+
+    auto txdata = [](const std::uint32_t i) {
+        return std::vector<std::uint8_t>(10 + i % 50, static_cast<std::uint8_t>(i));
+    };
+
+    gs::blockhash hash;
+    hash.v[0] = 0xbb;
+
+    {
+        gs::wal log(std::chrono::milliseconds(5));
+        REQUIRE( log.open(path) );
+
+        // appenders on several threads share syncs
+        std::vector<std::thread> threads;
+        for (std::uint32_t t=0; t<4; ++t) {
+            threads.emplace_back([&, t] {
+                for (std::uint32_t i=0; i<250; ++i) {
+                    log.append_tx(txdata(t * 250 + i));
+                }
+            });
+        }
+        for (auto & t : threads) {
+            t.join();
+        }
+        log.append_block(700000, hash);
+        REQUIRE( log.sync() );
+        REQUIRE( log.synced == 1001 );
+    }
+
+    SECTION ("\tsynced records read back") {
+        const auto r = gs::wal::read(path);
+        REQUIRE( r.first );
+        REQUIRE( r.second.size() == 1001 );
+        REQUIRE( r.second.back().type == gs::wal::record_type::block );
+        REQUIRE( gs::wal::decode_block(r.second.back()).first == 700000 );
+        REQUIRE( gs::wal::decode_block(r.second.back()).second == hash );
+
+        std::size_t txs = 0;
+        for (const auto & rec : r.second) {
+            if (rec.type == gs::wal::record_type::tx) {
+                const std::uint8_t first = rec.data[0];
+                REQUIRE( std::all_of(rec.data.begin(), rec.data.end(), [&](const std::uint8_t c) { return c == first; }) );
+                ++txs;
+            }
+        }
+        REQUIRE( txs == 1000 );
+    }
+
+    SECTION ("\ttorn tail is dropped and appends continue") {
+        boost::filesystem::resize_file(path, boost::filesystem::file_size(path) - 3);
+        REQUIRE( gs::wal::read(path).second.size() == 1000 );
+
+        {
+            gs::wal log(std::chrono::milliseconds(5));
+            REQUIRE( log.open(path) );
+            log.append_block(700001, hash);
+        }
+
+        const auto r = gs::wal::read(path);
+        REQUIRE( r.second.size() == 1001 );
+        REQUIRE( gs::wal::decode_block(r.second.back()).first == 700001 );
+    }
+
+    SECTION ("\treset empties the log") {
+        gs::wal log(std::chrono::milliseconds(5));
+        REQUIRE( log.open(path) );
+        log.append_tx(txdata(1));
+        REQUIRE( log.reset() );
+        log.append_tx(txdata(2));
+        REQUIRE( log.sync() );
+
+        const auto r = gs::wal::read(path);
+        REQUIRE( r.second.size() == 1 );
+        REQUIRE( r.second[0].data == txdata(2) );
+    }
+
+    SECTION ("\treset alone is written by the flusher") {
+        gs::wal log(std::chrono::milliseconds(5));
+        REQUIRE( log.open(path) );
+        REQUIRE( log.reset() );
+        REQUIRE( log.sync() );
+        REQUIRE( boost::filesystem::file_size(path) == 0 );
+    }
+
+    SECTION ("\ta failed write stops the log") {
+        gs::wal log(std::chrono::milliseconds(5));
+        REQUIRE( log.open(path) );
+
+        // writes to a read only descriptor fail
+        const int ro = ::open(path.c_str(), O_RDONLY);
+        REQUIRE( ro != -1 );
+        REQUIRE( ::dup2(ro, log.fd) == log.fd );
+        ::close(ro);
+
+        log.append_tx(txdata(1));
+        REQUIRE_FALSE( log.sync() );
+        log.append_tx(txdata(2));
+        {
+            boost::lock_guard<boost::mutex> lock(log.mtx);
+            REQUIRE( log.pending.empty() );
+        }
+        REQUIRE_FALSE( log.reset() );
+        REQUIRE_FALSE( log.sync() );
+        log.close();
+
+        REQUIRE( gs::wal::read(path).second.size() == 1001 );
+    }
+
+    REQUIRE( gs::wal::read(path + ".missing").first );
+    boost::filesystem::remove(path);
+}
+
+TEST_CASE( "ingest_queue", "[single-file]" ) {
+    SECTION ("\titems come out in order and in bounded batches") {
+        gs::ingest_queue<std::uint32_t> q(64);
+
+        std::atomic<bool> push_failed { false };
+        std::thread producer([&] {
+            for (std::uint32_t i=0; i<10000; ++i) {
+                if (! q.push(std::unique_ptr<std::uint32_t>(new std::uint32_t(i)))) {
+                    push_failed = true;
+                }
+            }
+        });
+
+        std::uint32_t expected = 0;
+        std::size_t largest = 0;
+        while (expected < 10000) {
+            const auto batch = q.pop_batch(32, std::chrono::milliseconds(100));
+            largest = std::max(largest, batch.size());
+            for (const auto & item : batch) {
+                REQUIRE( *item == expected );
+                ++expected;
+            }
+        }
+        producer.join();
+
+        REQUIRE( ! push_failed );
+        REQUIRE( largest <= 32 );
+        REQUIRE( q.depth() == 0 );
+        REQUIRE( q.popped == 10000 );
+    }
+
+    SECTION ("\tempty pop times out and stop releases a full queue") {
+        gs::ingest_queue<std::uint32_t> q(2);
+        REQUIRE( q.pop_batch(8, std::chrono::milliseconds(5)).empty() );
+
+        REQUIRE( q.push(std::unique_ptr<std::uint32_t>(new std::uint32_t(1))) );
+        REQUIRE( q.push(std::unique_ptr<std::uint32_t>(new std::uint32_t(2))) );
+        REQUIRE( q.depth() == 2 );
+
+        std::atomic<bool> pushed { true };
+        std::thread blocked([&] {
+            pushed = q.push(std::unique_ptr<std::uint32_t>(new std::uint32_t(3)));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        q.stop();
+        blocked.join();
+
+        REQUIRE( ! pushed );
+        REQUIRE( q.depth() == 2 );
+        REQUIRE( q.pop_batch(8, std::chrono::milliseconds(5)).size() == 2 );
+        REQUIRE( q.last_batch_size == 2 );
+    }
+}
+
+TEST_CASE( "reorg_journal", "[single-file]" ) {
+    gs::slp_validator validator;
+    validator.pruning = true;
+    gs::txgraph g;
+    gs::reorg_journal journal(3);
+
+    gs::tokenid tokenid;
+    tokenid.v[0] = 1;
+
+    auto make_send = [&](const std::uint8_t id, const std::vector<gs::outpoint>& inputs, const std::vector<std::uint64_t>& amounts) {
+        gs::transaction tx;
+        tx.txid.v[0] = id;
+        tx.serialized = { id };
+        tx.inputs = inputs;
+        tx.outputs.resize(amounts.size() + 1);
+        tx.slp = gs::slp_transaction(gs::slp_transaction_send(amounts));
+        tx.slp.tokenid = tokenid;
+        tx.slp.token_type = 0x01;
+        return tx;
+    };
+    auto make_hash = [](const std::uint8_t id) {
+        gs::blockhash hash;
+        hash.v[0] = id;
+        return hash;
+    };
+
+    const gs::transaction parent = make_send(1, {}, { 5, 5 });
+    journal.connect(100, make_hash(100));
+    journal.record_added(parent.txid);
+    REQUIRE( validator.add_assumed_valid_tx(parent) );
+    g.insert_token_data(tokenid, { parent });
+
+    const gs::transaction child = make_send(2, { gs::outpoint(parent.txid, 1) }, { 5 });
+    journal.connect(101, make_hash(101));
+    journal.record_spent(validator.spend_inputs(child, 101));
+    journal.record_added(child.txid);
+    REQUIRE( validator.add_tx(child) );
+    g.insert_token_data(tokenid, { child });
+
+    REQUIRE( validator.unspent_outputs.at(parent.txid).size() == 1 );
+    REQUIRE( journal.memory_usage() > 0 );
+
+    SECTION ("\trollback disconnects blocks after the fork") {
+        REQUIRE( journal.rollback(make_hash(100), g, validator) );
+        REQUIRE( journal.blocks.size() == 1 );
+
+        REQUIRE( ! validator.has(child.txid) );
+        REQUIRE( ! validator.has_valid(child.txid) );
+        REQUIRE( ! g.has_tx(child.txid) );
+        REQUIRE( validator.has_valid(parent.txid) );
+        REQUIRE( g.has_tx(parent.txid) );
+        REQUIRE( validator.unspent_outputs.at(parent.txid).size() == 2 );
+
+        // the fork block takes later changes again
+        journal.connect(101, make_hash(201));
+        REQUIRE( journal.blocks.size() == 2 );
+    }
+
+    SECTION ("\ttxgraph returns txdata of pruned transactions") {
+        validator.spend_inputs(std::vector<gs::outpoint>{ gs::outpoint(parent.txid, 2) }, 101);
+        REQUIRE( validator.prune(101) == 1 );
+        REQUIRE( ! validator.has(parent.txid) );
+        REQUIRE( g.get_txdata(parent.txid).first );
+        REQUIRE( g.get_txdata(parent.txid).second == parent.serialized );
+        REQUIRE( ! g.get_txdata(make_send(3, {}, { 1 }).txid).first );
+    }
+
+    SECTION ("\ttoken goes once its last tx is removed") {
+        REQUIRE( g.remove_txs({ child.txid, parent.txid }) == 2 );
+        REQUIRE( g.tokens.empty() );
+        REQUIRE( g.txid_to_token.empty() );
+    }
+
+    SECTION ("\tunknown fork changes nothing") {
+        REQUIRE( ! journal.rollback(make_hash(99), g, validator) );
+        REQUIRE( validator.has_valid(child.txid) );
+        REQUIRE( journal.blocks.size() == 2 );
+    }
+
+    SECTION ("\tonly depth blocks are kept") {
+        journal.connect(102, make_hash(102));
+        journal.connect(103, make_hash(103));
+        REQUIRE( journal.blocks.size() == 3 );
+        REQUIRE( journal.find(make_hash(100)) == nullptr );
+        REQUIRE( journal.find(make_hash(103))->height == 103 );
+
+        // a gap can not be rolled back over
+        journal.connect(110, make_hash(110));
+        REQUIRE( journal.blocks.size() == 1 );
+    }
+}
+
+TEST_CASE( "utxo_undo", "[single-file]" ) {
+    auto append = [](std::vector<std::uint8_t>& v, const std::vector<std::uint8_t>& d) {
+        v.insert(v.end(), d.begin(), d.end());
+    };
+    auto le = [](const std::uint64_t n, const std::size_t len) {
+        std::vector<std::uint8_t> ret;
+        for (std::size_t i=0; i<len; ++i) {
+            ret.push_back((n >> (8*i)) & 0xFF);
+        }
+        return ret;
+    };
+
+    // inputs are outpoints, outputs are value and scriptpubkey
+    auto make_tx = [&](
+        const std::vector<gs::outpoint>& inputs,
+        const std::vector<std::pair<std::uint64_t, std::vector<std::uint8_t>>>& outputs
+    ) {
+        std::vector<std::uint8_t> v = le(1, 4);
+        append(v, gs::util::num_to_var_int(inputs.size()));
+        for (auto & m : inputs) {
+            append(v, std::vector<std::uint8_t>(m.txid.v.begin(), m.txid.v.end()));
+            append(v, le(m.vout, 4));
+            append(v, { 0x00, 0xFF, 0xFF, 0xFF, 0xFF });
+        }
+        append(v, gs::util::num_to_var_int(outputs.size()));
+        for (auto & m : outputs) {
+            append(v, le(m.first, 8));
+            append(v, gs::util::num_to_var_int(m.second.size()));
+            append(v, m.second);
+        }
+        append(v, le(0, 4));
+
+        gs::transaction tx;
+        REQUIRE( tx.hydrate(v.begin(), v.end()) );
+        return tx;
+    };
+    auto make_block = [&](const std::uint8_t id, const std::vector<gs::transaction>& txs) {
+        gs::block block;
+        block.version = 1;
+        block.prev_block.v[0] = id - 1;
+        block.timestamp = id;
+        block.bits = 0;
+        block.nonce = 0;
+        block.txs = txs;
+        return block.serialize();
+    };
+
+    const std::vector<std::uint8_t> p2pkh = {
+        0x76, 0xA9, 0x14,
+        1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
+        0x88, 0xAC
+    };
+    const std::vector<std::uint8_t> genesis_script = {
+        0x6A, 0x04, 'S', 'L', 'P', 0x00, 0x01, 0x01,
+        0x07, 'G', 'E', 'N', 'E', 'S', 'I', 'S',
+        0x01, 'T', 0x01, 'N', 0x01, 'U', 0x4C, 0x00,
+        0x01, 0x00, 0x01, 0x02,
+        0x08, 0, 0, 0, 0, 0, 0, 0, 100
+    };
+
+    gs::outpoint coinbase;
+    coinbase.txid.v[0] = 0xCB;
+    const gs::transaction genesis = make_tx({ coinbase }, {
+        { 0, genesis_script }, { 546, p2pkh }, { 546, p2pkh }, { 1000, p2pkh }
+    });
+    REQUIRE( genesis.slp.type == gs::slp_transaction_type::genesis );
+    const gs::tokenid tokenid(genesis.txid.v);
+
+    std::vector<std::uint8_t> send_script = {
+        0x6A, 0x04, 'S', 'L', 'P', 0x00, 0x01, 0x01,
+        0x04, 'S', 'E', 'N', 'D', 0x20
+    };
+    append(send_script, std::vector<std::uint8_t>(genesis.txid.v.rbegin(), genesis.txid.v.rend()));
+    append(send_script, { 0x08, 0, 0, 0, 0, 0, 0, 0, 60, 0x08, 0, 0, 0, 0, 0, 0, 0, 40 });
+
+    const gs::transaction send = make_tx({ gs::outpoint(genesis.txid, 1), gs::outpoint(genesis.txid, 3) }, {
+        { 0, send_script }, { 546, p2pkh }, { 546, p2pkh }
+    });
+    REQUIRE( send.slp.type == gs::slp_transaction_type::send );
+    // spends a token output created in the same block
+    const gs::transaction burn = make_tx({ gs::outpoint(send.txid, 2) }, { { 500, p2pkh } });
+
+    // the running commitment must always match one computed from scratch
+    auto commitment_matches = [](gs::utxodb& db) {
+        gs::ecmh full;
+        for (auto & m : db.outpoint_map) {
+            full.add(db.to_output(m.first, m.second));
+        }
+        return db.commitment.finalize() == full.finalize();
+    };
+
+    gs::bch bch;
+    bch.utxodb.commitment_enabled = true;
+    bch.process_block(make_block(1, { genesis }), true);
+    REQUIRE( commitment_matches(bch.utxodb) );
+    const gs::ecmh_hash commitment_before = bch.utxodb.commitment.finalize();
+
+    // what the first block leaves behind
+    auto outpoints = [&]() {
+        std::vector<std::pair<std::string, std::uint64_t>> ret;
+        for (auto & m : bch.utxodb.outpoint_map) {
+            ret.emplace_back(bch.utxodb.txids.get(m.first.tx).decompress() + ":" + std::to_string(m.first.vout), m.second.value);
+        }
+        std::sort(ret.begin(), ret.end());
+        return ret;
+    };
+    auto token_utxos = [&]() {
+        std::vector<std::pair<std::string, std::uint64_t>> ret;
+        for (auto & m : bch.slpdb.tokens.at(tokenid).utxos) {
+            ret.emplace_back(m.first.txid.decompress() + ":" + std::to_string(m.first.vout), m.second.amount);
+        }
+        std::sort(ret.begin(), ret.end());
+        return ret;
+    };
+    const auto outpoints_before   = outpoints();
+    const auto token_utxos_before = token_utxos();
+    REQUIRE( outpoints_before.size() == 3 );
+    REQUIRE( bch.utxodb.get_outputs_by_scriptpubkey(gs::scriptpubkey(p2pkh), 10).size() == 3 );
+
+    bch.process_block(make_block(2, { send, burn }), true);
+    REQUIRE( commitment_matches(bch.utxodb) );
+    REQUIRE( bch.utxodb.commitment.finalize() != commitment_before );
+    REQUIRE( bch.utxodb.current_block_height == 2 );
+    REQUIRE( bch.utxodb.undo_journal.size() == 2 );
+    REQUIRE( bch.utxodb.undo_memory_usage() > 0 );
+    REQUIRE( bch.utxodb.outpoint_map.size() == 3 );
+    REQUIRE( bch.slpdb.tokens.at(tokenid).transactions.count(send.txid) == 1 );
+
+    SECTION ("\tspent outputs are packed and unpacked in order") {
+        const gs::utxo_undo & undo = bch.utxodb.undo_journal.back();
+        REQUIRE( undo.removed_count == 3 );
+        REQUIRE( undo.added_count() == 3 );
+        REQUIRE( undo.txids.size() == 2 );
+
+        const std::vector<gs::output> removed = undo.removed_outputs();
+        REQUIRE( removed.size() == 3 );
+        REQUIRE( removed[0].prev_tx_id == genesis.txid );
+        REQUIRE( removed[0].prev_out_idx == 1 );
+        REQUIRE( removed[1].value == 1000 );
+        REQUIRE( removed[2].prev_tx_id == send.txid );
+        REQUIRE( removed[2].scriptpubkey == gs::scriptpubkey(p2pkh) );
+        REQUIRE( undo.added_outpoint(2) == gs::outpoint(burn.txid, 0) );
+    }
+
+    SECTION ("\trollback restores utxos and tokens") {
+        REQUIRE( bch.rollback() );
+        REQUIRE( bch.utxodb.current_block_height == 1 );
+        REQUIRE( outpoints() == outpoints_before );
+        REQUIRE( bch.utxodb.commitment.finalize() == commitment_before );
+        REQUIRE( token_utxos() == token_utxos_before );
+        REQUIRE( bch.utxodb.get_outputs_by_scriptpubkey(gs::scriptpubkey(p2pkh), 10).size() == 3 );
+        REQUIRE( bch.slpdb.tokens.at(tokenid).transactions.count(send.txid) == 0 );
+        REQUIRE( bch.slpdb.tokens.at(tokenid).mint_baton_outpoint == gs::outpoint(genesis.txid, 2) );
+
+        // and the genesis goes with its block
+        REQUIRE( bch.rollback() );
+        REQUIRE( bch.utxodb.outpoint_map.empty() );
+        REQUIRE( bch.utxodb.scriptpubkey_to_output.empty() );
+        REQUIRE( bch.utxodb.txids.size() == 0 );
+        REQUIRE( bch.slpdb.tokens.empty() );
+        REQUIRE( bch.slpdb.utxo_to_tokenid.empty() );
+        REQUIRE( bch.utxodb.commitment.finalize() == gs::ecmh().finalize() );
+
+        REQUIRE( ! bch.rollback() );
+    }
+
+    SECTION ("\tjournal is trimmed to rollback_depth") {
+        bch.utxodb.rollback_depth = 1;
+        bch.process_block(make_block(3, {}), true);
+        REQUIRE( bch.utxodb.undo_journal.size() == 1 );
+        REQUIRE( bch.rollback() );
+        REQUIRE( ! bch.rollback() );
+    }
+}
+
+TEST_CASE( "utxo_checkpoint", "[single-file]" ) {
+    const std::string path = (
+        boost::filesystem::temp_directory_path()
+      / boost::filesystem::unique_path("gs-utxo-checkpoint-%%%%-%%%%")
+    ).string();
+
+    // enough outputs for several chunks, spread over a few scripts of every kind
+    const std::uint32_t output_count = 150000;
+    gs::utxodb db;
+    db.current_block_height = 600000;
+    db.current_block_hash.v[0] = 0xaa;
+    for (std::uint32_t i=0; i<output_count; ++i) {
+        gs::txid txid;
+        std::memcpy(txid.v.data(), &i, sizeof(i));
+
+        std::vector<std::uint8_t> script(1 + i % 40, i % 7);
+        if (i % 3 == 1) {
+            script = { 0x76, 0xA9, 0x14 };
+            script.insert(script.end(), 20, i % 11);
+            script.insert(script.end(), { 0x88, 0xAC });
+        }
+        REQUIRE( db.add_output(gs::output(txid, i % 3, i * 1000ull, gs::scriptpubkey(script))) );
+    }
+
+    REQUIRE( gs::save_utxo_checkpoint(path, db) );
+
+    SECTION ("\tutxo set round trips") {
+        gs::utxodb loaded_db;
+        const std::pair<bool, gs::snapshot_tip> loaded = gs::load_utxo_checkpoint(path, loaded_db, 3);
+        REQUIRE( loaded.first );
+        REQUIRE( loaded.second.height == 600000 );
+        REQUIRE( loaded.second.hash == db.current_block_hash );
+        REQUIRE( loaded_db.current_block_height == 600000 );
+
+        REQUIRE( loaded_db.outpoint_map.size() == db.outpoint_map.size() );
+        REQUIRE( loaded_db.txids.size() == db.txids.size() );
+        REQUIRE( loaded_db.scripts.size() == db.scripts.size() );
+        for (auto & m : db.outpoint_map) {
+            const gs::output o = db.to_output(m.first, m.second);
+            gs::output loaded_o;
+            REQUIRE( loaded_db.find_output(gs::outpoint(o.prev_tx_id, o.prev_out_idx), loaded_o) );
+            REQUIRE( loaded_o.value == o.value );
+            REQUIRE( loaded_o.scriptpubkey == o.scriptpubkey );
+        }
+
+        REQUIRE( loaded_db.scriptpubkey_to_output.size() == db.scriptpubkey_to_output.size() );
+        for (auto & m : db.scriptpubkey_to_output) {
+            const gs::scriptpubkey scriptpubkey = m.first.to_scriptpubkey(db.scripts);
+            const std::vector<gs::output> outputs = loaded_db.get_outputs_by_scriptpubkey(scriptpubkey, output_count);
+            REQUIRE( outputs.size() == m.second.size() );
+            for (const gs::output & o : outputs) {
+                REQUIRE( o.scriptpubkey == scriptpubkey );
+            }
+        }
+    }
+
+    SECTION ("\tcorrupt checkpoints are rejected") {
+        const auto size = boost::filesystem::file_size(path);
+
+        // a byte inside the chunks
+        {
+            std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+            f.seekg(size / 2);
+            const char c = f.get();
+            f.seekp(size / 2);
+            f.put(c ^ 0x5a);
+        }
+        gs::utxodb flipped;
+        REQUIRE( ! gs::load_utxo_checkpoint(path, flipped, 2).first );
+
+        boost::filesystem::resize_file(path, size - 3);
+        gs::utxodb truncated;
+        REQUIRE( ! gs::load_utxo_checkpoint(path, truncated).first );
+
+        boost::filesystem::remove(path);
+        gs::utxodb missing;
+        REQUIRE( ! gs::load_utxo_checkpoint(path, missing).first );
+    }
+
+    SECTION ("\tutxo commitment is rebuilt and checked on load") {
+        gs::utxodb small;
+        small.commitment_enabled = true;
+        for (auto it = db.outpoint_map.begin(); small.outpoint_map.size() < 1000; ++it) {
+            const gs::output o = db.to_output(it->first, it->second);
+            REQUIRE( small.add_output(o) );
+            small.commitment.add(o);
+        }
+        REQUIRE( gs::save_utxo_checkpoint(path, small) );
+
+        gs::utxodb loaded_db;
+        loaded_db.commitment_enabled = true;
+        REQUIRE( gs::load_utxo_checkpoint(path, loaded_db, 3).first );
+        REQUIRE( loaded_db.commitment.finalize() == small.commitment.finalize() );
+    }
+
+    SECTION ("\tan empty utxo set round trips") {
+        gs::utxodb empty;
+        REQUIRE( gs::save_utxo_checkpoint(path, empty) );
+
+        gs::utxodb loaded_db;
+        REQUIRE( gs::load_utxo_checkpoint(path, loaded_db).first );
+        REQUIRE( loaded_db.outpoint_map.empty() );
+        REQUIRE( loaded_db.scriptpubkey_to_output.empty() );
+    }
+
+    boost::filesystem::remove(path);
+}
+
+TEST_CASE( "ecmh", "[single-file]" ) {
+    std::vector<gs::output> outputs;
+    for (std::uint32_t i=0; i<1000; ++i) {
+        gs::txid txid;
+        std::memcpy(txid.v.data(), &i, sizeof(i));
+        outputs.emplace_back(txid, i % 4, i * 1000, gs::scriptpubkey(std::vector<std::uint8_t>(25, i % 256)));
+    }
+
+    SECTION ("\tthe hash depends on the set, not the order") {
+        gs::ecmh forward;
+        gs::ecmh backward;
+        for (auto it = outputs.begin(); it != outputs.end(); ++it) {
+            forward.add(*it);
+        }
+        for (auto it = outputs.rbegin(); it != outputs.rend(); ++it) {
+            backward.add(*it);
+        }
+        REQUIRE( forward.finalize() == backward.finalize() );
+        REQUIRE( forward.finalize() != gs::ecmh().finalize() );
+
+        // any field of an output changes it
+        gs::output changed = outputs[0];
+        changed.value += 1;
+        forward.remove(outputs[0]);
+        forward.add(changed);
+        REQUIRE( forward.finalize() != backward.finalize() );
+    }
+
+    SECTION ("\tremoving undoes adding") {
+        gs::ecmh e;
+        e.add(outputs[0]);
+        const gs::ecmh_hash one = e.finalize();
+        e.add(outputs[1]);
+        e.remove(outputs[1]);
+        REQUIRE( e.finalize() == one );
+        e.remove(outputs[0]);
+        REQUIRE( e.finalize() == gs::ecmh().finalize() );
+    }
+
+    SECTION ("\tthreaded updates match adding one by one") {
+        std::vector<const gs::output*> added;
+        std::vector<const gs::output*> removed;
+        gs::ecmh expected;
+        for (std::size_t i=0; i<outputs.size(); ++i) {
+            expected.add(outputs[i]);
+            added.push_back(&outputs[i]);
+        }
+        for (std::size_t i=0; i<outputs.size(); i+=3) {
+            expected.remove(outputs[i]);
+            removed.push_back(&outputs[i]);
+        }
+
+        gs::ecmh threaded;
+        threaded.update(added, removed, 4);
+        REQUIRE( threaded.finalize() == expected.finalize() );
+
+        gs::ecmh halves;
+        gs::ecmh second;
+        halves.update({ added.begin(), added.begin() + 500 }, {}, 1);
+        second.update({ added.begin() + 500, added.end() }, removed, 2);
+        halves.combine(second);
+        REQUIRE( halves.finalize() == expected.finalize() );
+    }
+}
+
+TEST_CASE( "compact_utxo", "[single-file]" ) {
+    std::vector<std::uint8_t> p2pkh = { 0x76, 0xA9, 0x14 };
+    p2pkh.insert(p2pkh.end(), 20, 0x11);
+    p2pkh.insert(p2pkh.end(), { 0x88, 0xAC });
+
+    std::vector<std::uint8_t> p2sh = { 0xA9, 0x14 };
+    p2sh.insert(p2sh.end(), 20, 0x22);
+    p2sh.push_back(0x87);
+
+    const gs::scriptpubkey p2pk(std::vector<std::uint8_t>(35, 0x21));
+
+    SECTION ("\tp2pkh and p2sh become templates") {
+        gs::interner<gs::scriptpubkey> scripts;
+        gs::script_ref ref;
+
+        REQUIRE( gs::script_ref::from_template(gs::scriptpubkey(p2pkh), ref) );
+        REQUIRE( ref.tag == gs::script_ref::kind::p2pkh );
+        REQUIRE( ref.to_scriptpubkey(scripts) == gs::scriptpubkey(p2pkh) );
+
+        REQUIRE( gs::script_ref::from_template(gs::scriptpubkey(p2sh), ref) );
+        REQUIRE( ref.tag == gs::script_ref::kind::p2sh );
+        REQUIRE( ref.to_scriptpubkey(scripts) == gs::scriptpubkey(p2sh) );
+
+        // a byte off and it is no template anymore
+        std::vector<std::uint8_t> almost = p2pkh;
+        almost.back() = 0xAD;
+        REQUIRE( ! gs::script_ref::from_template(gs::scriptpubkey(almost), ref) );
+        REQUIRE( ! gs::script_ref::from_template(p2pk, ref) );
+
+        ref = gs::script_ref::interned(scripts.acquire(p2pk));
+        REQUIRE( ref.to_scriptpubkey(scripts) == p2pk );
+    }
+
+    SECTION ("\tinterned ids are refcounted and reused") {
+        gs::interner<gs::txid> txids;
+        gs::txid a;
+        gs::txid b;
+        a.v[0] = 0xaa;
+        b.v[0] = 0xbb;
+
+        const std::uint32_t a_id = txids.acquire(a);
+        REQUIRE( txids.acquire(a) == a_id );
+        REQUIRE( txids.acquire(b) != a_id );
+        REQUIRE( txids.size() == 2 );
+
+        txids.release(a_id);
+        REQUIRE( txids.find(a).first );
+        txids.release(a_id);
+        REQUIRE( ! txids.find(a).first );
+        REQUIRE( txids.size() == 1 );
+
+        gs::txid c;
+        c.v[0] = 0xcc;
+        REQUIRE( txids.acquire(c) == a_id );
+        REQUIRE( txids.get(a_id) == c );
+        REQUIRE( txids.get(txids.find(b).second) == b );
+    }
+
+    SECTION ("\tutxodb shares txids and scripts between outputs") {
+        gs::utxodb db;
+        gs::txid txid;
+        txid.v[0] = 0x01;
+
+        REQUIRE( db.add_output(gs::output(txid, 0, 546, gs::scriptpubkey(p2pkh))) );
+        REQUIRE( db.add_output(gs::output(txid, 1, 1000, p2pk)) );
+        REQUIRE( db.add_output(gs::output(txid, 2, 5000000000ull, p2pk)) );
+        REQUIRE( ! db.add_output(gs::output(txid, 2, 1, p2pk)) );
+        REQUIRE( db.outpoint_map.size() == 3 );
+        REQUIRE( db.txids.size() == 1 );
+        REQUIRE( db.scripts.size() == 1 );
+        REQUIRE( db.get_balance_by_scriptpubkey(p2pk) == 5000001000ull );
+
+        const std::vector<gs::output> found = db.get_outputs_by_outpoints({ gs::outpoint(txid, 2), gs::outpoint(txid, 3) });
+        REQUIRE( found.size() == 1 );
+        REQUIRE( found[0].value == 5000000000ull );
+        REQUIRE( found[0].scriptpubkey == p2pk );
+
+        gs::output removed;
+        REQUIRE( db.remove_output(gs::outpoint(txid, 1), removed) );
+        REQUIRE( removed.value == 1000 );
+        REQUIRE( ! db.remove_output(gs::outpoint(txid, 1), removed) );
+        REQUIRE( db.scripts.size() == 1 );
+
+        REQUIRE( db.remove_output(gs::outpoint(txid, 2), removed) );
+        REQUIRE( db.scripts.size() == 0 );
+        REQUIRE( db.get_outputs_by_scriptpubkey(p2pk, 10).empty() );
+        REQUIRE( db.get_outputs_by_scriptpubkey(gs::scriptpubkey(p2pkh), 10).size() == 1 );
+
+        REQUIRE( db.remove_output(gs::outpoint(txid, 0), removed) );
+        REQUIRE( removed.scriptpubkey == gs::scriptpubkey(p2pkh) );
+        REQUIRE( db.txids.size() == 0 );
+        REQUIRE( db.scriptpubkey_to_output.empty() );
+    }
+}
+
+TEST_CASE( "worker_pool", "[single-file]" ) {
+    gs::worker_pool pool(3);
+
+    SECTION ("\tevery index runs once") {
+        std::vector<std::atomic<int>> seen(10000);
+        for (auto & m : seen) {
+            m = 0;
+        }
+
+        pool.run(seen.size(), [&](const std::size_t i) { ++seen[i]; }, 3);
+        for (auto & m : seen) {
+            REQUIRE( m == 1 );
+        }
+    }
+
+    SECTION ("\tworkers are kept between runs") {
+        std::mutex mtx;
+        std::set<std::thread::id> threads;
+        for (int run=0; run<20; ++run) {
+            pool.run(64, [&](const std::size_t) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                std::lock_guard<std::mutex> lock(mtx);
+                threads.insert(std::this_thread::get_id());
+            }, 3);
+        }
+
+        // the three workers and the caller, never a fresh thread
+        REQUIRE( threads.size() <= 4 );
+    }
+
+    SECTION ("\truns from several threads at once") {
+        std::atomic<std::size_t> total { 0 };
+        std::vector<std::thread> callers;
+        for (int t=0; t<4; ++t) {
+            callers.emplace_back([&] {
+                pool.run(1000, [&](const std::size_t) { ++total; }, 2);
+            });
+        }
+        for (auto & m : callers) {
+            m.join();
+        }
+        REQUIRE( total == 4000 );
+
+        pool.run(0, [&](const std::size_t) { ++total; }, 3);
+        REQUIRE( total == 4000 );
+    }
+}